@@ -0,0 +1,654 @@
+/**
+ * @file
+ * @brief contém a implementação da análise estática do efeito dos programas
+ * sobre a stack e dos tipos dos valores
+ *
+ * Cada programa é percorrido uma vez depois de otimizado, simulando uma stack
+ * abstrata: em vez dos valores guarda-se o conjunto dos tipos possíveis de cada
+ * um (e o bloco, quando é uma constante). O número de valores que cada operador
+ * retira e empurra é o da JUMP_TABLE (ver parser.h); quando depende dos tipos
+ * dos operandos e estes não são conhecidos, a profundidade da stack passa a ser
+ * um intervalo.
+ *
+ * O resultado (StackEffect) diz quantos valores o programa consome, quanto a
+ * stack pode crescer e que tipo fica no topo. Um programa com um efeito
+ * conhecido (bounded) é executado sem verificar se a stack tem os operandos de
+ * cada operador e com o espaço da stack reservado de uma vez (ver runProgram);
+ * os restantes são executados normalmente. A análise também indica os blocos
+ * puros (sem input, output nem variáveis) e os numéricos, que podem ser
+ * compilados para código máquina (ver jit.c).
+ *
+ * Os blocos constantes ainda não compilados e os blocos guardados em variáveis
+ * são desconhecidos: aplicá-los com `~` ou `w` termina a análise.
+ */
+
+#include <string.h>
+#include "analysis.h"
+#include "blockOperations.h"
+
+//! O número de valores do topo da stack abstrata cujos tipos são guardados
+#define ANALYSIS_DEPTH 32
+
+//! Os operadores que podem ser usados pelos programas numéricos
+#define NUMERIC_OPERATORS_SET "+-*/%#()&|^=<>!_\\@;"
+
+/**
+ * \brief Um valor da stack abstrata
+ */
+typedef struct slot {
+    //! Os tipos possíveis do valor
+    TypeSet types;
+    //! O bloco, se o valor for um bloco constante (NULL se não for)
+    BlockCode block;
+} Slot;
+
+/**
+ * \brief O estado da análise de um programa
+ */
+typedef struct analysis {
+    //! Os valores do topo da stack abstrata (o último é o topo)
+    Slot slots[ANALYSIS_DEPTH];
+    //! O número de valores guardados em slots
+    int known;
+    //! A menor profundidade possível da stack, relativa ao início do programa
+    long long depth;
+    //! A maior profundidade possível da stack (UNBOUNDED se não tiver limite)
+    long long maxDepth;
+    //! A menor profundidade atingida até agora (os valores abaixo dela são os do início)
+    long long lowest;
+    //! Os tipos assumidos para os valores iniciais da stack e para as variáveis
+    TypeSet assumed;
+    //! O efeito determinado até agora
+    StackEffect effect;
+} Analysis;
+
+/**
+ * \brief Junta dois limites, respeitando UNBOUNDED
+ * @param a O primeiro limite
+ * @param b O segundo limite
+ * @return  A soma, ou UNBOUNDED se algum deles o for
+ */
+static long long addBound(long long a, long long b) {
+    return a == UNBOUNDED || b == UNBOUNDED ? UNBOUNDED : a + b;
+}
+
+/**
+ * \brief Regista que o programa precisa de n valores acima da profundidade atual
+ * @param a O estado da análise
+ * @param n O número de valores
+ */
+static void need(Analysis* a, long long n) {
+    if (n - a->depth > a->effect.inputs)
+        a->effect.inputs = n - a->depth;
+}
+
+/**
+ * \brief Atualiza o maior crescimento da stack
+ * @param a O estado da análise
+ */
+static void grow(Analysis* a) {
+    if (a->maxDepth > a->effect.growth)
+        a->effect.growth = a->maxDepth;
+}
+
+/**
+ * \brief Devolve o valor do topo da stack abstrata, sem o retirar
+ * @param a O estado da análise
+ * @return  O valor (com todos os tipos se não for conhecido)
+ */
+static Slot peekSlot(Analysis* a) {
+    if (a->known > 0)
+        return a->slots[a->known - 1];
+
+    //com a profundidade exata, um valor abaixo da menor profundidade atingida é um dos iniciais
+    Slot s = { ANY_TYPE, NULL };
+    if (a->depth == a->maxDepth && a->depth - 1 < a->lowest)
+        s.types = a->assumed;
+    return s;
+}
+
+/**
+ * \brief Retira o valor do topo da stack abstrata
+ * @param a O estado da análise
+ * @return  O valor
+ */
+static Slot popSlot(Analysis* a) {
+    Slot s = peekSlot(a);
+
+    if (a->known > 0)
+        a->known--;
+    a->depth--;
+    if (a->depth < a->lowest)
+        a->lowest = a->depth;
+    if (a->maxDepth != UNBOUNDED)
+        a->maxDepth--;
+    return s;
+}
+
+/**
+ * \brief Empurra um valor para a stack abstrata
+ * @param a     O estado da análise
+ * @param types Os tipos possíveis do valor
+ * @param block O bloco, se o valor for um bloco constante
+ */
+static void pushSlot(Analysis* a, TypeSet types, BlockCode block) {
+    if (a->known == ANALYSIS_DEPTH) { //o valor mais fundo deixa de ser conhecido
+        memmove(a->slots, a->slots + 1, sizeof(Slot) * (ANALYSIS_DEPTH - 1));
+        a->known--;
+    }
+
+    a->slots[a->known].types = types;
+    a->slots[a->known].block = types == TYPE(Block) ? block : NULL;
+    a->known++;
+    a->depth++;
+    a->maxDepth = addBound(a->maxDepth, 1);
+    grow(a);
+}
+
+/**
+ * \brief Empurra um valor com os tipos dados
+ * @param a     O estado da análise
+ * @param types Os tipos possíveis do valor
+ */
+static void pushType(Analysis* a, TypeSet types) {
+    pushSlot(a, types, NULL);
+}
+
+/**
+ * \brief Altera a profundidade da stack por um número de valores desconhecidos
+ * @param a   O estado da análise
+ * @param min A menor variação
+ * @param max A maior variação (UNBOUNDED se não tiver limite)
+ */
+static void pushUnknown(Analysis* a, long long min, long long max) {
+    a->known = 0;
+    a->depth += min;
+    if (a->depth < a->lowest)
+        a->lowest = a->depth;
+    a->maxDepth = addBound(a->maxDepth, max);
+    grow(a);
+}
+
+/**
+ * \brief Termina a análise: o efeito do programa não pode ser determinado
+ * @param a O estado da análise
+ */
+static void stop(Analysis* a) {
+    a->effect.bounded = false;
+}
+
+/**
+ * \brief Verifica se um conjunto de tipos está contido noutro
+ * @param types O conjunto
+ * @param set   O conjunto que o deve conter
+ * @return      1 se estiver contido (e não for vazio), 0 caso contrário
+ */
+static bool within(TypeSet types, TypeSet set) {
+    return types != 0 && (types & ~set) == 0;
+}
+
+/**
+ * \brief Acrescenta os dois tipos inteiros se um deles for possível (as
+ * operações sobre inteiros podem passar de Int para BigInt e vice-versa)
+ * @param types Os tipos
+ * @return      Os tipos alargados
+ */
+static TypeSet integral(TypeSet types) {
+    if (types & (TYPE(Int) | TYPE(BigInt)))
+        types |= TYPE(Int) | TYPE(BigInt);
+    return types;
+}
+
+/**
+ * \brief Regista o uso de um bloco por `%`, `*`, `,` ou `$`: o programa só é
+ * puro se o bloco for um bloco constante puro
+ * @param a O estado da análise
+ * @param s O valor que pode ser um bloco
+ */
+static void useBlock(Analysis* a, Slot s) {
+    if (!(s.types & TYPE(Block)))
+        return;
+
+    Program p = s.block != NULL ? s.block->program : NULL;
+    if (p == NULL || !p->effect.bounded || !p->effect.pure)
+        a->effect.pure = false;
+}
+
+/**
+ * \brief Aplica o efeito de um bloco constante à stack abstrata (`~`)
+ * @param a     O estado da análise
+ * @param block O bloco
+ */
+static void applyBlock(Analysis* a, BlockCode block) {
+    Program p = block != NULL ? block->program : NULL;
+    if (p == NULL || !p->effect.bounded) {
+        stop(a);
+        return;
+    }
+
+    StackEffect e = p->effect;
+    need(a, e.inputs);
+    if (addBound(a->maxDepth, e.growth) > a->effect.growth)
+        a->effect.growth = addBound(a->maxDepth, e.growth);
+    a->effect.pure = a->effect.pure && e.pure;
+    pushUnknown(a, e.minDelta, e.maxDelta);
+    if (e.minDelta == e.maxDelta && e.minDelta >= 1) //o topo é o que o bloco deixou
+        a->slots[a->known++] = (Slot) { e.top, NULL };
+}
+
+/**
+ * \brief Aplica o efeito de um ciclo `w` com um bloco constante à stack abstrata.
+ *
+ * Só é possível quando cada iteração deixa na stack pelo menos a condição: assim
+ * a stack nunca desce abaixo do início de cada iteração.
+ *
+ * @param a     O estado da análise
+ * @param block O bloco
+ */
+static void applyLoop(Analysis* a, BlockCode block) {
+    Program p = block != NULL ? block->program : NULL;
+    if (p == NULL || !p->effect.bounded || p->effect.minDelta < 1) {
+        stop(a);
+        return;
+    }
+
+    StackEffect e = p->effect;
+    need(a, e.inputs);
+    a->effect.pure = a->effect.pure && e.pure;
+    if (e.maxDelta > 1) //cada iteração pode deixar mais valores
+        a->effect.growth = UNBOUNDED;
+    else if (addBound(a->maxDepth, e.growth) > a->effect.growth)
+        a->effect.growth = addBound(a->maxDepth, e.growth);
+    pushUnknown(a, e.minDelta - 1, e.maxDelta == 1 ? 0 : UNBOUNDED);
+}
+
+/**
+ * \brief Determina os tipos do resultado de um operador binário
+ * @param op O operador
+ * @param x  O primeiro operando
+ * @param y  O segundo operando (o topo)
+ * @return   Os tipos possíveis do resultado
+ */
+static TypeSet binaryResult(char op, TypeSet x, TypeSet y) {
+    if (within(x, NUMERIC_SET) && within(y, NUMERIC_SET)) {
+        if (strchr("=<>", op) != NULL)
+            return TYPE(Int);
+
+        //o resultado tem o menor dos dois tipos (ver NumericOperationAux)
+        TypeSet r = 0;
+        for (DataType i = Double; i <= Char; i++)
+            for (DataType k = Double; k <= Char; k++)
+                if ((x & TYPE(i)) && (y & TYPE(k)))
+                    r |= TYPE(i < k ? i : k);
+        return integral(r);
+    }
+
+    if ((op == '%' || op == '*') && y == TYPE(Block) && within(x, COLLECTION_SET))
+        return x; //o map e o fold alteram a própria coleção
+    if (op == '#' && within(x, COLLECTION_SET) && within(y, COLLECTION_SET))
+        return TYPE(Int);
+    if (op == '*' && within(x, COLLECTION_SET) && y == TYPE(Int))
+        return x;
+    if (strchr("+-|&^", op) != NULL && within(x, COLLECTION_SET) && within(y, COLLECTION_SET))
+        return COLLECTION_SET;
+    return ANY_TYPE;
+}
+
+/**
+ * \brief Pré-preenche a cache de uma instrução Operation com os tipos conhecidos
+ * dos operandos (ver runCached)
+ * @param ins A instrução
+ * @param x   O primeiro operando
+ * @param y   O segundo operando
+ */
+static void seedCache(Instruction* ins, TypeSet x, TypeSet y) {
+    if (ins->cachedTypes != EMPTY_CACHE || !within(x, NUMERIC_SET) || !within(y, NUMERIC_SET))
+        return;
+    if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) //só com um tipo possível
+        return;
+
+    DataType a = __builtin_ctz(x), b = __builtin_ctz(y);
+    ins->cachedTypes = a * NUMERIC_TYPES + b;
+    ins->handler = findNumericHandler(ins->word[0], a, b);
+}
+
+/**
+ * \brief Analisa um operador
+ * @param a   O estado da análise
+ * @param ins A instrução Operation
+ */
+static void analyzeOperation(Analysis* a, Instruction* ins) {
+    Slot x, y, z;
+
+    switch (ins->word[0]) {
+        case 'l': case 't':
+            a->effect.pure = false;
+            pushType(a, TYPE(String));
+            break;
+
+        case 'p': case ':':
+            a->effect.pure = false;
+            need(a, 1);
+            break;
+
+        case '_':
+            need(a, 1);
+            x = popSlot(a);
+            pushSlot(a, x.types, x.block);
+            pushSlot(a, x.types, x.block);
+            break;
+
+        case ';':
+            need(a, 1);
+            popSlot(a);
+            break;
+
+        case '\\':
+            need(a, 2);
+            y = popSlot(a);
+            x = popSlot(a);
+            pushSlot(a, y.types, y.block);
+            pushSlot(a, x.types, x.block);
+            break;
+
+        case '@':
+            need(a, 3);
+            z = popSlot(a);
+            y = popSlot(a);
+            x = popSlot(a);
+            pushSlot(a, y.types, y.block);
+            pushSlot(a, z.types, z.block);
+            pushSlot(a, x.types, x.block);
+            break;
+
+        case 'f': case 'i': case 'c': case 's': case '!': case 'S': case 'N': {
+            static const char ops[] = "ficNS!s";
+            static const TypeSet results[] = {
+                TYPE(Double), TYPE(Int) | TYPE(BigInt), TYPE(Char),
+                TYPE(Array), TYPE(Array), TYPE(Int), TYPE(String)
+            };
+            need(a, 1);
+            popSlot(a);
+            pushType(a, results[strchr(ops, ins->word[0]) - ops]);
+            break;
+        }
+
+        case '~':
+            need(a, 1);
+            x = popSlot(a);
+            if (within(x.types, TYPE(Int) | TYPE(BigInt) | TYPE(Char)))
+                pushType(a, integral(x.types));
+            else if (within(x.types, COLLECTION_SET))
+                pushUnknown(a, 0, UNBOUNDED);
+            else if (x.types == TYPE(Block))
+                applyBlock(a, x.block);
+            else
+                stop(a);
+            break;
+
+        case '$':
+            need(a, 1);
+            x = popSlot(a);
+            useBlock(a, x);
+            if (x.types == TYPE(Int))
+                pushType(a, ANY_TYPE);
+            else if (x.types == TYPE(Block)) { //ordena a coleção abaixo
+                need(a, 1);
+                y = popSlot(a);
+                pushType(a, y.types);
+            } else {
+                need(a, 1);
+                pushUnknown(a, 0, 1);
+            }
+            break;
+
+        case '(': case ')':
+            need(a, 1);
+            x = popSlot(a);
+            if (within(x.types, NUMERIC_SET))
+                pushType(a, integral(x.types));
+            else if (within(x.types, COLLECTION_SET)) { //retira um elemento
+                pushType(a, x.types);
+                pushType(a, ANY_TYPE);
+            } else
+                pushUnknown(a, 1, 2);
+            break;
+
+        case ',':
+            need(a, 1);
+            x = popSlot(a);
+            useBlock(a, x);
+            if (!(x.types & TYPE(Block)))
+                pushType(a, (x.types & (TYPE(Double) | TYPE(Int) | TYPE(Char)) ? TYPE(Array) : 0)
+                            | (x.types & (COLLECTION_SET | TYPE(BigInt)) ? TYPE(Int) : 0));
+            else if (x.types == TYPE(Block)) { //filtra a coleção abaixo
+                need(a, 1);
+                y = popSlot(a);
+                pushType(a, y.types);
+            } else {
+                need(a, 1);
+                pushUnknown(a, 0, 1);
+            }
+            break;
+
+        case 'w':
+            need(a, 1);
+            x = popSlot(a);
+            if (x.types == TYPE(Block))
+                applyLoop(a, x.block);
+            else
+                stop(a);
+            break;
+
+        case 'e':
+            need(a, 2);
+            y = popSlot(a);
+            x = popSlot(a);
+            pushType(a, x.types | y.types);
+            break;
+
+        case '?':
+            need(a, 3);
+            z = popSlot(a);
+            y = popSlot(a);
+            popSlot(a);
+            pushType(a, y.types | z.types);
+            break;
+
+        default: //os operadores binários
+            need(a, 2);
+            y = popSlot(a);
+            x = popSlot(a);
+            if (ins->word[0] == '%' || ins->word[0] == '*')
+                useBlock(a, y);
+            if (ins->cachedTypes != NO_CACHE)
+                seedCache(ins, x.types, y.types);
+            pushType(a, binaryResult(ins->word[0], x.types, y.types));
+            break;
+    }
+}
+
+/**
+ * \brief Verifica se uma instrução pode fazer parte de um programa numérico
+ * @param ins A instrução
+ * @return    1 se puder, 0 caso contrário
+ */
+static bool isNumeric(Instruction* ins) {
+    switch (ins->type) {
+        case PushValue:
+            return ins->value.type == Int || ins->value.type == Double;
+        case PushVariable:
+            return true;
+        case Operation:
+            return ins->length == 1 && strchr(NUMERIC_OPERATORS_SET, ins->word[0]) != NULL;
+        case Fused:
+            for (long long i = 0; i < ins->original->size; i++)
+                if (!isNumeric(&ins->original->code[i]))
+                    return false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void analyzeInstruction(Analysis* a, Instruction* ins);
+
+/**
+ * \brief Analisa uma superinstrução através das instruções que substituiu,
+ * pré-preenchendo a sua cache quando o tipo do topo é conhecido
+ * @param a   O estado da análise
+ * @param ins A instrução Fused
+ */
+static void analyzeFused(Analysis* a, Instruction* ins) {
+    TypeSet top = peekSlot(a).types;
+
+    if (ins->fusion != FuseRunVariable && ins->fusion != FuseNip && ins->fusion != FusePipeline
+            && ins->topType == EMPTY_CACHE
+            && within(top, TYPE(Int) | TYPE(Double)) && (top & (top - 1)) == 0) {
+        DataType t = __builtin_ctz(top);
+        char op = ins->original->code[ins->original->size - 1].word[0];
+        ins->topType = t;
+        ins->topHandler = findNumericHandler(op, t, ins->fusion == FuseDuplicate ? t : Int);
+    }
+
+    for (long long i = 0; i < ins->original->size && a->effect.bounded; i++)
+        analyzeInstruction(a, &ins->original->code[i]);
+}
+
+/**
+ * \brief Analisa uma instrução
+ * @param a   O estado da análise
+ * @param ins A instrução
+ */
+static void analyzeInstruction(Analysis* a, Instruction* ins) {
+    if (!isNumeric(ins))
+        a->effect.numeric = false;
+
+    switch (ins->type) {
+        case PushValue:
+            pushSlot(a, TYPE(ins->value.type), ins->value.type == Block ? ins->value.block : NULL);
+            break;
+
+        case PushVariable:
+            pushType(a, a->assumed);
+            break;
+
+        case PushArray: {
+            StackEffect e = ins->array->effect;
+            a->effect.pure = a->effect.pure && e.bounded && e.pure;
+            pushType(a, TYPE(Array));
+            break;
+        }
+
+        case Operation:
+            analyzeOperation(a, ins);
+            break;
+
+        case Fused:
+            analyzeFused(a, ins);
+            break;
+    }
+}
+
+/**
+ * \brief Determina o efeito de um programa sobre a stack
+ * @param p       O programa (as arrays já devem ter sido analisadas)
+ * @param assumed Os tipos assumidos para os valores iniciais da stack e para as variáveis
+ * @return        O efeito (bounded é 0 se não puder ser determinado)
+ */
+StackEffect analyzeProgram(Program p, TypeSet assumed) {
+    Analysis a;
+
+    a.known = 0;
+    a.depth = a.maxDepth = a.lowest = 0;
+    a.assumed = assumed;
+    a.effect.bounded = true;
+    a.effect.inputs = 0;
+    a.effect.growth = 0;
+    a.effect.pure = true;
+    a.effect.numeric = true;
+
+    for (long long i = 0; i < p->size && a.effect.bounded; i++)
+        analyzeInstruction(&a, &p->code[i]);
+
+    if (!a.effect.bounded) {
+        a.effect.pure = a.effect.numeric = false;
+        a.effect.minDelta = 0;
+        a.effect.maxDelta = a.effect.growth = UNBOUNDED;
+        a.effect.top = ANY_TYPE;
+        return a.effect;
+    }
+
+    a.effect.minDelta = a.depth;
+    a.effect.maxDelta = a.maxDepth;
+    a.effect.top = peekSlot(&a).types;
+    return a.effect;
+}
+
+/**
+ * \brief Escreve um limite, ou "?" se não tiver limite
+ * @param f O ficheiro
+ * @param n O limite
+ */
+static void printBound(FILE* f, long long n) {
+    if (n == UNBOUNDED)
+        fprintf(f, "?");
+    else
+        fprintf(f, "%lld", n);
+}
+
+/**
+ * \brief Escreve o efeito de um programa, por exemplo
+ * `consome 2, deixa 1, cresce 2, topo Int|BigInt, puro, numérico`
+ * @param f O ficheiro
+ * @param e O efeito
+ */
+void printStackEffect(FILE* f, StackEffect e) {
+    static const char* names[] = { "Double", "BigInt", "Int", "Char", "String", "Array", "Block" };
+
+    if (!e.bounded) {
+        fprintf(f, "efeito desconhecido");
+        return;
+    }
+
+    fprintf(f, "consome %lld, deixa ", e.inputs);
+    printBound(f, e.inputs + e.minDelta);
+    if (e.maxDelta != e.minDelta) {
+        fprintf(f, " a ");
+        printBound(f, addBound(e.inputs, e.maxDelta));
+    }
+    fprintf(f, ", cresce ");
+    printBound(f, e.growth);
+
+    fprintf(f, ", topo ");
+    if (e.top == ANY_TYPE)
+        fprintf(f, "?");
+    else
+        for (DataType t = Double, first = true; t <= Block; t++)
+            if (e.top & TYPE(t)) {
+                fprintf(f, "%s%s", first ? "" : "|", names[t]);
+                first = false;
+            }
+
+    if (e.pure)
+        fprintf(f, ", puro");
+    if (e.numeric)
+        fprintf(f, ", numérico");
+}
+
+/**
+ * \brief Escreve o efeito de cada bloco compilado da tabela, uma linha por bloco
+ * (`{texto}: efeito`)
+ * @param f O ficheiro
+ * @param t A tabela de blocos
+ */
+void printBlockEffects(FILE* f, BlockTable t) {
+    for (unsigned long long i = 0; i < t->size; i++)
+        for (BlockCode b = t->lists[i]; b != NULL; b = b->next) {
+            if (b->program == NULL)
+                continue;
+            fprintf(f, "{%.*s}: ", (int) b->length, b->source);
+            printStackEffect(f, b->program->effect);
+            fprintf(f, "\n");
+        }
+}
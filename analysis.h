@@ -0,0 +1,30 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que analisam estaticamente o efeito
+ * dos programas sobre a stack e os tipos dos valores
+ */
+
+//! Include guard
+#ifndef ANALYSIS_H
+//! Include guard
+#define ANALYSIS_H
+
+#include <stdio.h>
+#include "program.h"
+
+//! O conjunto com apenas o tipo dado
+#define TYPE(t) (1u << (t))
+//! O conjunto de todos os tipos
+#define ANY_TYPE ((1u << (Block + 1)) - 1)
+//! O conjunto dos tipos numéricos
+#define NUMERIC_SET (TYPE(Double) | TYPE(BigInt) | TYPE(Int) | TYPE(Char))
+//! O conjunto das strings e das arrays
+#define COLLECTION_SET (TYPE(String) | TYPE(Array))
+
+StackEffect analyzeProgram(Program p, TypeSet assumed);
+
+void printStackEffect(FILE* f, StackEffect e);
+
+void printBlockEffects(FILE* f, struct blockTable* t);
+
+#endif
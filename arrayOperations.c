@@ -8,6 +8,7 @@
 #include "arrayOperations.h"
 #include "blockOperations.h"
 #include "logicOperations.h"
+#include "memory.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -66,8 +67,8 @@ Value substr(Value st, Value pat) {
         }
     }
 
-    free(str);
-    free(pattern);
+    release(str);
+    release(pattern);
 
     return fromInteger(res);
 }
@@ -134,8 +135,8 @@ Value separateBySubstr(Value s, Value pat) {
     disposeValue(pat);
 
     //Libertar strings
-    free(str);
-    free(pattern);
+    release(str);
+    release(pattern);
 
     return fromStack(r);
 }
@@ -147,12 +148,20 @@ Value separateBySubstr(Value s, Value pat) {
  * @return        Retorna a stack de cima (com x elementos)
  */
 Stack split(Stack st, long long x){
+    if (isView(st)) { //basta dividir a vista
+        Stack res = subView(st, length(st) - x, x);
+        st->size -= x;
+        st->hash = 0;
+        return res;
+    }
+
     Stack res = empty();
 
     for (long long i = length(st) - x; i < length(st); i++)
-        push(res, st->values[i]);
+        push(res, takeValue(st->values[i]));
 
     st->size -= x;
+    st->hash = 0;
     return res;
 }
 
@@ -163,6 +172,7 @@ Stack split(Stack st, long long x){
  * @return        O array ordenado
  */
 Value sort(State* s, Value array, Value block) {
+    flatten(array.array);
     long long size = length(array.array);
     //Chama o merge sort
     //Esta função auxiliar é necessária pois é preciso saber de antemão
@@ -196,15 +206,38 @@ void reverseStack(Stack s) {
  */
 Stack mergeStacks(State* s, Stack l, Stack r, Value block) {
     Stack res = empty();
+    //Um bloco vazio ordena pelos próprios elementos, que são comparados sem cópias
+    bool identity = isEmptyBlock(block.block->source);
+    Stack keys = empty(); //guarda a chave do elemento de l enquanto se calcula a de r
+    Suspended pending[4];
+
+    //As stacks ficam suspensas enquanto se compara, para serem libertadas se a comparação falhar
+    suspend(s, &pending[0], l);
+    suspend(s, &pending[1], r);
+    suspend(s, &pending[2], res);
+    suspend(s, &pending[3], keys);
+
     //Enquanto nenhuma stack é vazia
     while(!isEmpty(l) && !isEmpty(r)) {
-        Value v1 = executeValue(s, deepCopy(top(l)), block);
-        Value v2 = executeValue(s, deepCopy(top(r)), block);
+        bool less;
+        if (identity)
+            less = lessThan(top(l), top(r));
+        else {
+            push(keys, executeValue(s, deepCopy(top(l)), block));
+            Value v2 = executeValue(s, deepCopy(top(r)), block);
+            Value v1 = pop(keys);
+            checkComparison(v1, v2);
+            less = lessThan(v1, v2);
+            disposeValue(v1);
+            disposeValue(v2);
+        }
 
         //Se a condição executada retorna verdadeiro, então l < r
         //Inserimos só o menor elemento
-        push(res, pop(isTrue(isLess(v1, v2)) ? l : r));
+        push(res, pop(less ? l : r));
     }
+    s->suspended = pending[0].previous;
+    disposeStack(keys);
     
     //Reverte as stacks para poder fazer merge sem trocar a ordem
     //dado os elementos estão invertidos nas stacks originais
@@ -231,10 +264,14 @@ Stack mergeSort(State* s, Stack st, Value block, long long n) {
         return st;
     //Parte a stack em duas
     Stack secondHalf = split(st, n / 2);
+    Suspended pending;
 
-    //Ordena as duas metades
+    //Ordena as duas metades; a metade que espera fica suspensa, para ser libertada se a comparação falhar
+    suspend(s, &pending, secondHalf);
     st = mergeSort(s, st, block, (n + 1) / 2);
+    pending.stack = st;
     secondHalf = mergeSort(s, secondHalf, block, n / 2);
+    s->suspended = pending.previous;
 
     //Inverter as stacks, de forma a que os elementos maiores estejam no início
     reverseStack(st);
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Mede o débito (registos por segundo) do modo -j com 1, 2, 4, ... threads,
+# até ao número de cores da máquina, e o ganho em relação a uma thread.
+#
+# Uso: ./bench.sh [executável] [número de registos]
+
+CALC=${1:-./calc}
+RECORDS=${2:-200000}
+PROGRAM='l i 100 % 200 + , {3 % 0 =} , ,'
+CORES=$(nproc)
+INPUT=$(mktemp)
+trap 'rm -f "$INPUT"' EXIT
+
+{ echo "$PROGRAM"; seq 1 "$RECORDS"; } > "$INPUT"
+
+now() {
+    date +%s%N
+}
+
+printf '%8s %12s %14s %8s\n' threads "tempo (ms)" "registos/s" ganho
+j=1
+base=0
+while [ "$j" -le "$CORES" ]; do
+    start=$(now)
+    "$CALC" -j "$j" < "$INPUT" > /dev/null
+    ms=$(( ($(now) - start) / 1000000 ))
+    [ "$ms" -gt 0 ] || ms=1
+    [ "$base" -gt 0 ] || base=$ms
+    printf '%8d %12d %14d %8s\n' "$j" "$ms" $(( RECORDS * 1000 / ms )) \
+        "$(awk "BEGIN { printf \"%.2fx\", $base / $ms }")"
+    if [ "$j" -lt "$CORES" ] && [ $(( j * 2 )) -gt "$CORES" ]; then
+        j=$CORES
+    else
+        j=$(( j * 2 ))
+    fi
+done
@@ -0,0 +1,949 @@
+/**
+ * @file
+ * @brief contém a implementação dos inteiros de precisão arbitrária
+ *
+ * As operações sobre inteiros só passam para inteiros grandes quando o resultado
+ * não cabe num long long (o que é detetado com as funções __builtin_*_overflow);
+ * qualquer resultado que volte a caber num long long é convertido de novo num
+ * Int, pelo que um valor do tipo BigInt nunca cabe num long long.
+ *
+ * A multiplicação usa o algoritmo de Karatsuba a partir de KARATSUBA_THRESHOLD
+ * algarismos e o algoritmo clássico abaixo disso; a divisão usa o algoritmo D de
+ * Knuth; a potência é calculada por quadrados sucessivos. A conversão para texto
+ * divide o número ao meio por potências de 10 até os pedaços serem pequenos, que
+ * são então divididos por 10^9 de cada vez (9 algarismos decimais por passagem).
+ */
+
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <assert.h>
+#include "bigInt.h"
+#include "memory.h"
+#include "error.h"
+
+//! Número de algarismos a partir do qual a multiplicação usa o algoritmo de Karatsuba
+#define KARATSUBA_THRESHOLD 32
+
+//! A base dos algarismos
+#define BASE 4294967296ULL
+
+//! A maior potência de 10 que cabe num algarismo
+#define DECIMAL_BASE 1000000000U
+
+//! O número de algarismos decimais de DECIMAL_BASE
+#define DECIMAL_DIGITS 9
+
+//! Número de algarismos a partir do qual a conversão para texto divide o número ao meio
+#define DECIMAL_THRESHOLD 64
+
+/**
+ * \brief Cria um inteiro com espaço para o número de algarismos dado
+ * @param size O número de algarismos
+ * @return     O inteiro (positivo, com os algarismos por inicializar)
+ */
+static BigInteger newBig(long long size) {
+    BigInteger x = allocate(BigIntAlloc, sizeof(struct bigInt) + sizeof(unsigned int) * (size > 0 ? size : 1));
+    x->references = 1;
+    x->negative = false;
+    x->size = size;
+    return x;
+}
+
+/**
+ * \brief Devolve o número de algarismos significativos (sem os zeros à esquerda)
+ * @param d Os algarismos
+ * @param n O número de algarismos
+ * @return  O número de algarismos significativos
+ */
+static long long significant(const unsigned int* d, long long n) {
+    while (n > 0 && d[n - 1] == 0)
+        n--;
+    return n;
+}
+
+/**
+ * \brief Retira os zeros à esquerda de um inteiro acabado de calcular
+ * @param x O inteiro
+ * @return  O mesmo inteiro
+ */
+static BigInteger trim(BigInteger x) {
+    x->size = significant(x->digits, x->size);
+    if (x->size == 0)
+        x->negative = false;
+    return x;
+}
+
+/**
+ * \brief Compara os módulos de dois números
+ * @param a Os algarismos do primeiro (sem zeros à esquerda)
+ * @param n O número de algarismos do primeiro
+ * @param b Os algarismos do segundo (sem zeros à esquerda)
+ * @param m O número de algarismos do segundo
+ * @return  -1, 0 ou 1 se o primeiro for menor, igual ou maior que o segundo
+ */
+static int compareDigits(const unsigned int* a, long long n, const unsigned int* b, long long m) {
+    if (n != m)
+        return n < m ? -1 : 1;
+
+    for (long long i = n - 1; i >= 0; i--)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * \brief Soma b a r, propagando o transporte pelos algarismos de r
+ * @param r O número a alterar
+ * @param n O número de algarismos de r
+ * @param b O número a somar
+ * @param m O número de algarismos de b (no máximo n)
+ * @return  O transporte que não coube em r
+ */
+static unsigned int addInto(unsigned int* r, long long n, const unsigned int* b, long long m) {
+    unsigned long long carry = 0;
+    long long i;
+
+    for (i = 0; i < m; i++) {
+        carry += (unsigned long long) r[i] + b[i];
+        r[i] = (unsigned int) carry;
+        carry >>= 32;
+    }
+    for (; carry && i < n; i++) {
+        carry += r[i];
+        r[i] = (unsigned int) carry;
+        carry >>= 32;
+    }
+    return carry;
+}
+
+/**
+ * \brief Subtrai b a r, propagando o empréstimo pelos algarismos de r
+ * @param r O número a alterar
+ * @param n O número de algarismos de r
+ * @param b O número a subtrair
+ * @param m O número de algarismos de b (no máximo n)
+ * @return  O empréstimo que faltou (0 se r era maior ou igual a b)
+ */
+static unsigned int subtractFrom(unsigned int* r, long long n, const unsigned int* b, long long m) {
+    unsigned long long borrow = 0;
+    long long i;
+
+    for (i = 0; i < m; i++) {
+        unsigned long long d = (unsigned long long) r[i] - b[i] - borrow;
+        r[i] = (unsigned int) d;
+        borrow = (d >> 32) & 1;
+    }
+    for (; borrow && i < n; i++) {
+        unsigned long long d = (unsigned long long) r[i] - borrow;
+        r[i] = (unsigned int) d;
+        borrow = (d >> 32) & 1;
+    }
+    return borrow;
+}
+
+/**
+ * \brief Multiplica um número por um algarismo e soma-lhe outro, alterando-o
+ * @param x   O número (tem de ter espaço para mais um algarismo)
+ * @param mul O multiplicador
+ * @param add A parcela
+ */
+static void multiplyAdd(BigInteger x, unsigned int mul, unsigned int add) {
+    unsigned long long carry = add;
+
+    for (long long i = 0; i < x->size; i++) {
+        carry += (unsigned long long) x->digits[i] * mul;
+        x->digits[i] = (unsigned int) carry;
+        carry >>= 32;
+    }
+    if (carry)
+        x->digits[x->size++] = (unsigned int) carry;
+}
+
+/**
+ * \brief Multiplica dois números pelo algoritmo clássico
+ * @param r Onde guardar o produto (n + m algarismos)
+ * @param a O primeiro número
+ * @param n O número de algarismos do primeiro
+ * @param b O segundo número
+ * @param m O número de algarismos do segundo
+ */
+static void schoolbook(unsigned int* r, const unsigned int* a, long long n, const unsigned int* b, long long m) {
+    memset(r, 0, sizeof(unsigned int) * (n + m));
+
+    for (long long i = 0; i < n; i++) {
+        unsigned long long carry = 0, ai = a[i];
+        if (ai == 0)
+            continue;
+
+        for (long long j = 0; j < m; j++) {
+            carry += ai * b[j] + r[i + j];
+            r[i + j] = (unsigned int) carry;
+            carry >>= 32;
+        }
+        r[i + m] = (unsigned int) carry;
+    }
+}
+
+/**
+ * \brief Multiplica dois números, pelo algoritmo de Karatsuba se ambos forem grandes.
+ *
+ * Com a = a1 * B^h + a0 e b = b1 * B^h + b0, o produto é
+ * a1b1 * B^2h + ((a0 + a1)(b0 + b1) - a0b0 - a1b1) * B^h + a0b0,
+ * o que precisa de três multiplicações de metade do tamanho em vez de quatro.
+ *
+ * @param r Onde guardar o produto (n + m algarismos)
+ * @param a O primeiro número
+ * @param n O número de algarismos do primeiro
+ * @param b O segundo número
+ * @param m O número de algarismos do segundo
+ */
+static void multiplyDigits(unsigned int* r, const unsigned int* a, long long n, const unsigned int* b, long long m) {
+    if (n < m) {
+        multiplyDigits(r, b, m, a, n);
+        return;
+    }
+
+    if (m < KARATSUBA_THRESHOLD) {
+        schoolbook(r, a, n, b, m);
+        return;
+    }
+
+    if (2 * m <= n) { //tamanhos desequilibrados: multiplica b por partes de a com o tamanho de b
+        unsigned int* t = allocate(BigIntAlloc, sizeof(unsigned int) * 2 * m);
+        memset(r, 0, sizeof(unsigned int) * (n + m));
+
+        for (long long i = 0; i < n; i += m) {
+            long long k = n - i < m ? n - i : m;
+            multiplyDigits(t, a + i, k, b, m);
+            addInto(r + i, n + m - i, t, k + m);
+        }
+        release(t);
+        return;
+    }
+
+    long long h = n / 2, n1 = n - h, m1 = m - h; //m > h, pelo que m1 > 0
+
+    //a0b0 e a1b1 ocupam as duas metades do resultado
+    multiplyDigits(r, a, h, b, h);
+    multiplyDigits(r + 2 * h, a + h, n1, b + h, m1);
+
+    //(a0 + a1) e (b0 + b1)
+    long long sn = n1 + 1, sm = h + 1;
+    unsigned int* sa = allocate(BigIntAlloc, sizeof(unsigned int) * 2 * (sn + sm));
+    unsigned int* sb = sa + sn;
+    unsigned int* z = sb + sm;
+
+    memcpy(sa, a + h, sizeof(unsigned int) * n1);
+    sa[n1] = 0;
+    addInto(sa, sn, a, h);
+    memcpy(sb, b, sizeof(unsigned int) * h);
+    sb[h] = 0;
+    addInto(sb, sm, b + h, m1);
+
+    //z = (a0 + a1)(b0 + b1) - a0b0 - a1b1, somado a partir do algarismo h
+    multiplyDigits(z, sa, sn, sb, sm);
+    subtractFrom(z, sn + sm, r, 2 * h);
+    subtractFrom(z, sn + sm, r + 2 * h, n1 + m1);
+    addInto(r + h, n + m - h, z, significant(z, sn + sm));
+
+    release(sa);
+}
+
+/**
+ * \brief Divide dois números pelo algoritmo D de Knuth
+ * @param q Onde guardar o quociente (n - m + 1 algarismos)
+ * @param r Onde guardar o resto (m algarismos)
+ * @param a O dividendo (sem zeros à esquerda)
+ * @param n O número de algarismos do dividendo (pelo menos m)
+ * @param b O divisor (sem zeros à esquerda)
+ * @param m O número de algarismos do divisor (pelo menos 1)
+ */
+static void divideDigits(unsigned int* q, unsigned int* r, const unsigned int* a, long long n, const unsigned int* b, long long m) {
+    if (m == 1) { //divisão por um só algarismo
+        unsigned long long rem = 0;
+        for (long long i = n - 1; i >= 0; i--) {
+            unsigned long long cur = (rem << 32) | a[i];
+            q[i] = (unsigned int) (cur / b[0]);
+            rem = cur % b[0];
+        }
+        r[0] = (unsigned int) rem;
+        return;
+    }
+
+    //normaliza os números para que o algarismo mais significativo do divisor seja >= BASE / 2
+    int s = __builtin_clz(b[m - 1]);
+    unsigned int* vn = allocate(BigIntAlloc, sizeof(unsigned int) * (m + n + 1));
+    unsigned int* un = vn + m;
+
+    for (long long i = m - 1; i > 0; i--)
+        vn[i] = (b[i] << s) | (unsigned int) ((unsigned long long) b[i - 1] >> (32 - s));
+    vn[0] = b[0] << s;
+    un[n] = (unsigned int) ((unsigned long long) a[n - 1] >> (32 - s));
+    for (long long i = n - 1; i > 0; i--)
+        un[i] = (a[i] << s) | (unsigned int) ((unsigned long long) a[i - 1] >> (32 - s));
+    un[0] = a[0] << s;
+
+    for (long long j = n - m; j >= 0; j--) {
+        //estima o algarismo do quociente a partir dos dois algarismos mais significativos
+        unsigned long long num = ((unsigned long long) un[j + m] << 32) | un[j + m - 1];
+        unsigned long long qhat = num / vn[m - 1], rhat = num % vn[m - 1];
+
+        while (qhat >= BASE || qhat * vn[m - 2] > ((rhat << 32) | un[j + m - 2])) {
+            qhat--;
+            rhat += vn[m - 1];
+            if (rhat >= BASE)
+                break;
+        }
+
+        //subtrai qhat vezes o divisor
+        long long k = 0, t;
+        for (long long i = 0; i < m; i++) {
+            unsigned long long p = qhat * vn[i];
+            t = (long long) un[i + j] - k - (long long) (p & 0xFFFFFFFFULL);
+            un[i + j] = (unsigned int) t;
+            k = (long long) (p >> 32) - (t >> 32);
+        }
+        t = (long long) un[j + m] - k;
+        un[j + m] = (unsigned int) t;
+
+        q[j] = (unsigned int) qhat;
+        if (t < 0) { //a estimativa era uma unidade acima: soma de novo o divisor
+            q[j]--;
+            un[j + m] += addInto(un + j, m, vn, m);
+        }
+    }
+
+    //desfaz a normalização do resto
+    for (long long i = 0; i < m - 1; i++)
+        r[i] = (un[i] >> s) | (unsigned int) ((unsigned long long) un[i + 1] << (32 - s));
+    r[m - 1] = un[m - 1] >> s;
+
+    release(vn);
+}
+
+/**
+ * \brief Cria um inteiro grande a partir de um long long
+ * @param v O valor
+ * @return  O inteiro grande
+ */
+BigInteger bigFromInteger(long long v) {
+    unsigned long long m = v < 0 ? 0 - (unsigned long long) v : (unsigned long long) v;
+    BigInteger x = newBig(2);
+
+    x->negative = v < 0;
+    x->digits[0] = (unsigned int) m;
+    x->digits[1] = (unsigned int) (m >> 32);
+    return trim(x);
+}
+
+/**
+ * \brief Cria um inteiro grande a partir da parte inteira de um double
+ * @param d O valor (finito)
+ * @return  O inteiro grande
+ */
+BigInteger bigFromDouble(double d) {
+    CHECK(isfinite(d), "conversão de um valor infinito para inteiro");
+
+    int e;
+    double f = frexp(fabs(trunc(d)), &e); //|d| = f * 2^e, com f em [0.5, 1)
+    unsigned long long mantissa = (unsigned long long) ldexp(f, 53);
+    e -= 53;
+    if (e < 0) { //os 53 bits incluem bits fracionários, que são nulos
+        mantissa >>= -e;
+        e = 0;
+    }
+
+    long long words = e / 32;
+    unsigned __int128 shifted = (unsigned __int128) mantissa << (e % 32);
+    BigInteger x = newBig(words + 3);
+
+    memset(x->digits, 0, sizeof(unsigned int) * words);
+    for (int i = 0; i < 3; i++)
+        x->digits[words + i] = (unsigned int) (shifted >> (32 * i));
+
+    x->negative = d < 0;
+    return trim(x);
+}
+
+/**
+ * \brief Cria um inteiro grande a partir do número escrito no início da string
+ * (espaços iniciais e um sinal são aceites, tal como no strtoll)
+ * @param str A string
+ * @return    O inteiro grande (0 se a string não começar por um número)
+ */
+BigInteger bigFromString(const char* str) {
+    while (*str == ' ' || (*str >= '\t' && *str <= '\r'))
+        str++;
+
+    bool negative = *str == '-';
+    if (*str == '-' || *str == '+')
+        str++;
+
+    long long n = 0;
+    while (str[n] >= '0' && str[n] <= '9')
+        n++;
+
+    //cada bloco de 9 algarismos decimais ocupa menos de um algarismo do inteiro
+    BigInteger x = newBig(n / DECIMAL_DIGITS + 2);
+    x->size = 0;
+
+    //o primeiro bloco fica com os algarismos que sobram, os restantes com 9
+    long long chunk = n % DECIMAL_DIGITS ? n % DECIMAL_DIGITS : DECIMAL_DIGITS;
+    for (long long i = 0; i < n; i += chunk, chunk = DECIMAL_DIGITS) {
+        unsigned int value = 0, scale = 1;
+        for (long long j = 0; j < chunk; j++) {
+            value = value * 10 + (str[i + j] - '0');
+            scale *= 10;
+        }
+        multiplyAdd(x, scale, value);
+    }
+
+    x->negative = negative;
+    return trim(x);
+}
+
+/**
+ * \brief Cria um #Value a partir de um inteiro grande. Se o inteiro couber num
+ * long long, é libertado e o valor criado é um Int.
+ * @param x O inteiro grande. Passa a pertencer ao valor.
+ * @return  O valor
+ */
+Value fromBigInteger(BigInteger x) {
+    if (x->size <= 2) {
+        unsigned long long m = x->size == 0 ? 0 : x->digits[0];
+        if (x->size == 2)
+            m |= (unsigned long long) x->digits[1] << 32;
+
+        if (m <= (unsigned long long) LLONG_MAX + x->negative) {
+            long long v = x->negative ? (long long) (0 - m) : (long long) m;
+            disposeBig(x);
+            return fromInteger(v);
+        }
+    }
+
+    Value v;
+    v.type = BigInt;
+    v.big = x;
+    return v;
+}
+
+/**
+ * \brief Regista mais um valor que partilha o inteiro dado
+ * @param x O inteiro
+ */
+void retainBig(BigInteger x) {
+    x->references++;
+}
+
+/**
+ * \brief Cria uma cópia do inteiro dado, que não é partilhada com nenhum valor
+ * @param x O inteiro
+ * @return  A cópia
+ */
+BigInteger copyBig(BigInteger x) {
+    BigInteger y = newBig(x->size);
+    y->negative = x->negative;
+    memcpy(y->digits, x->digits, sizeof(unsigned int) * x->size);
+    return y;
+}
+
+/**
+ * \brief Liberta o inteiro dado, se mais nenhum valor o partilhar
+ * @param x O inteiro
+ */
+void disposeBig(BigInteger x) {
+    if (--x->references == 0)
+        release(x);
+}
+
+/**
+ * \brief Converte um inteiro grande para double
+ * @param x O inteiro
+ * @return  O valor mais próximo (infinito se for demasiado grande)
+ */
+double bigToDouble(BigInteger x) {
+    //os três algarismos mais significativos chegam para os 53 bits do double
+    long long top = x->size < 3 ? x->size : 3;
+    double d = 0;
+
+    for (long long i = x->size - 1; i >= x->size - top; i--)
+        d = d * (double) BASE + x->digits[i];
+
+    d = ldexp(d, 32 * (x->size - top));
+    return x->negative ? -d : d;
+}
+
+/**
+ * \brief Devolve os 64 bits menos significativos de um inteiro grande, em
+ * complemento para dois
+ * @param x O inteiro
+ * @return  Os 64 bits, como long long
+ */
+long long bigToInteger(BigInteger x) {
+    unsigned long long m = 0;
+
+    if (x->size > 0)
+        m = x->digits[0];
+    if (x->size > 1)
+        m |= (unsigned long long) x->digits[1] << 32;
+
+    return (long long) (x->negative ? 0 - m : m);
+}
+
+/**
+ * \brief Compara dois inteiros, sem os alterar
+ * @param x O primeiro (Int, Char ou BigInt)
+ * @param y O segundo (Int, Char ou BigInt); pelo menos um deles é BigInt
+ * @return  -1, 0 ou 1 se x for menor, igual ou maior que y
+ */
+int compareBig(Value x, Value y) {
+    if (x.type != BigInt)
+        return -compareBig(y, x);
+
+    //y cabe num long long e x não
+    if (y.type != BigInt)
+        return x.big->negative ? -1 : 1;
+
+    if (x.big->negative != y.big->negative)
+        return x.big->negative ? -1 : 1;
+
+    int c = compareDigits(x.big->digits, x.big->size, y.big->digits, y.big->size);
+    return x.big->negative ? -c : c;
+}
+
+/**
+ * \brief Converte um operando inteiro para inteiro grande
+ * @param v O operando (Int, Char ou BigInt). Passa a pertencer ao resultado.
+ * @return  O inteiro grande
+ */
+static BigInteger toBig(Value v) {
+    switch (v.type) {
+        case BigInt:    return v.big;
+        case Int:       return bigFromInteger(v.integer);
+        case Char:      return bigFromInteger(v.character);
+        default:        assert(false); return NULL;
+    }
+}
+
+/**
+ * \brief Soma ou subtrai dois inteiros grandes
+ * @param x        O primeiro
+ * @param y        O segundo
+ * @param subtract 1 para calcular x - y, 0 para calcular x + y
+ * @return         O resultado
+ */
+static BigInteger addBig(BigInteger x, BigInteger y, bool subtract) {
+    bool xNegative = x->negative, yNegative = y->negative != subtract;
+
+    //o resultado tem o sinal do maior em módulo
+    if (compareDigits(x->digits, x->size, y->digits, y->size) < 0) {
+        BigInteger t = x;
+        x = y;
+        y = t;
+        bool n = xNegative;
+        xNegative = yNegative;
+        yNegative = n;
+    }
+
+    BigInteger r = newBig(x->size + 1);
+    memcpy(r->digits, x->digits, sizeof(unsigned int) * x->size);
+    r->digits[x->size] = 0;
+
+    if (xNegative == yNegative)
+        addInto(r->digits, r->size, y->digits, y->size);
+    else
+        subtractFrom(r->digits, r->size, y->digits, y->size);
+
+    r->negative = xNegative;
+    return trim(r);
+}
+
+/**
+ * \brief Multiplica dois inteiros grandes
+ * @param x O primeiro
+ * @param y O segundo
+ * @return  O produto
+ */
+static BigInteger multiplyBig(BigInteger x, BigInteger y) {
+    if (x->size == 0 || y->size == 0)
+        return newBig(0);
+
+    BigInteger r = newBig(x->size + y->size);
+    multiplyDigits(r->digits, x->digits, x->size, y->digits, y->size);
+    r->negative = x->negative != y->negative;
+    return trim(r);
+}
+
+/**
+ * \brief Divide dois inteiros grandes, truncando o quociente (tal como a
+ * divisão de inteiros em C)
+ * @param x         O dividendo
+ * @param y         O divisor (diferente de 0)
+ * @param remainder 1 para devolver o resto, 0 para devolver o quociente
+ * @return          O quociente ou o resto (com o sinal do dividendo)
+ */
+static BigInteger divideBig(BigInteger x, BigInteger y, bool remainder) {
+    assert(y->size > 0); //descartar divisão por zero
+
+    if (compareDigits(x->digits, x->size, y->digits, y->size) < 0) {
+        if (!remainder)
+            return newBig(0);
+        retainBig(x);
+        return x;
+    }
+
+    BigInteger q = newBig(x->size - y->size + 1), r = newBig(y->size);
+    divideDigits(q->digits, r->digits, x->digits, x->size, y->digits, y->size);
+    q->negative = x->negative != y->negative;
+    r->negative = x->negative;
+
+    disposeBig(remainder ? q : r);
+    return trim(remainder ? r : q);
+}
+
+/**
+ * \brief Calcula a potência de um inteiro grande por quadrados sucessivos
+ * @param x A base
+ * @param y O expoente (não negativo, menor que 2^64)
+ * @return  A potência
+ */
+static BigInteger powerBig(BigInteger x, BigInteger y) {
+    assert(!y->negative && y->size <= 2);
+
+    unsigned long long e = y->size > 0 ? y->digits[0] : 0;
+    if (y->size > 1)
+        e |= (unsigned long long) y->digits[1] << 32;
+
+    BigInteger result = bigFromInteger(1), base = x;
+    retainBig(base);
+
+    while (e > 0) {
+        if (e & 1) {
+            BigInteger t = multiplyBig(result, base);
+            disposeBig(result);
+            result = t;
+        }
+        e >>= 1;
+        if (e > 0) {
+            BigInteger t = multiplyBig(base, base);
+            disposeBig(base);
+            base = t;
+        }
+    }
+
+    disposeBig(base);
+    return result;
+}
+
+/**
+ * \brief Escreve os algarismos decimais de um bloco, com zeros à esquerda
+ * @param s     Onde escrever (DECIMAL_DIGITS caracteres)
+ * @param value O bloco
+ */
+static void writeChunk(char* s, unsigned int value) {
+    for (int i = DECIMAL_DIGITS - 1; i >= 0; i--) {
+        s[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+/**
+ * \brief Escreve um número em base 10 com exatamente o número de caracteres
+ * dado, por divisões sucessivas por 10^9 (cada resto dá 9 algarismos decimais)
+ * @param a     Os algarismos do número (são alterados)
+ * @param n     O número de algarismos
+ * @param out   Onde escrever
+ * @param width O número de caracteres (múltiplo de 9, suficiente para o número)
+ */
+static void writeSmall(unsigned int* a, long long n, char* out, long long width) {
+    char* s = out + width;
+
+    n = significant(a, n);
+    while (n > 0) {
+        unsigned long long rem = 0;
+        for (long long i = n - 1; i >= 0; i--) {
+            unsigned long long cur = (rem << 32) | a[i];
+            a[i] = (unsigned int) (cur / DECIMAL_BASE);
+            rem = cur % DECIMAL_BASE;
+        }
+        s -= DECIMAL_DIGITS;
+        writeChunk(s, (unsigned int) rem);
+        n = significant(a, n);
+    }
+    memset(out, '0', s - out);
+}
+
+/**
+ * \brief Divide um inteiro por B^k (B = 2^32), truncando
+ * @param x O inteiro
+ * @param k O expoente
+ * @return  O quociente, com o sinal de x
+ */
+static BigInteger shiftDown(BigInteger x, long long k) {
+    long long n = x->size > k ? x->size - k : 0;
+    BigInteger r = newBig(n);
+
+    memcpy(r->digits, x->digits + (x->size - n), sizeof(unsigned int) * n);
+    r->negative = x->negative;
+    return trim(r);
+}
+
+/**
+ * \brief Multiplica um inteiro por B^k (B = 2^32)
+ * @param x O inteiro
+ * @param k O expoente
+ * @return  O produto
+ */
+static BigInteger shiftUp(BigInteger x, long long k) {
+    BigInteger r = newBig(x->size + k);
+
+    memset(r->digits, 0, sizeof(unsigned int) * k);
+    memcpy(r->digits + k, x->digits, sizeof(unsigned int) * x->size);
+    r->negative = x->negative;
+    return trim(r);
+}
+
+/**
+ * \brief Calcula B^k (B = 2^32)
+ * @param k O expoente
+ * @return  A potência
+ */
+static BigInteger powerOfBase(long long k) {
+    BigInteger r = newBig(k + 1);
+
+    memset(r->digits, 0, sizeof(unsigned int) * k);
+    r->digits[k] = 1;
+    return r;
+}
+
+/**
+ * \brief Substitui um inteiro pela sua soma com outro
+ * @param x        Onde está o inteiro (é libertado e substituído pela soma)
+ * @param y        A parcela
+ * @param subtract 1 para subtrair y em vez de somar
+ */
+static void accumulate(BigInteger* x, BigInteger y, bool subtract) {
+    BigInteger r = addBig(*x, y, subtract);
+    disposeBig(*x);
+    *x = r;
+}
+
+/**
+ * \brief Calcula floor(B^2m / p), com m o número de algarismos de p, pelo
+ * método de Newton.
+ *
+ * O recíproco da metade mais significativa de p (com dois algarismos de margem)
+ * dá uma aproximação x0 com metade dos algarismos certos; um passo de Newton,
+ * x1 = x0 + x0 (B^2m - p x0) / B^2m, duplica-os, e o erro que resta (de poucas
+ * unidades) é corrigido no fim. São precisas apenas multiplicações, pelo que o
+ * custo é o de algumas multiplicações de Karatsuba.
+ *
+ * @param p O divisor (positivo)
+ * @return  O recíproco
+ */
+static BigInteger reciprocal(BigInteger p) {
+    long long m = p->size;
+    BigInteger one = powerOfBase(2 * m), x;
+
+    if (m <= KARATSUBA_THRESHOLD) //divisão direta
+        x = divideBig(one, p, false);
+    else {
+        long long h = (m + 1) / 2 + 2;
+        BigInteger top = shiftDown(p, m - h);
+        BigInteger y = reciprocal(top);
+        x = shiftUp(y, m - h);
+        disposeBig(top);
+        disposeBig(y);
+
+        //passo de Newton
+        BigInteger t = multiplyBig(p, x);
+        BigInteger e = addBig(one, t, true);
+        BigInteger u = multiplyBig(x, e);
+        BigInteger step = shiftDown(u, 2 * m);
+        accumulate(&x, step, false);
+        disposeBig(t);
+        disposeBig(e);
+        disposeBig(u);
+        disposeBig(step);
+    }
+
+    //correção: 0 <= B^2m - p x < p
+    BigInteger t = multiplyBig(p, x);
+    BigInteger r = addBig(one, t, true);
+    BigInteger unit = bigFromInteger(1);
+    disposeBig(t);
+
+    while (r->negative) {
+        accumulate(&x, unit, true);
+        accumulate(&r, p, false);
+    }
+    while (compareDigits(r->digits, r->size, p->digits, p->size) >= 0) {
+        accumulate(&x, unit, false);
+        accumulate(&r, p, true);
+    }
+
+    disposeBig(r);
+    disposeBig(unit);
+    disposeBig(one);
+    return x;
+}
+
+/**
+ * \brief Divide a por p pelo método de Barrett, com o recíproco de p já calculado:
+ * o quociente é estimado com duas multiplicações e corrigido no fim.
+ * @param a  O dividendo (não negativo, menor que B^2m, com m o número de algarismos de p)
+ * @param p  O divisor (positivo)
+ * @param mu O recíproco de p (calculado por reciprocal)
+ * @param q  Onde guardar o quociente
+ * @param r  Onde guardar o resto
+ */
+static void divideBarrett(BigInteger a, BigInteger p, BigInteger mu, BigInteger* q, BigInteger* r) {
+    BigInteger t = shiftDown(a, p->size - 1);
+    BigInteger u = multiplyBig(t, mu);
+    *q = shiftDown(u, p->size + 1);
+    disposeBig(t);
+    disposeBig(u);
+
+    t = multiplyBig(*q, p);
+    *r = addBig(a, t, true);
+    disposeBig(t);
+
+    //a estimativa fica no máximo duas unidades abaixo do quociente
+    BigInteger unit = bigFromInteger(1);
+    while (compareDigits((*r)->digits, (*r)->size, p->digits, p->size) >= 0) {
+        accumulate(q, unit, false);
+        accumulate(r, p, true);
+    }
+    disposeBig(unit);
+}
+
+/**
+ * \brief As potências de 10 usadas na conversão para texto
+ */
+typedef struct decimalPowers {
+    //! As potências 10^(9 * 2^k)
+    BigInteger powers[64];
+    //! Os recíprocos das potências (NULL enquanto não forem precisos)
+    BigInteger inverses[64];
+} DecimalPowers;
+
+/**
+ * \brief Escreve um inteiro em base 10 com exatamente o número de caracteres dado,
+ * dividindo-o por 10^(width / 2) e escrevendo cada metade recursivamente
+ * @param a      O inteiro (não negativo)
+ * @param out    Onde escrever
+ * @param width  O número de caracteres (9 * 2^(k + 1))
+ * @param p      As potências de 10
+ * @param k      O índice da potência que divide o inteiro ao meio
+ */
+static void writeDecimal(BigInteger a, char* out, long long width, DecimalPowers* p, int k) {
+    if (k < 0 || a->size < DECIMAL_THRESHOLD) {
+        unsigned int* t = allocate(BigIntAlloc, sizeof(unsigned int) * (a->size + 1));
+        memcpy(t, a->digits, sizeof(unsigned int) * a->size);
+        writeSmall(t, a->size, out, width);
+        release(t);
+        return;
+    }
+
+    BigInteger power = p->powers[k];
+    long long half = width / 2;
+    if (compareDigits(a->digits, a->size, power->digits, power->size) < 0) { //a metade mais significativa é 0
+        memset(out, '0', half);
+        writeDecimal(a, out + half, half, p, k - 1);
+        return;
+    }
+
+    if (p->inverses[k] == NULL)
+        p->inverses[k] = reciprocal(power);
+
+    BigInteger q, r;
+    divideBarrett(a, power, p->inverses[k], &q, &r);
+    writeDecimal(q, out, half, p, k - 1);
+    writeDecimal(r, out + half, half, p, k - 1);
+    disposeBig(q);
+    disposeBig(r);
+}
+
+/**
+ * \brief Converte um inteiro grande para texto em base 10
+ *
+ * Os números pequenos são divididos por 10^9 até chegarem a 0. Os grandes são
+ * divididos ao meio por potências 10^(9 * 2^k), calculadas por quadrados
+ * sucessivos, e cada metade é convertida recursivamente. As divisões usam o
+ * recíproco de cada potência, calculado uma única vez, pelo que a conversão
+ * custa O(M(n) log n), com M(n) o custo de uma multiplicação de Karatsuba.
+ *
+ * A string devolvida deve ser libertada com release.
+ *
+ * @param x O inteiro
+ * @return  O texto
+ */
+char* bigToString(BigInteger x) {
+    //a menor potência 10^(9 * 2^k) maior que x dá o número de caracteres a escrever
+    DecimalPowers p;
+    int k = 0;
+    p.powers[0] = bigFromInteger(DECIMAL_BASE);
+    p.inverses[0] = NULL;
+    while (compareDigits(x->digits, x->size, p.powers[k]->digits, p.powers[k]->size) >= 0) {
+        p.powers[k + 1] = multiplyBig(p.powers[k], p.powers[k]);
+        p.inverses[++k] = NULL;
+    }
+
+    long long width = (long long) DECIMAL_DIGITS << k;
+    char* str = allocate(TempString, width + 2);
+    BigInteger magnitude = shiftDown(x, 0);
+    magnitude->negative = false;
+    writeDecimal(magnitude, str + 1, width, &p, k - 1);
+    str[width + 1] = '\0';
+    disposeBig(magnitude);
+
+    for (int i = 0; i <= k; i++) {
+        disposeBig(p.powers[i]);
+        if (p.inverses[i] != NULL)
+            disposeBig(p.inverses[i]);
+    }
+
+    //retira os zeros à esquerda (deixando pelo menos um algarismo)
+    long long skip = 0;
+    while (skip < width - 1 && str[1 + skip] == '0')
+        skip++;
+    if (x->negative) //o sinal ocupa a posição anterior ao primeiro algarismo
+        str[skip] = '-';
+    else
+        skip++;
+
+    memmove(str, str + skip, width + 1 - skip + 1);
+    return str;
+}
+
+/**
+ * \brief Efetua uma operação aritmética exata entre dois inteiros
+ * @param op O operador ('+', '-', '*', '/', '%' ou '#')
+ * @param a  O primeiro operando (Int, Char ou BigInt). É libertado.
+ * @param b  O segundo operando (Int, Char ou BigInt). É libertado.
+ * @return   O resultado (Int se couber num long long, BigInt caso contrário)
+ */
+Value bigArithmetic(char op, Value a, Value b) {
+    BigInteger x = toBig(a), y = toBig(b), r;
+
+    if (op == '#' && y->size > 2) { //expoentes a partir de 2^64 esgotariam a memória
+        disposeBig(x);
+        disposeBig(y);
+        raiseError("expoente demasiado grande");
+    }
+
+    switch (op) {
+        case '+':   r = addBig(x, y, false);        break;
+        case '-':   r = addBig(x, y, true);         break;
+        case '*':   r = multiplyBig(x, y);          break;
+        case '/':   r = divideBig(x, y, false);     break;
+        case '%':   r = divideBig(x, y, true);      break;
+        default:    r = powerBig(x, y);             break;
+    }
+
+    disposeBig(x);
+    disposeBig(y);
+    return fromBigInteger(r);
+}
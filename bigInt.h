@@ -0,0 +1,56 @@
+/**
+ * @file
+ * @brief contém a definição dos inteiros de precisão arbitrária e a declaração
+ * das funções que operam sobre eles
+ */
+
+//! Include guard
+#ifndef BIG_INT_H
+//! Include guard
+#define BIG_INT_H
+
+#include "stack.h"
+
+/**
+ * \brief Representa um inteiro de precisão arbitrária, em sinal e módulo.
+ *
+ * O módulo é guardado em base 2^32, do algarismo menos significativo para o
+ * mais significativo. Um inteiro grande nunca é alterado depois de criado, pelo
+ * que é partilhado pelas cópias do valor (com contagem de referências).
+ */
+typedef struct bigInt {
+    //! O número de valores que partilham o inteiro
+    long long references;
+    //! 1 se o inteiro for negativo
+    bool negative;
+    //! O número de algarismos (o mais significativo nunca é 0)
+    long long size;
+    //! Os algarismos
+    unsigned int digits[];
+} * BigInteger;
+
+BigInteger bigFromInteger(long long v);
+
+BigInteger bigFromDouble(double d);
+
+BigInteger bigFromString(const char* str);
+
+Value fromBigInteger(BigInteger x);
+
+void retainBig(BigInteger x);
+
+BigInteger copyBig(BigInteger x);
+
+void disposeBig(BigInteger x);
+
+double bigToDouble(BigInteger x);
+
+long long bigToInteger(BigInteger x);
+
+char* bigToString(BigInteger x);
+
+int compareBig(Value x, Value y);
+
+Value bigArithmetic(char op, Value a, Value b);
+
+#endif
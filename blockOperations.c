@@ -11,6 +11,15 @@
 #include "logicOperations.h"
 #include "stackOperations.h"
 #include "arrayOperations.h"
+#include "trace.h"
+#include "memory.h"
+#include "optimizer.h"
+#include "jit.h"
+#include "profile.h"
+#include "error.h"
+
+//! Número inicial de listas da tabela de dispersão dos blocos
+#define BLOCK_TABLE_SIZE 1024
 
 /**
  * \brief Avalia se um bloco representa a instrução vazia
@@ -24,6 +33,134 @@ bool isEmptyBlock(char* a) {
     return true;
 }
 
+/**
+ * \brief Calcula o hash do texto de um bloco (FNV-1a)
+ * @param source  o texto do bloco
+ * @param length  o tamanho do texto
+ * @return O hash
+ */
+static unsigned long long blockHash(char* source, long long length) {
+    unsigned long long h = 14695981039346656037ULL;
+
+    for (long long i = 0; i < length; i++)
+        h = (h ^ (unsigned char) source[i]) * 1099511628211ULL;
+
+    return h;
+}
+
+/**
+ * \brief Cria uma tabela de blocos vazia
+ * @return A tabela
+ */
+BlockTable newBlockTable() {
+    BlockTable t = allocate(ProgramAlloc, sizeof(struct blockTable));
+    t->lists = NULL;
+    t->size = t->count = 0;
+    return t;
+}
+
+/**
+ * \brief Duplica o número de listas da tabela de blocos
+ * @param t A tabela
+ */
+static void growBlockTable(BlockTable t) {
+    unsigned long long size = t->size ? t->size * 2 : BLOCK_TABLE_SIZE;
+    BlockCode* table = allocate(ProgramAlloc, sizeof(BlockCode) * size);
+    memset(table, 0, sizeof(BlockCode) * size);
+
+    for (unsigned long long i = 0; i < t->size; i++) {
+        while (t->lists[i] != NULL) {
+            BlockCode b = t->lists[i];
+            t->lists[i] = b->next;
+            b->next = table[b->hash % size];
+            table[b->hash % size] = b;
+        }
+    }
+
+    if (t->lists != NULL)
+        release(t->lists);
+    t->lists = table;
+    t->size = size;
+}
+
+/**
+ * \brief Devolve o bloco com o texto dado, criando-o se ainda não existir.
+ * Blocos com o mesmo texto são sempre o mesmo objeto.
+ * @param t       a tabela de blocos
+ * @param source  o texto do bloco (não precisa de terminar em '\0')
+ * @param length  o tamanho do texto
+ * @return O bloco (pertence à tabela, não deve ser libertado)
+ */
+BlockCode internBlock(BlockTable t, char* source, long long length) {
+    unsigned long long h = blockHash(source, length);
+
+    for (BlockCode b = t->size ? t->lists[h % t->size] : NULL; b != NULL; b = b->next)
+        if (b->hash == h && b->length == length && memcmp(b->source, source, length) == 0)
+            return b;
+
+    if (t->count >= t->size)
+        growBlockTable(t);
+
+    BlockCode b = allocate(BlockString, sizeof(struct block));
+    b->source = allocate(BlockString, length + 1);
+    memcpy(b->source, source, length);
+    b->source[length] = '\0';
+    b->length = length;
+    b->hash = h;
+    b->program = NULL;
+    b->calls = 0;
+    b->jit = NULL;
+
+    b->next = t->lists[h % t->size];
+    t->lists[h % t->size] = b;
+    t->count++;
+    return b;
+}
+
+/**
+ * \brief Devolve o programa compilado do bloco dado. Os blocos são normalmente
+ * compilados juntamente com o programa onde aparecem; os restantes são
+ * compilados na primeira vez que são executados, com a tabela de blocos do estado.
+ * @param s       o estado do programa
+ * @param block   o bloco
+ * @return O programa compilado (pertence ao bloco, não deve ser libertado)
+ */
+Program compileBlock(State* s, BlockCode block) {
+    if (block->program == NULL) {
+        //o programa pertence à tabela de blocos e não pode ser alocado na região ativa
+        Region r = enterRegion(NULL);
+        char* str = block->source;
+        Program program = compileInput(&str, s->blocks);
+        optimizeProgram(program);
+        block->program = program;
+        enterRegion(r);
+    }
+    return block->program;
+}
+
+/**
+ * \brief Liberta uma tabela de blocos, com todos os blocos e os respetivos
+ * programas compilados
+ * @param t A tabela
+ */
+void disposeBlockTable(BlockTable t) {
+    for (unsigned long long i = 0; i < t->size; i++) {
+        while (t->lists[i] != NULL) {
+            BlockCode b = t->lists[i];
+            t->lists[i] = b->next;
+            if (b->program != NULL)
+                disposeProgram(b->program);
+            disposeJit(b->jit);
+            release(b->source);
+            release(b);
+        }
+    }
+
+    if (t->lists != NULL)
+        release(t->lists);
+    release(t);
+}
+
 /**
  * \brief Executa um bloco dentro de uma stack
  * @param s O estado do programa
@@ -32,10 +169,21 @@ bool isEmptyBlock(char* a) {
  * @return Value que é resultado da operação do bloco dentro da stack
  */
 void execute (State* s, Stack st, Value block) {
-    Stack temp = s->stack;
-    s->stack = st;
-    processInput (&block.block, s);
-    s->stack = temp;
+    Suspended temp = { s->stack, s->suspended };
+    if (st != s->stack) { //a stack atual fica suspensa enquanto o bloco é executado
+        s->suspended = &temp;
+        s->stack = st;
+    }
+
+    if (tracing) {
+        traceEnter(block.block);
+        runProgram(compileBlock(s, block.block), s);
+        traceExit();
+    } else if (!jitExecute(s, block.block))
+        runProgram(compileBlock(s, block.block), s);
+
+    s->stack = temp.stack;
+    s->suspended = temp.previous;
 }
 
 /**
@@ -49,30 +197,134 @@ Value executeValue(State* s, Value a, Value block) {
     Stack temp = empty();
     push(temp, a);
     execute(s, temp, block);
+    if (isEmpty(temp)) { //o bloco não deixou o resultado
+        disposeStack(temp);
+        raiseError("a stack está vazia");
+    }
     Value ans = pop(temp);
     disposeStack(temp);
     return ans;
 }
 
+/**
+ * \brief Verifica se a instrução pode ser fundida com a condição de um ciclo `w`
+ * @param ins A última instrução do bloco do ciclo
+ * @return    1 se for um dos operadores `_`, `<`, `>` ou `=`, 0 caso contrário
+ */
+static bool fusableCondition(Instruction* ins) {
+    return ins->type == Operation && ins->length == 1 && strchr("_<>=", ins->word[0]) != NULL;
+}
+
+/**
+ * \brief Compara dois inteiros ou dois doubles, tal como os operadores `<`, `>` e `=`
+ * @param op O operador
+ * @param x  O primeiro valor
+ * @param y  O segundo valor (do mesmo tipo que x)
+ * @return   O resultado da comparação (falso com NaN)
+ */
+static bool compareScalars(char op, Value x, Value y) {
+    if (x.type == Int)
+        return op == '<' ? x.integer < y.integer : op == '>' ? x.integer > y.integer : x.integer == y.integer;
+    return op == '<' ? x.decimal < y.decimal : op == '>' ? x.decimal > y.decimal : x.decimal == y.decimal;
+}
+
+/**
+ * \brief Avalia a condição de um ciclo `w`, retirando-a da stack.
+ *
+ * Se a última instrução do bloco for fundida com a condição, a condição é
+ * calculada diretamente sobre a stack, sem criar o valor: com `_` testa-se o
+ * topo sem o duplicar, e com `<`, `>` e `=` sobre dois inteiros (ou dois doubles)
+ * compara-se os valores. Nos restantes casos a instrução é executada normalmente.
+ *
+ * @param s    O estado do programa
+ * @param last A última instrução do bloco, se tiver sido fundida (NULL se não)
+ * @return     1 se a condição for verdadeira, 0 se for falsa ou se a stack ficar vazia
+ */
+static bool loopCondition(State* s, Instruction* last) {
+    if (last != NULL) {
+        Stack st = s->stack;
+        char op = last->word[0];
+
+        if (op == '_' && st->size >= 1)
+            return isTrue(top(st));
+
+        if (op != '_' && st->size >= 2) {
+            Value x = valueAt(st, st->size - 2), y = valueAt(st, st->size - 1);
+            if (x.type == y.type && (x.type == Int || x.type == Double)) {
+                bool r = compareScalars(op, x, y);
+                eraseTop(st);
+                eraseTop(st);
+                return r;
+            }
+        }
+
+        runInstruction(last, s);
+    }
+
+    if (isEmpty(s->stack))
+        return false;
+
+    Value c = pop(s->stack);
+    bool r = isTrue(c);
+    disposeValue(c);
+    return r;
+}
+
 /**
  * \brief Executa um bloco dentro de uma stack enquanto houver um valor verdadeiro no topo da stack
- * @param st a stack fornecida
+ *
+ * O bloco é compilado uma única vez e o seu programa é executado diretamente em
+ * cada iteração; a última instrução do bloco é fundida com o teste da condição
+ * (ver loopCondition), exceto quando o ciclo está a ser registado pelo trace
+ * ou quando as sequências de instruções estão a ser contadas (ver profile.c).
+ * Quando o bloco tem código máquina (ver jit.c), este executa o bloco inteiro
+ * e a condição é apenas retirada da stack.
+ *
+ * @param s     o estado do programa
  * @param block bloco fornecido
  */
 void executeWhileTrue (State* s, Value block) {
-    push(s->stack, fromInteger(1)); //Adiciona um valor verdadeiro no topo da stack para este não se perder no pop do while
-    bool dispose = false;
-    while (!isEmpty(s->stack) && (dispose = true) && isTrue(top(s->stack))) {
-        eraseTop(s->stack);
-        dispose = false;
-        execute (s, s->stack, block);
+    CHECK_OPERAND(block.type == Block, "o operando tem de ser um bloco", block);
+    Program p = compileBlock(s, block.block);
+    Instruction* last = NULL;
+    struct program body = *p; //o efeito de p também serve para body (sem a última instrução, não consome nem cresce mais)
+
+    if (!tracing && !profiling && body.size > 0 && fusableCondition(&body.code[body.size - 1])) {
+        last = &body.code[body.size - 1];
+        body.size--;
     }
-    
-    if (dispose)
-        eraseTop(s->stack); //Apaga o zero que está no topo da stack
+
+    bool again;
+    do {
+        if (tracing) {
+            traceEnter(block.block);
+            runProgram(&body, s);
+            traceExit();
+            again = loopCondition(s, last);
+        } else if (jitExecute(s, block.block)) //o código máquina executa o bloco inteiro
+            again = loopCondition(s, NULL);
+        else {
+            runProgram(&body, s);
+            again = loopCondition(s, last);
+        }
+    } while (again);
+
     disposeValue(block);
 }
 
+/**
+ * \brief Regista uma stack auxiliar nas stacks suspensas do estado, para que seja
+ * libertada se a execução de um bloco falhar
+ * @param s     o estado do programa
+ * @param entry o registo (deve existir até a stack deixar de estar suspensa)
+ * @param st    a stack auxiliar
+ */
+void suspend(State* s, Suspended* entry, Stack st) {
+    entry->stack = st;
+    entry->previous = s->suspended;
+    s->suspended = entry;
+}
+
 /**
  * \brief Mofica cada valor da array para a respetiva imagem pela função block.
  * @param s     o estado do programa
@@ -80,14 +332,18 @@ void executeWhileTrue (State* s, Value block) {
  */
 void map (State* s, Stack st, Value block){
     Stack aux = empty();
+    Suspended pending;
+    materialize(st); //os elementos vão ser retirados e alterados
 
     while (!isEmpty(st))
         push(aux, pop(st));
 
+    suspend(s, &pending, aux);
     while (!isEmpty(aux)) {
         push(st, pop(aux));
         execute(s, st, block);
     }
+    s->suspended = pending.previous;
 
     disposeStack(aux);
 }
@@ -99,13 +355,20 @@ void map (State* s, Stack st, Value block){
  */
 void filter (State* s, Stack st, Value block){
     Stack aux = empty(); //stack para conter os elementos pela ordem certa
+    Suspended pending;
+    materialize(st); //os elementos vão ser retirados e alterados
 
     while (!isEmpty(st)) //colocar os elementos
         push(aux, pop(st));
 
+    suspend(s, &pending, aux);
     while (!isEmpty(aux)) {
         push(st, deepCopy(top(aux)));
         execute(s, st, block); //executa a comparação
+        if (isEmpty(st)) { //o bloco não deixou o resultado: a array é libertada (aux está suspensa)
+            disposeStack(st);
+            raiseError("a stack está vazia");
+        }
         Value a = pop(st);
         if (isTrue(a))
             push(st, pop(aux));
@@ -113,6 +376,7 @@ void filter (State* s, Stack st, Value block){
             eraseTop(aux);
         disposeValue(a);
     }
+    s->suspended = pending.previous;
 
     disposeStack(aux);
 }
@@ -125,14 +389,18 @@ void filter (State* s, Stack st, Value block){
  */
 void fold (State* s, Stack st, Value block){
     Stack aux = empty();
+    Suspended pending;
+    materialize(st); //os elementos vão ser retirados e alterados
 
     while (length(st) > 1)
         push(aux, pop(st));
 
+    suspend(s, &pending, aux);
     while (!isEmpty(aux)) {
         push(st, pop(aux));
         execute(s, st, block);
     }
+    s->suspended = pending.previous;
 
     disposeStack(aux);
 }
\ No newline at end of file
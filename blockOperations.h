@@ -10,10 +10,34 @@
 #define BLOCK_OPERATIONS_H
 
 #include "stack.h"
+#include "program.h"
 #include "logicOperations.h"
 
+/**
+ * \brief Representa uma tabela de dispersão de blocos, indexada pelo texto do
+ * bloco. Cada contexto de execução tem a sua tabela.
+ */
+typedef struct blockTable {
+    //! As listas de blocos
+    BlockCode* lists;
+    //! O número de listas
+    unsigned long long size;
+    //! O número de blocos guardados
+    unsigned long long count;
+} * BlockTable;
+
 bool isEmptyBlock(char* a);
 
+BlockTable newBlockTable();
+
+BlockCode internBlock(BlockTable t, char* source, long long length);
+
+Program compileBlock(State* s, BlockCode block);
+
+void disposeBlockTable(BlockTable t);
+
+void suspend(State* s, Suspended* entry, Stack st);
+
 void execute (State* s, Stack st, Value block);
 
 Value executeValue(State* s, Value a, Value block);
@@ -0,0 +1,134 @@
+/**
+ * @file
+ * @brief contém a implementação da interface para usar a calculadora como
+ * biblioteca (libcalc)
+ *
+ * O input dado a calcEvaluate não é copiado: os operadores `l` e `t` leem-no
+ * diretamente do buffer do chamador. Os valores devolvidos por calcResult
+ * pertencem ao contexto e são válidos até à próxima chamada de calcEvaluate,
+ * calcReset ou calcDestroy. As strings e as arrays são stacks de valores
+ * (length e getElement; os valores das arrays grandes interiores podem estar
+ * numa árvore RRB, de onde são passados para um buffer com flatten); o texto de
+ * uma string pode ser obtido com toString e o de um inteiro grande com
+ * bigToString (ambos libertados com release).
+ */
+
+#include <string.h>
+#include "calc.h"
+#include "parser.h"
+#include "memory.h"
+
+/**
+ * \brief Representa um contexto de execução da calculadora
+ */
+struct calcContext {
+    //! O estado do programa (stack e variáveis)
+    State state;
+    //! A tabela dos blocos compilados pelo contexto
+    BlockTable blocks;
+    //! O erro da última avaliação que falhou
+    EvalError error;
+};
+
+//! O input de um contexto fora de calcEvaluate (os operadores `l` e `t` nunca leem do stdin)
+static const char noInput[] = "";
+
+/**
+ * \brief Cria um contexto, com a stack vazia e as variáveis com os valores iniciais
+ * @return O contexto, que deve ser libertado com calcDestroy
+ */
+CalcContext calcCreate() {
+    CalcContext ctx = allocate(StackAlloc, sizeof(struct calcContext));
+    ctx->blocks = newBlockTable();
+    initializeState(&ctx->state, ctx->blocks);
+    ctx->state.input = ctx->state.inputEnd = noInput;
+    ctx->error = (EvalError) { "", "", -1 };
+    return ctx;
+}
+
+/**
+ * \brief Liberta um contexto e todos os seus valores e blocos
+ * @param ctx O contexto
+ */
+void calcDestroy(CalcContext ctx) {
+    disposeState(&ctx->state);
+    disposeBlockTable(ctx->blocks);
+    release(ctx);
+}
+
+/**
+ * \brief Executa um programa sobre o estado do contexto.
+ *
+ * A stack e as variáveis resultantes de avaliações anteriores são mantidas
+ * (ver calcReset). Se ocorrer um erro, a stack fica vazia e o erro pode ser
+ * consultado com calcError.
+ *
+ * @param ctx         O contexto
+ * @param program     O texto do programa (termina no primeiro '\n' ou '\0')
+ * @param input       O input lido pelos operadores `l` e `t` (pode ser NULL se inputLength for 0)
+ * @param inputLength O tamanho do input
+ * @return            1 se o programa foi executado até ao fim, 0 se ocorreu um erro
+ */
+bool calcEvaluate(CalcContext ctx, const char* program, const char* input, long long inputLength) {
+    char* str = (char*) program; //o texto do programa não é alterado pela compilação
+
+    ctx->state.input = inputLength > 0 ? input : noInput;
+    ctx->state.inputEnd = ctx->state.input + inputLength;
+
+    bool ok = tryProcessInput(&str, &ctx->state, &ctx->error);
+
+    ctx->state.input = ctx->state.inputEnd = noInput;
+    return ok;
+}
+
+/**
+ * \brief Devolve o erro da última avaliação que falhou
+ * @param ctx O contexto
+ * @return    O erro (pertence ao contexto)
+ */
+const EvalError* calcError(CalcContext ctx) {
+    return &ctx->error;
+}
+
+/**
+ * \brief Devolve o número de valores na stack do contexto
+ * @param ctx O contexto
+ * @return    O número de valores
+ */
+long long calcResultSize(CalcContext ctx) {
+    return length(ctx->state.stack);
+}
+
+/**
+ * \brief Devolve um valor da stack do contexto, sem o retirar
+ * @param ctx O contexto
+ * @param i   A posição do valor (0 é o fundo da stack)
+ * @return    O valor (pertence ao contexto; uma string ou array tem os
+ *            valores num buffer, ver flatten)
+ */
+Value calcResult(CalcContext ctx, long long i) {
+    return flattened(valueAt(ctx->state.stack, i));
+}
+
+/**
+ * \brief Esvazia a stack e repõe os valores iniciais das variáveis. Os blocos
+ * compilados são mantidos para as avaliações seguintes.
+ * @param ctx O contexto
+ */
+void calcReset(CalcContext ctx) {
+    FILE* output = ctx->state.output;
+
+    disposeState(&ctx->state);
+    initializeState(&ctx->state, ctx->blocks);
+    ctx->state.input = ctx->state.inputEnd = noInput;
+    ctx->state.output = output;
+}
+
+/**
+ * \brief Define o ficheiro onde o operador `p` escreve (por omissão o stdout)
+ * @param ctx O contexto
+ * @param f   O ficheiro
+ */
+void calcSetOutput(CalcContext ctx, FILE* f) {
+    ctx->state.output = f;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file
+ * @brief contém a declaração da interface para usar a calculadora como
+ * biblioteca (libcalc), sem passar pelo main
+ *
+ * Cada contexto tem o seu estado (stack e variáveis) e a sua tabela de blocos
+ * compilados, e nenhuma das funções usa variáveis globais partilhadas, pelo que
+ * contextos diferentes podem ser usados ao mesmo tempo em threads diferentes.
+ * Cada contexto só pode ser usado por uma thread de cada vez.
+ *
+ * A biblioteca é composta por todos os ficheiros .c exceto o main.c.
+ */
+
+//! Include guard
+#ifndef CALC_H
+//! Include guard
+#define CALC_H
+
+#include <stdio.h>
+#include "stack.h"
+#include "error.h"
+
+//! Um contexto de execução da calculadora
+typedef struct calcContext* CalcContext;
+
+CalcContext calcCreate();
+
+void calcDestroy(CalcContext ctx);
+
+bool calcEvaluate(CalcContext ctx, const char* program, const char* input, long long inputLength);
+
+const EvalError* calcError(CalcContext ctx);
+
+long long calcResultSize(CalcContext ctx);
+
+Value calcResult(CalcContext ctx, long long i);
+
+void calcReset(CalcContext ctx);
+
+void calcSetOutput(CalcContext ctx, FILE* f);
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que assinalam e recuperam os erros
+ * de avaliação
+ *
+ * Uma avaliação começa com beginEvaluation, seguida de um setjmp sobre o
+ * boundary da avaliação. Quando um operador encontra operandos inválidos, chama
+ * raiseError: as stacks em uso pelo programa (a stack atual e as que estavam
+ * suspensas por blocos e arrays em construção) são libertadas, a stack do
+ * estado fica vazia e a execução regressa ao setjmp com a descrição do erro.
+ * As variáveis mantêm os valores que tinham no momento do erro.
+ *
+ * Os operadores libertam os seus operandos antes de assinalar um erro
+ * (CHECK_OPERAND e CHECK_OPERANDS), e as stacks auxiliares de `%`, `,`, `*` e
+ * `$` com blocos (incluindo as metades de uma ordenação) são registadas como
+ * suspensas (ver suspend). As stacks temporárias que não estão suspensas, como
+ * a de executeValue, são libertadas pela própria operação antes do erro.
+ */
+
+#include <stdlib.h>
+#include "error.h"
+#include "trace.h"
+
+//! A avaliação em curso na thread (NULL se não houver)
+static _Thread_local Evaluation* active = NULL;
+
+/**
+ * \brief Inicia uma avaliação sobre o estado dado. Os erros assinalados até
+ * endEvaluation regressam ao boundary da avaliação.
+ * @param ev A avaliação
+ * @param st O estado a avaliar
+ */
+void beginEvaluation(Evaluation* ev, State* st) {
+    ev->state = st;
+    ev->suspended = st->suspended;
+    ev->traceDepth = tracing ? traceDepth() : 0;
+    ev->instruction = st->current;
+    ev->previous = active;
+    active = ev;
+}
+
+/**
+ * \brief Termina a avaliação mais recente
+ * @param ev A avaliação
+ */
+void endEvaluation(Evaluation* ev) {
+    active = ev->previous;
+}
+
+/**
+ * \brief Liberta as stacks em uso pela avaliação, deixando a stack do estado vazia
+ * @param ev A avaliação
+ */
+static void unwind(Evaluation* ev) {
+    State* st = ev->state;
+
+    while (st->suspended != ev->suspended) {
+        disposeStack(st->stack);
+        st->stack = st->suspended->stack;
+        st->suspended = st->suspended->previous;
+    }
+
+    disposeStack(st->stack);
+    st->stack = empty();
+
+    if (tracing)
+        traceUnwind(ev->traceDepth);
+}
+
+/**
+ * \brief Assinala um erro de avaliação no operador em execução, regressando ao
+ * boundary da avaliação em curso. Sem nenhuma avaliação em curso, o erro é
+ * escrito no stderr e o programa termina.
+ * @param message A descrição do erro
+ */
+_Noreturn void raiseError(const char* message) {
+    EvalError error = { message, "", -1 };
+    Evaluation* ev = active;
+
+    if (ev != NULL && ev->state->current != NULL) {
+        Instruction* ins = ev->state->current;
+        error.word[0] = ins->word[0];
+        error.word[1] = ins->word[1];
+        error.word[2] = '\0';
+        error.position = ins->position;
+    }
+
+    if (ev == NULL) {
+        printError(stderr, &error);
+        abort();
+    }
+
+    ev->state->current = ev->instruction;
+    active = ev->previous;
+    unwind(ev);
+    ev->error = error;
+    longjmp(ev->boundary, 1);
+}
+
+/**
+ * \brief Escreve a descrição de um erro de avaliação
+ * @param f     O ficheiro onde escrever
+ * @param error O erro
+ */
+void printError(FILE* f, EvalError* error) {
+    if (error->word[0] == '\0')
+        fprintf(f, "erro: %s\n", error->message);
+    else if (error->position < 0)
+        fprintf(f, "erro: %s (operador `%s`)\n", error->message, error->word);
+    else
+        fprintf(f, "erro: %s (operador `%s` na coluna %lld)\n", error->message, error->word, error->position + 1);
+}
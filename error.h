@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @brief contém a definição dos erros de avaliação e a declaração das funções
+ * que os assinalam e recuperam
+ */
+
+//! Include guard
+#ifndef ERROR_H
+//! Include guard
+#define ERROR_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "stack.h"
+#include "program.h"
+
+//! Assinala um erro de avaliação com a mensagem dada se a condição for falsa
+#define CHECK(condition, message) \
+    do { if (__builtin_expect(!(condition), 0)) raiseError(message); } while (0)
+
+//! Tal como CHECK, mas liberta o operando dado antes de assinalar o erro
+#define CHECK_OPERAND(condition, message, a) \
+    do { if (__builtin_expect(!(condition), 0)) { disposeValue(a); raiseError(message); } } while (0)
+
+//! Tal como CHECK, mas liberta os operandos dados antes de assinalar o erro
+#define CHECK_OPERANDS(condition, message, a, b) \
+    do { if (__builtin_expect(!(condition), 0)) { disposeValue(a); disposeValue(b); raiseError(message); } } while (0)
+
+/**
+ * \brief Descreve um erro ocorrido durante a avaliação de um programa
+ */
+typedef struct evalError {
+    //! A descrição do erro
+    const char* message;
+    //! Os dois primeiros caracteres do operador que falhou (vazio se não for conhecido)
+    char word[3];
+    //! A posição do operador no texto de onde foi compilado (-1 se não for conhecida)
+    long long position;
+} EvalError;
+
+/**
+ * \brief Representa uma fronteira de avaliação: o ponto para onde a execução
+ * regressa quando ocorre um erro, abandonando o resto do programa
+ */
+typedef struct evaluation {
+    //! O contexto guardado por setjmp no início da avaliação
+    jmp_buf boundary;
+    //! O estado avaliado
+    State* state;
+    //! As stacks que já estavam suspensas no início da avaliação
+    Suspended* suspended;
+    //! A profundidade do registo da execução no início da avaliação
+    long long traceDepth;
+    //! A instrução em execução no início da avaliação
+    Instruction* instruction;
+    //! O erro que interrompeu a avaliação
+    EvalError error;
+    //! A avaliação em curso quando esta começou (NULL se não houver)
+    struct evaluation* previous;
+} Evaluation;
+
+void beginEvaluation(Evaluation* ev, State* st);
+
+void endEvaluation(Evaluation* ev);
+
+_Noreturn void raiseError(const char* message);
+
+void printError(FILE* f, EvalError* error);
+
+#endif
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Verifica que os operadores rejeitam os operandos inválidos com um erro, em
+# vez de abortar ou de devolver valores indefinidos, e que os operandos dos
+# registos que falham são libertados.
+#
+# Uso: ./errors.sh [executável]
+
+CALC=${1:-./calc}
+FAILED=0
+
+# expect programa mensagem: o programa tem de falhar com a mensagem dada
+expect() {
+    out=$(echo "$1" | "$CALC" 2>&1)
+    status=$?
+    if [ "$status" -ne 1 ] || [ "$out" != "$2" ]; then
+        printf 'FALHOU: %s\n  esperado: %s\n  obtido:   %s (estado %d)\n' "$1" "$2" "$out" "$status"
+        FAILED=1
+    fi
+}
+
+# leaks programa: o programa falha em vários registos sem deixar memória por libertar
+leaks() {
+    live=$( (echo "$1"; seq 20) | "$CALC" -j 1 -m 2>&1 >/dev/null | awk '$1 == "total" { print $2 }')
+    if [ "$live" != "0" ]; then
+        printf 'FALHOU: %s\n  memória por libertar: %s\n' "$1" "$live"
+        FAILED=1
+    fi
+}
+
+expect '{1 -} 1000 *' 'erro: operação não definida para blocos (operador `*` na coluna 12)'
+expect '{1 2 3 4 5 6 7 8} 100000 *' 'erro: operação não definida para blocos (operador `*` na coluna 26)'
+expect '[Y] i' 'erro: operação não definida para arrays (operador `i` na coluna 5)'
+expect '{1} i' 'erro: operação não definida para blocos (operador `i` na coluna 5)'
+expect '[1 2] f' 'erro: operação não definida para arrays (operador `f` na coluna 7)'
+expect '{1} f' 'erro: operação não definida para blocos (operador `f` na coluna 5)'
+expect '[1] c' 'erro: operação não definida para arrays (operador `c` na coluna 5)'
+expect '{1} c' 'erro: operação não definida para blocos (operador `c` na coluna 5)'
+expect '3 w' 'erro: o operando tem de ser um bloco (operador `w` na coluna 3)'
+expect '[1 2 3] w' 'erro: o operando tem de ser um bloco (operador `w` na coluna 9)'
+expect '[] (' 'erro: a array está vazia (operador `(` na coluna 4)'
+expect '[] )' 'erro: a array está vazia (operador `)` na coluna 4)'
+expect '"" (' 'erro: a array está vazia (operador `(` na coluna 4)'
+expect '_ ;' 'erro: a stack está vazia (operador `_` na coluna 1)'
+expect '1 \ \' 'erro: a stack está vazia (operador `\` na coluna 3)'
+expect '1 2 @ @ @' 'erro: a stack está vazia (operador `@` na coluna 5)'
+expect '1 { \ \ } ~' 'erro: a stack está vazia (operador `\` na coluna 5)'
+
+leaks '5 , e<'
+leaks '5 \'
+leaks '[1] 2 @'
+leaks '[1 2 3] [1 2 3 4] <'
+leaks '[1 2 3] [1 2 3 4] >'
+leaks '[1 2] "a" e>'
+leaks '[3 1 2] {"x" +} $'
+leaks '[3 1 "a" 2 5 4] {} $'
+leaks '[1 2 3] i'
+leaks '{1} f'
+leaks '[1 2 3] w'
+leaks '[1 2 3] {;} $'
+leaks '10 , {;} ,'
+leaks '[1 0] {1 \ / ,} $'
+leaks '[] ('
+leaks '"" )'
+leaks '3 , {) ; 1} w'
+
+[ "$FAILED" -eq 0 ] && echo "todos os testes passaram"
+exit "$FAILED"
@@ -0,0 +1,250 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que escrevem números sob a forma de texto
+ *
+ * Os inteiros são escritos dois algarismos de cada vez, a partir de uma tabela
+ * com os pares de algarismos de 00 a 99, sem passar pelo printf.
+ *
+ * Os doubles são escritos tal como pelo `%g` do printf (6 algarismos
+ * significativos, sem zeros à direita). Os 6 algarismos são obtidos com aritmética
+ * inteira exata de 128 bits: o double é m * 2^e, e o arredondamento de
+ * m * 2^e / 10^k é calculado a partir do quociente e do resto da divisão (com
+ * arredondamento para o par nos empates, como no printf). Só os valores cuja
+ * escala não cabe em 128 bits (abaixo de cerca de 10^-22 ou acima de 10^38), os
+ * infinitos e os NaN são escritos pelo snprintf.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "format.h"
+#include "stack.h"
+
+//! Inteiro sem sinal de 128 bits
+typedef unsigned __int128 Wide;
+
+//! Número de algarismos significativos do `%g`
+#define PRECISION 6
+
+//! 10^PRECISION
+#define PRECISION_LIMIT 1000000
+
+//! A maior potência de 10 que cabe em 128 bits
+#define MAX_POWER 38
+
+//! Os pares de algarismos de 00 a 99
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/**
+ * \brief Escreve um inteiro sem sinal em base 10
+ * @param v   O inteiro
+ * @param out Onde escrever (pelo menos INTEGER_BUFFER_SIZE caracteres)
+ * @return    O número de caracteres escritos (sem o '\0')
+ */
+static int writeUnsigned(unsigned long long v, char* out) {
+    char tmp[INTEGER_BUFFER_SIZE];
+    char* p = tmp + sizeof(tmp);
+
+    while (v >= 100) {
+        p -= 2;
+        memcpy(p, digitPairs + (v % 100) * 2, 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, digitPairs + v * 2, 2);
+    } else
+        *--p = '0' + v;
+
+    int n = tmp + sizeof(tmp) - p;
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return n;
+}
+
+/**
+ * \brief Escreve um inteiro em base 10 (tal como o `%lld` do printf)
+ * @param v      O inteiro
+ * @param buffer Onde escrever (pelo menos INTEGER_BUFFER_SIZE caracteres)
+ * @return       O número de caracteres escritos (sem o '\0')
+ */
+int formatInteger(long long v, char* buffer) {
+    if (v < 0) {
+        buffer[0] = '-';
+        return 1 + writeUnsigned(0 - (unsigned long long) v, buffer + 1);
+    }
+    return writeUnsigned(v, buffer);
+}
+
+/**
+ * \brief Calcula 10^k
+ * @param k O expoente (no máximo MAX_POWER)
+ * @return  A potência
+ */
+static Wide powerOfTen(int k) {
+    Wide p = 1;
+    while (k-- > 0)
+        p *= 10;
+    return p;
+}
+
+/**
+ * \brief Calcula m * 2^e / 10^k de forma exata, se couber em 128 bits
+ * @param m    A mantissa
+ * @param e    O expoente binário
+ * @param k    O expoente decimal
+ * @param q    Onde guardar o quociente (truncado)
+ * @param up   Onde guardar 1 se o quociente arredondado (para o par nos empates)
+ *             for q + 1, 0 se for q
+ * @return     1 se o cálculo foi possível, 0 caso contrário
+ */
+static bool scaleExact(unsigned long long m, int e, int k, Wide* q, bool* up) {
+    Wide num = m, den = 1;
+
+    if (e > 0) {
+        if (e > 127 - 53)
+            return false;
+        num <<= e;
+    } else if (e < 0) {
+        if (-e > 126)
+            return false;
+        den <<= -e;
+    }
+
+    if (k > MAX_POWER || -k > MAX_POWER)
+        return false;
+    if (k > 0 && __builtin_mul_overflow(den, powerOfTen(k), &den))
+        return false;
+    if (k < 0 && __builtin_mul_overflow(num, powerOfTen(-k), &num))
+        return false;
+
+    Wide r = num % den;
+    *q = num / den;
+    *up = r > den - r || (r == den - r && (*q & 1));
+    return true;
+}
+
+/**
+ * \brief Escreve os algarismos significativos de um número em notação científica
+ * (tal como o `%e`, sem zeros à direita)
+ * @param s      Onde escrever
+ * @param digits Os algarismos significativos
+ * @param n      O número de algarismos significativos
+ * @param x      O expoente decimal
+ * @return       O fim do texto escrito
+ */
+static char* writeScientific(char* s, const char* digits, int n, int x) {
+    *s++ = digits[0];
+    if (n > 1) {
+        *s++ = '.';
+        memcpy(s, digits + 1, n - 1);
+        s += n - 1;
+    }
+
+    *s++ = 'e';
+    *s++ = x < 0 ? '-' : '+';
+    if (x < 0)
+        x = -x;
+    if (x < 10) //o expoente tem pelo menos dois algarismos
+        *s++ = '0';
+    return s + writeUnsigned(x, s);
+}
+
+/**
+ * \brief Escreve os algarismos significativos de um número em notação decimal
+ * (tal como o `%f`, sem zeros à direita)
+ * @param s      Onde escrever
+ * @param digits Os algarismos significativos
+ * @param n      O número de algarismos significativos
+ * @param x      O expoente decimal (entre -4 e PRECISION - 1)
+ * @return       O fim do texto escrito
+ */
+static char* writeFixed(char* s, const char* digits, int n, int x) {
+    if (x < 0) {
+        *s++ = '0';
+        *s++ = '.';
+        memset(s, '0', -x - 1);
+        s += -x - 1;
+        memcpy(s, digits, n);
+        return s + n;
+    }
+
+    //parte inteira (os algarismos que faltam são zeros)
+    for (int i = 0; i <= x; i++)
+        *s++ = i < n ? digits[i] : '0';
+
+    if (n > x + 1) {
+        *s++ = '.';
+        memcpy(s, digits + x + 1, n - x - 1);
+        s += n - x - 1;
+    }
+    return s;
+}
+
+/**
+ * \brief Escreve um double em base 10, tal como o `%g` do printf
+ * @param v      O double
+ * @param buffer Onde escrever (pelo menos DOUBLE_BUFFER_SIZE caracteres)
+ * @return       O número de caracteres escritos (sem o '\0')
+ */
+int formatDouble(double v, char* buffer) {
+    if (!isfinite(v))
+        return snprintf(buffer, DOUBLE_BUFFER_SIZE, "%g", v);
+
+    char* s = buffer;
+    double a = fabs(v);
+    if (signbit(v))
+        *s++ = '-';
+
+    if (a == 0) {
+        *s++ = '0';
+        *s = '\0';
+        return s - buffer;
+    }
+
+    //a = m * 2^e, com m inteiro
+    int e;
+    unsigned long long m = (unsigned long long) ldexp(frexp(a, &e), 53);
+    e -= 53;
+
+    //o expoente decimal é estimado pelo log10 e corrigido pelo quociente exato
+    int x = (int) floor(log10(a));
+    Wide q;
+    bool up, found = false;
+    for (int tries = 0; tries < 3 && !found; tries++) {
+        if (!scaleExact(m, e, x - (PRECISION - 1), &q, &up))
+            break;
+        if (q < PRECISION_LIMIT / 10)
+            x--;
+        else if (q >= PRECISION_LIMIT)
+            x++;
+        else
+            found = true;
+    }
+    if (!found)
+        return snprintf(buffer, DOUBLE_BUFFER_SIZE, "%g", v);
+
+    unsigned int n = (unsigned int) q + up;
+    if (n == PRECISION_LIMIT) { //o arredondamento passou para o expoente seguinte
+        n /= 10;
+        x++;
+    }
+
+    char digits[PRECISION];
+    int length = PRECISION;
+    for (int i = PRECISION - 1; i >= 0; i--, n /= 10)
+        digits[i] = '0' + n % 10;
+    while (length > 1 && digits[length - 1] == '0')
+        length--;
+
+    if (x < -4 || x >= PRECISION)
+        s = writeScientific(s, digits, length, x);
+    else
+        s = writeFixed(s, digits, length, x);
+
+    *s = '\0';
+    return s - buffer;
+}
@@ -0,0 +1,21 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que escrevem números sob a forma de texto
+ */
+
+//! Include guard
+#ifndef FORMAT_H
+//! Include guard
+#define FORMAT_H
+
+//! Tamanho suficiente para o texto de qualquer long long (com o sinal e o '\0')
+#define INTEGER_BUFFER_SIZE 24
+
+//! Tamanho suficiente para o texto de qualquer double escrito por formatDouble
+#define DOUBLE_BUFFER_SIZE 32
+
+int formatInteger(long long v, char* buffer);
+
+int formatDouble(double v, char* buffer);
+
+#endif
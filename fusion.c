@@ -0,0 +1,386 @@
+/**
+ * @file
+ * @brief contém a implementação das superinstruções: as sequências frequentes
+ * de instruções executadas como uma só
+ *
+ * Os programas são dominados por algumas sequências curtas (`1+`, `0=`, `2%`,
+ * `_*`, `\;`, `) 10<`, `A~`; ver profile.c). Depois de otimizado, cada programa
+ * é percorrido uma vez e cada uma destas sequências é substituída por uma
+ * instrução Fused, que guarda as instruções originais.
+ *
+ * A superinstrução calcula o resultado diretamente sobre o topo da stack, sem
+ * empurrar nem retirar os valores intermédios, usando as operações
+ * especializadas de numericOperations.c (com a mesma cache por instrução que as
+ * instruções Operation). Quando os valores não são os esperados (tipos sem
+ * operação especializada, inteiros que deixam de caber num long long, divisões
+ * por zero, vistas), as instruções originais são executadas uma a uma, pelo que
+ * o resultado e os erros são sempre os mesmos.
+ *
+ * As cadeias de map (`%`), filter (`,`) e fold (`*`) com blocos constantes
+ * (`{3*}%{2%},{+}*`) são executadas num só ciclo: cada elemento da coleção
+ * passa por todas as etapas antes do elemento seguinte, sem construir as
+ * coleções intermédias. A ordem das execuções dos blocos muda, pelo que a
+ * cadeia só é fundida quando a análise (ver analysis.c) mostra que os blocos
+ * são puros e que os blocos das etapas intermédias (e dos filtros) só usam o
+ * seu elemento. Se mais do que uma etapa falhar, o erro assinalado pode ser o
+ * de uma etapa posterior.
+ */
+
+#include <string.h>
+#include "fusion.h"
+#include "blockOperations.h"
+
+//! Os operadores binários que podem terminar uma superinstrução
+#define FUSABLE_OPERATORS "+-*/%&|^=<>"
+//! Os operadores das etapas de uma cadeia (map, filter e fold)
+#define PIPELINE_OPERATORS "%,*"
+
+/**
+ * \brief Verifica se a instrução é um dos operadores dados (com uma só letra)
+ * @param ins A instrução
+ * @param ops Os operadores
+ * @return    1 se for, 0 caso contrário
+ */
+static bool isOperator(Instruction* ins, const char* ops) {
+    return ins->type == Operation && ins->length == 1 && strchr(ops, ins->word[0]) != NULL;
+}
+
+/**
+ * \brief Verifica se a instrução empurra uma constante inteira
+ * @param ins A instrução
+ * @return    1 se empurrar, 0 caso contrário
+ */
+static bool isIntConstant(Instruction* ins) {
+    return ins->type == PushValue && ins->value.type == Int;
+}
+
+/**
+ * \brief Determina o tamanho da cadeia de map, filter e fold com que as
+ * instruções começam (o fold só pode ser a última etapa)
+ * @param code As instruções
+ * @param n    O número de instruções disponíveis
+ * @return     O número de instruções da cadeia, ou 0 se não tiver pelo menos duas etapas
+ */
+static long long matchPipeline(Instruction* code, long long n) {
+    long long k = 0;
+
+    while (k + 1 < n && code[k].type == PushValue && code[k].value.type == Block
+            && isOperator(&code[k + 1], PIPELINE_OPERATORS)) {
+        k += 2;
+        if (code[k - 1].word[0] == '*')
+            break;
+    }
+    return k >= 4 ? k : 0;
+}
+
+/**
+ * \brief Verifica se as primeiras instruções dadas formam uma sequência que pode
+ * ser substituída por uma superinstrução
+ * @param code    As instruções
+ * @param n       O número de instruções disponíveis
+ * @param fusion  Onde guardar a sequência encontrada
+ * @param operand Onde guardar a constante ou o índice da variável da sequência
+ * @return        O número de instruções da sequência, ou 0 se não houver nenhuma
+ */
+long long matchFusion(Instruction* code, long long n, FusionType* fusion, long long* operand) {
+    long long k = matchPipeline(code, n);
+    if (k > 0) {
+        *fusion = FusePipeline;
+        *operand = k / 2;
+        return k;
+    }
+
+    if (n >= 3 && isOperator(&code[0], "()") && isIntConstant(&code[1]) && isOperator(&code[2], FUSABLE_OPERATORS)) {
+        *fusion = code[0].word[0] == ')' ? FuseIncrement : FuseDecrement;
+        *operand = code[1].value.integer;
+        return 3;
+    }
+    if (n < 2)
+        return 0;
+
+    *operand = 0;
+    if (isIntConstant(&code[0]) && isOperator(&code[1], FUSABLE_OPERATORS)) {
+        *fusion = FuseConstant;
+        *operand = code[0].value.integer;
+    } else if (isOperator(&code[0], "_") && isOperator(&code[1], FUSABLE_OPERATORS))
+        *fusion = FuseDuplicate;
+    else if (isOperator(&code[0], "\\") && isOperator(&code[1], ";"))
+        *fusion = FuseNip;
+    else if (code[0].type == PushVariable && isOperator(&code[1], "~")) {
+        *fusion = FuseRunVariable;
+        *operand = code[0].variable;
+    } else
+        return 0;
+    return 2;
+}
+
+/**
+ * \brief Devolve o nome de uma superinstrução
+ * @param fusion A sequência substituída
+ * @return       O nome
+ */
+const char* fusionName(FusionType fusion) {
+    switch (fusion) {
+        case FuseConstant:      return "FuseConstant";
+        case FuseIncrement:     return "FuseIncrement";
+        case FuseDecrement:     return "FuseDecrement";
+        case FuseDuplicate:     return "FuseDuplicate";
+        case FuseNip:           return "FuseNip";
+        case FuseRunVariable:   return "FuseRunVariable";
+        case FusePipeline:      return "FusePipeline";
+        default:                return "?";
+    }
+}
+
+/**
+ * \brief Substitui as sequências frequentes de instruções do programa por
+ * superinstruções (as arrays são tratadas quando são otimizadas)
+ * @param p O programa
+ */
+void fuseProgram(Program p) {
+    long long out = 0;
+
+    for (long long i = 0; i < p->size; ) {
+        FusionType fusion;
+        long long operand;
+        long long n = matchFusion(p->code + i, p->size - i, &fusion, &operand);
+
+        if (n == 0) {
+            p->code[out++] = p->code[i++];
+            continue;
+        }
+
+        Program original = newProgram();
+        for (long long k = 0; k < n; k++)
+            addInstruction(original, p->code[i + k]);
+        p->code[out++] = fromFusion(fusion, operand, original);
+        i += n;
+    }
+
+    p->size = out;
+}
+
+/**
+ * \brief Soma um (ou subtrai um) a um inteiro ou double, tal como `)` e `(`
+ * @param v     O valor
+ * @param delta 1 ou -1
+ * @return      1 se o valor foi alterado, 0 se não for um inteiro ou um double
+ *              ou se o resultado não couber num long long
+ */
+static bool step(Value* v, int delta) {
+    if (v->type == Int)
+        return !__builtin_add_overflow(v->integer, delta, &v->integer);
+    if (v->type == Double) {
+        v->decimal += delta;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Verifica se os blocos de uma cadeia podem ser executados elemento a
+ * elemento: todos puros e, exceto no map ou no fold da última etapa, com um
+ * valor de entrada e um de saída (os filtros e as etapas intermédias não veem
+ * os restantes valores da coleção)
+ * @param ins A instrução Fused da cadeia
+ * @param st  O estado do programa
+ * @return    1 se puderem, 0 caso contrário
+ */
+static bool canStream(Instruction* ins, State* st) {
+    for (long long i = 0; i < ins->operand; i++) {
+        Instruction* stage = &ins->original->code[2 * i];
+        StackEffect e = compileBlock(st, stage->value.block)->effect;
+        bool last = i == ins->operand - 1 && stage[1].word[0] != ',';
+
+        if (!e.bounded || !e.pure)
+            return false;
+        if (!last && (e.inputs > 1 || e.minDelta != 0 || e.maxDelta != 0))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Passa um elemento por todas as etapas de uma cadeia. Os resultados
+ * ficam na coleção de saída, tal como na última etapa executada sozinha.
+ * @param ins   A instrução Fused da cadeia
+ * @param st    O estado do programa
+ * @param out   A coleção de saída
+ * @param v     O elemento
+ * @param first Indica se o fold ainda não recebeu nenhum elemento (é atualizado)
+ */
+static void streamElement(Instruction* ins, State* st, Stack out, Value v, bool* first) {
+    for (long long i = 0; i < ins->operand; i++) {
+        Instruction* stage = &ins->original->code[2 * i];
+        bool last = i == ins->operand - 1;
+
+        //o elemento fica na coleção de saída enquanto os blocos são executados,
+        //para ser libertado se falharem; os blocos só usam o topo (ver canStream)
+        push(out, v);
+        st->current = &stage[1];
+        switch (stage[1].word[0]) {
+            case '%':
+                execute(st, out, stage->value);
+                if (last)
+                    return;
+                v = pop(out);
+                break;
+
+            case ',': {
+                push(out, deepCopy(v));
+                execute(st, out, stage->value);
+                Value c = pop(out);
+                bool keep = isTrue(c);
+                disposeValue(c);
+                if (!keep) {
+                    eraseTop(out);
+                    return;
+                }
+                if (last)
+                    return;
+                v = pop(out);
+                break;
+            }
+
+            default: //o fold é sempre a última etapa
+                if (!*first)
+                    execute(st, out, stage->value);
+                *first = false;
+                return;
+        }
+    }
+}
+
+/**
+ * \brief Executa uma cadeia de map, filter e fold num só ciclo sobre a coleção
+ * do topo da stack (ver o início do ficheiro)
+ * @param ins A instrução Fused da cadeia
+ * @param st  O estado do programa
+ * @return    1 se foi executada, 0 se devem ser executadas as instruções originais
+ */
+static bool runPipeline(Instruction* ins, State* st) {
+    Stack s = st->stack;
+    if (s->parent != NULL || s->size < 1)
+        return false;
+
+    DataType t = valueAt(s, s->size - 1).type;
+    if ((t != Array && t != String) || !canStream(ins, st))
+        return false;
+
+    //tal como no map, os elementos passam para uma stack auxiliar, pela ordem
+    //inversa, e os resultados são acumulados na própria coleção (que fica com o
+    //buffer vazio da stack auxiliar, para os elementos não serem copiados)
+    Value a = pop(s);
+    Stack pending = empty();
+    materialize(a.array);
+    struct stack aux = *pending;
+    *pending = *a.array;
+    *a.array = aux;
+    for (long long i = 0, k = pending->size - 1; i < k; i++, k--) {
+        StoredValue v = pending->values[i];
+        pending->values[i] = pending->values[k];
+        pending->values[k] = v;
+    }
+
+    Instruction* previous = st->current;
+    Suspended entry = { pending, st->suspended };
+    st->suspended = &entry;
+
+    bool first = true;
+    while (!isEmpty(pending))
+        streamElement(ins, st, a.array, pop(pending), &first);
+
+    st->suspended = entry.previous;
+    st->current = previous;
+    disposeStack(pending);
+    push(s, a);
+    return true;
+}
+
+/**
+ * \brief Executa uma superinstrução diretamente sobre o topo da stack
+ * @param ins A instrução Fused
+ * @param st  O estado do programa
+ * @return    1 se foi executada, 0 se devem ser executadas as instruções originais
+ */
+static bool runFast(Instruction* ins, State* st) {
+    Stack s = st->stack;
+
+    if (ins->fusion == FusePipeline)
+        return runPipeline(ins, st);
+
+    if (ins->fusion == FuseRunVariable) {
+        Value v = st->variables[ins->operand];
+        if (v.type != Block)
+            return false;
+
+        //o bloco é executado sem copiar a variável; o `~` identifica o operador nos erros
+        Instruction* previous = st->current;
+        st->current = &ins->original->code[1];
+        execute(st, s, v);
+        st->current = previous;
+        return true;
+    }
+
+    //os valores de uma vista pertencem a outra stack
+    if (s->parent != NULL)
+        return false;
+
+    if (ins->fusion == FuseNip) {
+        if (s->size < 2)
+            return false;
+        disposeValue(takeValue(s->values[s->size - 2]));
+        s->values[s->size - 2] = s->values[s->size - 1];
+        s->size--;
+        s->hash = 0;
+        return true;
+    }
+
+    if (s->size < 1)
+        return false;
+
+    Value x = valueAt(s, s->size - 1), r;
+    if ((int) x.type != ins->topType) {
+        char op = ins->original->code[ins->original->size - 1].word[0];
+        ins->topType = x.type;
+        ins->topHandler = findNumericHandler(op, x.type, ins->fusion == FuseDuplicate ? x.type : Int);
+    }
+    if (ins->topHandler == NULL)
+        return false;
+
+    switch (ins->fusion) {
+        case FuseIncrement:
+            if (!step(&x, 1))
+                return false;
+            break;
+        case FuseDecrement:
+            if (!step(&x, -1))
+                return false;
+            break;
+        default:
+            break;
+    }
+
+    Value y = ins->fusion == FuseDuplicate ? x : fromInteger(ins->operand);
+    if (!ins->topHandler(x, y, &r))
+        return false;
+
+    setValueAt(s, s->size - 1, r);
+    s->hash = 0;
+    return true;
+}
+
+/**
+ * \brief Executa uma superinstrução. Se não se aplicar aos valores da stack,
+ * executa as instruções que substituiu.
+ * @param ins A instrução Fused
+ * @param st  O estado do programa
+ */
+void runFused(Instruction* ins, State* st) {
+    if (runFast(ins, st))
+        return;
+
+    Program original = ins->original;
+    for (long long i = 0; i < original->size; i++)
+        runInstruction(&original->code[i], st);
+}
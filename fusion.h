@@ -0,0 +1,22 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que substituem as sequências
+ * frequentes de instruções por superinstruções e que as executam
+ */
+
+//! Include guard
+#ifndef FUSION_H
+//! Include guard
+#define FUSION_H
+
+#include "program.h"
+
+long long matchFusion(Instruction* code, long long n, FusionType* fusion, long long* operand);
+
+const char* fusionName(FusionType fusion);
+
+void fuseProgram(Program p);
+
+void runFused(Instruction* ins, State* st);
+
+#endif
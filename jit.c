@@ -0,0 +1,735 @@
+/**
+ * @file
+ * @brief contém a implementação da compilação dos blocos numéricos para código
+ * máquina (x86-64) e da sua execução
+ *
+ * Os blocos são interpretados enquanto são pouco executados. Quando um bloco
+ * atinge JIT_THRESHOLD execuções (por `%`, `,`, `*`, `w` ou `~`), e se a
+ * análise do seu programa o considerar numérico (só usa constantes e variáveis
+ * numéricas e os operadores `+ - * / % # ( ) & | ^ = < > ! _ \ @ ;`; ver
+ * analysis.c), é compilado para código máquina, especializado nos tipos
+ * (inteiro ou double) dos valores que consome da stack e das variáveis que lê
+ * nessa execução.
+ *
+ * A compilação simula a stack do bloco: cada valor é uma constante ou uma
+ * posição (slot) de uma array de inteiros de 64 bits, e os operadores de stack
+ * (`_ \ @ ;`) não geram código. Cada operador numérico é traduzido por um
+ * modelo fixo de instruções que lê os operandos dos slots (ou das constantes) e
+ * escreve o resultado num slot novo; `#` e o `%` dos doubles chamam funções em
+ * C. No fim, os valores da stack simulada são os resultados do bloco.
+ *
+ * Antes de executar o código máquina, os tipos dos valores consumidos e das
+ * variáveis são comparados com os da compilação (type guards). O código máquina
+ * não altera a stack: se um tipo for diferente, ou se uma operação não puder ser
+ * calculada diretamente (overflow de inteiros, divisão por zero, expoente
+ * negativo), o bloco é interpretado como antes, o que produz o mesmo resultado
+ * (um inteiro grande, por exemplo) ou o mesmo erro.
+ *
+ * O código é escrito numa página obtida com mmap, que passa a executável (e
+ * deixa de poder ser escrita) com mprotect. Fora de x86-64 Linux os blocos são
+ * sempre interpretados.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "jit.h"
+#include "program.h"
+#include "analysis.h"
+#include "blockOperations.h"
+#include "memory.h"
+
+bool jitEnabled = true;
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+//! Número máximo de instruções de um bloco compilado
+#define JIT_MAX_INSTRUCTIONS 256
+
+//! Número máximo de valores consumidos da stack e de variáveis lidas por um bloco compilado
+#define JIT_MAX_INPUTS 16
+
+//! Número máximo de bytes de código máquina por instrução do bloco
+#define JIT_BYTES_PER_INSTRUCTION 96
+
+/**
+ * \brief Um valor da stack simulada durante a compilação
+ */
+typedef struct operand {
+    //! O tipo do valor (Int ou Double)
+    DataType type;
+    //! 1 se o valor for uma constante
+    bool constant;
+    //! Os bits da constante (o inteiro ou o double)
+    long long bits;
+    //! O slot onde o valor é guardado, se não for uma constante
+    int slot;
+} Operand;
+
+/**
+ * \brief O código máquina de um bloco
+ */
+struct jitCode {
+    //! A função compilada: recebe os slots e devolve 0 se o bloco tiver de ser interpretado
+    int (*entry)(long long* slots);
+    //! As páginas de código
+    void* memory;
+    //! O tamanho das páginas de código
+    size_t size;
+    //! Número de valores consumidos da stack (nos primeiros slots, o do fundo primeiro)
+    int inputs;
+    //! O tipo de cada valor consumido
+    DataType inputTypes[JIT_MAX_INPUTS];
+    //! Número de variáveis lidas (nos slots seguintes)
+    int variables;
+    //! O índice de cada variável lida
+    int variableIndex[JIT_MAX_INPUTS];
+    //! O tipo de cada variável lida
+    DataType variableTypes[JIT_MAX_INPUTS];
+    //! Número de valores deixados na stack
+    int results;
+    //! Os valores deixados na stack (o do fundo primeiro)
+    Operand* result;
+    //! Número de slots
+    int slots;
+};
+
+//! Marca os blocos que não podem ser compilados
+static struct jitCode rejected;
+
+/**
+ * \brief O estado da geração de código máquina
+ */
+typedef struct emitter {
+    //! O código gerado
+    unsigned char* code;
+    //! Número de bytes gerados
+    size_t size;
+    //! As posições dos deslocamentos dos saltos para a saída sem resultado
+    size_t* bails;
+    //! Número de saltos para a saída sem resultado
+    int bailCount;
+    //! Número de slots usados
+    int slots;
+} Emitter;
+
+//! Condições dos saltos e dos setcc
+enum { CC_O = 0x0, CC_E = 0x4, CC_A = 0x7, CC_L = 0xC, CC_G = 0xF };
+
+/**
+ * \brief Acrescenta bytes ao código
+ * @param e     O estado da geração
+ * @param bytes Os bytes
+ * @param n     O número de bytes
+ */
+static void emit(Emitter* e, const char* bytes, int n) {
+    memcpy(e->code + e->size, bytes, n);
+    e->size += n;
+}
+
+/**
+ * \brief Acrescenta um inteiro de 32 ou 64 bits ao código
+ * @param e     O estado da geração
+ * @param v     O inteiro
+ * @param n     O número de bytes (4 ou 8)
+ */
+static void emitInteger(Emitter* e, long long v, int n) {
+    memcpy(e->code + e->size, &v, n); //x86-64 é little-endian
+    e->size += n;
+}
+
+/**
+ * \brief Acrescenta um acesso a um slot ([rbx + 8 * slot]) com o ModRM dado
+ * @param e     O estado da geração
+ * @param modrm O ModRM (com mod = 10 e rm = rbx)
+ * @param slot  O slot
+ */
+static void emitSlot(Emitter* e, int modrm, int slot) {
+    e->code[e->size++] = modrm;
+    emitInteger(e, 8LL * slot, 4);
+}
+
+/**
+ * \brief Acrescenta um salto condicional para a saída sem resultado (o bloco é interpretado)
+ * @param e  O estado da geração
+ * @param cc A condição
+ */
+static void emitBail(Emitter* e, int cc) {
+    e->code[e->size++] = 0x0F;
+    e->code[e->size++] = 0x80 | cc;
+    e->bails[e->bailCount++] = e->size;
+    emitInteger(e, 0, 4);
+}
+
+/**
+ * \brief Acrescenta `setcc al; movzx eax, al`
+ * @param e  O estado da geração
+ * @param cc A condição
+ */
+static void emitSet(Emitter* e, int cc) {
+    e->code[e->size++] = 0x0F;
+    e->code[e->size++] = 0x90 | cc;
+    emit(e, "\xC0\x0F\xB6\xC0", 4);
+}
+
+/**
+ * \brief Carrega um operando inteiro para rax (reg 0) ou rcx (reg 1)
+ * @param e   O estado da geração
+ * @param reg O registo
+ * @param o   O operando
+ */
+static void loadInteger(Emitter* e, int reg, Operand o) {
+    if (o.constant) { //mov reg, imm64
+        e->code[e->size++] = 0x48;
+        e->code[e->size++] = 0xB8 + reg;
+        emitInteger(e, o.bits, 8);
+    } else { //mov reg, [rbx + slot]
+        emit(e, "\x48\x8B", 2);
+        emitSlot(e, 0x83 | reg << 3, o.slot);
+    }
+}
+
+/**
+ * \brief Carrega um operando para xmm0 (reg 0) ou xmm1 (reg 1), convertendo-o para double
+ * @param e   O estado da geração
+ * @param reg O registo
+ * @param o   O operando
+ */
+static void loadDouble(Emitter* e, int reg, Operand o) {
+    if (o.constant) { //mov rax, imm64; movq xmm, rax
+        double d = o.type == Double ? 0 : (double) o.bits;
+        long long bits = o.bits;
+        if (o.type != Double)
+            memcpy(&bits, &d, sizeof(bits));
+        emit(e, "\x48\xB8", 2);
+        emitInteger(e, bits, 8);
+        emit(e, "\x66\x48\x0F\x6E", 4);
+        e->code[e->size++] = 0xC0 | reg << 3;
+    } else if (o.type == Double) { //movsd xmm, [rbx + slot]
+        emit(e, "\xF2\x0F\x10", 3);
+        emitSlot(e, 0x83 | reg << 3, o.slot);
+    } else { //cvtsi2sd xmm, qword [rbx + slot]
+        emit(e, "\xF2\x48\x0F\x2A", 4);
+        emitSlot(e, 0x83 | reg << 3, o.slot);
+    }
+}
+
+/**
+ * \brief Guarda rax num slot novo
+ * @param e    O estado da geração
+ * @param type O tipo do valor guardado
+ * @return     O operando guardado
+ */
+static Operand storeInteger(Emitter* e, DataType type) {
+    Operand o = { type, false, 0, e->slots++ };
+    emit(e, "\x48\x89", 2); //mov [rbx + slot], rax
+    emitSlot(e, 0x83, o.slot);
+    return o;
+}
+
+/**
+ * \brief Guarda xmm0 num slot novo
+ * @param e O estado da geração
+ * @return  O operando guardado
+ */
+static Operand storeDouble(Emitter* e) {
+    Operand o = { Double, false, 0, e->slots++ };
+    emit(e, "\xF2\x0F\x11", 3); //movsd [rbx + slot], xmm0
+    emitSlot(e, 0x83, o.slot);
+    return o;
+}
+
+/**
+ * \brief Guarda um operando num slot, com o tipo dado
+ * @param e    O estado da geração
+ * @param o    O operando
+ * @param type O tipo (Int só se o operando for inteiro)
+ * @return     O slot
+ */
+static int toSlot(Emitter* e, Operand o, DataType type) {
+    if (!o.constant && o.type == type)
+        return o.slot;
+    if (type == Int) {
+        loadInteger(e, 0, o);
+        return storeInteger(e, Int).slot;
+    }
+    loadDouble(e, 0, o);
+    return storeDouble(e).slot;
+}
+
+/**
+ * \brief Calcula a potência de dois inteiros, tal como `#`
+ * @param x   A base
+ * @param y   O expoente
+ * @param out Onde guardar o resultado
+ * @return    0 se o expoente for negativo ou se o resultado não couber num long long
+ */
+static int powerInteger(long long* x, long long* y, long long* out) {
+    long long result = 1, base = *x, e = *y;
+
+    if (e < 0)
+        return 0;
+    while (e > 0) {
+        if ((e & 1) && __builtin_mul_overflow(result, base, &result))
+            return 0;
+        e >>= 1;
+        if (e > 0 && __builtin_mul_overflow(base, base, &base))
+            return 0;
+    }
+    *out = result;
+    return 1;
+}
+
+/**
+ * \brief Calcula a potência de dois doubles, tal como `#`
+ * @param x   A base
+ * @param y   O expoente
+ * @param out Onde guardar o resultado
+ * @return    1
+ */
+static int powerDouble(double* x, double* y, double* out) {
+    *out = pow(*x, *y);
+    return 1;
+}
+
+/**
+ * \brief Calcula o resto da divisão de dois doubles, tal como `%`
+ * @param x   O dividendo
+ * @param y   O divisor
+ * @param out Onde guardar o resultado
+ * @return    1
+ */
+static int moduleDouble(double* x, double* y, double* out) {
+    *out = fmod(*x, *y);
+    return 1;
+}
+
+/**
+ * \brief Acrescenta a chamada de uma função em C sobre dois operandos
+ * (func(&slots[a], &slots[b], &slots[r])), saindo sem resultado se devolver 0
+ * @param e    O estado da geração
+ * @param func A função
+ * @param type O tipo dos operandos e do resultado
+ * @param a    O primeiro operando
+ * @param b    O segundo operando
+ * @return     O resultado
+ */
+static Operand emitCall(Emitter* e, void* func, DataType type, Operand a, Operand b) {
+    int x = toSlot(e, a, type), y = toSlot(e, b, type);
+    Operand r = { type, false, 0, e->slots++ };
+
+    emit(e, "\x48\x8D", 2); //lea rdi, [rbx + x]
+    emitSlot(e, 0xBB, x);
+    emit(e, "\x48\x8D", 2); //lea rsi, [rbx + y]
+    emitSlot(e, 0xB3, y);
+    emit(e, "\x48\x8D", 2); //lea rdx, [rbx + r]
+    emitSlot(e, 0x93, r.slot);
+    emit(e, "\x48\xB8", 2); //mov rax, func
+    emitInteger(e, (long long) func, 8);
+    emit(e, "\xFF\xD0\x85\xC0", 4); //call rax; test eax, eax
+    emitBail(e, CC_E);
+    return r;
+}
+
+/**
+ * \brief Gera o código de um operador numérico binário
+ * @param e  O estado da geração
+ * @param op O operador
+ * @param a  O primeiro operando
+ * @param b  O segundo operando
+ * @param r  Onde guardar o resultado
+ * @return   1 se o operador for suportado para os tipos dos operandos, 0 caso contrário
+ */
+static bool emitBinary(Emitter* e, char op, Operand a, Operand b, Operand* r) {
+    bool integers = a.type == Int && b.type == Int;
+
+    if (strchr("&|^", op) != NULL && !integers)
+        return false;
+
+    if (op == '#') {
+        *r = integers ? emitCall(e, powerInteger, Int, a, b) : emitCall(e, powerDouble, Double, a, b);
+        return true;
+    }
+    if (op == '%' && !integers) {
+        *r = emitCall(e, moduleDouble, Double, a, b);
+        return true;
+    }
+
+    if (integers) {
+        loadInteger(e, 0, a);
+        loadInteger(e, 1, b);
+        switch (op) {
+            case '+':   emit(e, "\x48\x01\xC8", 3); emitBail(e, CC_O);          break;
+            case '-':   emit(e, "\x48\x29\xC8", 3); emitBail(e, CC_O);          break;
+            case '*':   emit(e, "\x48\x0F\xAF\xC1", 4); emitBail(e, CC_O);      break;
+            case '&':   emit(e, "\x48\x21\xC8", 3);                             break;
+            case '|':   emit(e, "\x48\x09\xC8", 3);                             break;
+            case '^':   emit(e, "\x48\x31\xC8", 3);                             break;
+            case '=':   emit(e, "\x48\x39\xC8", 3); emitSet(e, CC_E);           break;
+            case '<':   emit(e, "\x48\x39\xC8", 3); emitSet(e, CC_L);           break;
+            case '>':   emit(e, "\x48\x39\xC8", 3); emitSet(e, CC_G);           break;
+            default: //'/' e '%': os divisores 0 e -1 são deixados ao interpretador
+                emit(e, "\x48\x85\xC9", 3);         //test rcx, rcx
+                emitBail(e, CC_E);
+                emit(e, "\x48\x83\xF9\xFF", 4);     //cmp rcx, -1
+                emitBail(e, CC_E);
+                emit(e, "\x48\x99\x48\xF7\xF9", 5); //cqo; idiv rcx
+                if (op == '%')
+                    emit(e, "\x48\x89\xD0", 3);     //mov rax, rdx
+                break;
+        }
+        *r = storeInteger(e, Int);
+        return true;
+    }
+
+    loadDouble(e, 0, a);
+    loadDouble(e, 1, b);
+    switch (op) {
+        case '+':   emit(e, "\xF2\x0F\x58\xC1", 4);     break;
+        case '-':   emit(e, "\xF2\x0F\x5C\xC1", 4);     break;
+        case '*':   emit(e, "\xF2\x0F\x59\xC1", 4);     break;
+        case '/':
+            emit(e, "\x66\x0F\x57\xD2\x66\x0F\x2E\xCA", 8); //xorpd xmm2, xmm2; ucomisd xmm1, xmm2
+            emitBail(e, CC_E);
+            emit(e, "\xF2\x0F\x5E\xC1", 4);
+            break;
+        case '=': //igual e comparável (falso com NaN)
+            emit(e, "\x66\x0F\x2E\xC1\x0F\x94\xC0\x0F\x9B\xC1\x20\xC8\x0F\xB6\xC0", 15);
+            *r = storeInteger(e, Int);
+            return true;
+        case '<':
+            emit(e, "\x66\x0F\x2E\xC8", 4); //ucomisd xmm1, xmm0
+            emitSet(e, CC_A);
+            *r = storeInteger(e, Int);
+            return true;
+        case '>':
+            emit(e, "\x66\x0F\x2E\xC1", 4); //ucomisd xmm0, xmm1
+            emitSet(e, CC_A);
+            *r = storeInteger(e, Int);
+            return true;
+    }
+    *r = storeDouble(e);
+    return true;
+}
+
+/**
+ * \brief Gera o código de um operador numérico unário (`(`, `)` ou `!`)
+ * @param e  O estado da geração
+ * @param op O operador
+ * @param a  O operando
+ * @return   O resultado
+ */
+static Operand emitUnary(Emitter* e, char op, Operand a) {
+    if (a.type == Int) {
+        loadInteger(e, 0, a);
+        if (op == '!') {
+            emit(e, "\x48\x85\xC0", 3); //test rax, rax
+            emitSet(e, CC_E);
+        } else {
+            emit(e, op == '(' ? "\x48\x83\xE8\x01" : "\x48\x83\xC0\x01", 4); //sub/add rax, 1
+            emitBail(e, CC_O);
+        }
+        return storeInteger(e, Int);
+    }
+
+    loadDouble(e, 0, a);
+    if (op == '!') { //igual a 0 e comparável
+        emit(e, "\x66\x0F\x57\xC9\x66\x0F\x2E\xC1\x0F\x94\xC0\x0F\x9B\xC1\x20\xC8\x0F\xB6\xC0", 19);
+        return storeInteger(e, Int);
+    }
+
+    Operand one = { Int, true, 1, 0 };
+    loadDouble(e, 1, one);
+    emit(e, op == '(' ? "\xF2\x0F\x5C\xC1" : "\xF2\x0F\x58\xC1", 4);
+    return storeDouble(e);
+}
+
+/**
+ * \brief Verifica se um valor pode ser usado pelo código máquina
+ * @param v O valor
+ * @return  1 se for um inteiro ou um double
+ */
+static bool isScalar(Value v) {
+    return v.type == Int || v.type == Double;
+}
+
+/**
+ * \brief Copia o código gerado para páginas executáveis
+ * @param code O código máquina do bloco
+ * @param e    O estado da geração
+ * @return     1 se as páginas foram criadas
+ */
+static bool install(struct jitCode* code, Emitter* e) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (e->size + page - 1) / page * page;
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED)
+        return false;
+    memcpy(memory, e->code, e->size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return false;
+    }
+
+    code->memory = memory;
+    code->size = size;
+    code->entry = (int (*)(long long*)) memory;
+    return true;
+}
+
+/**
+ * \brief Gera o código máquina de um programa, especializado nos tipos dos
+ * valores no topo da stack e das variáveis
+ * @param code O código máquina do bloco (com o número de valores consumidos já preenchido)
+ * @param p    O programa
+ * @param s    O estado do programa
+ * @param e    O estado da geração
+ * @return     1 se o programa foi compilado
+ */
+static bool generate(struct jitCode* code, Program p, State* s, Emitter* e) {
+    Operand stack[JIT_MAX_INPUTS + JIT_MAX_INSTRUCTIONS];
+    int variableSlot[26];
+    int n = code->inputs;
+
+    for (int i = 0; i < n; i++) {
+        Value v = valueAt(s->stack, s->stack->size - n + i);
+        if (!isScalar(v))
+            return false;
+        code->inputTypes[i] = v.type;
+        stack[i] = (Operand) { v.type, false, 0, i };
+    }
+    for (int i = 0; i < 26; i++)
+        variableSlot[i] = -1;
+
+    //as variáveis lidas ocupam os slots seguintes aos valores consumidos
+    e->slots = n;
+    for (long long i = 0; i < p->size; i++) {
+        Instruction* ins = &p->code[i];
+        if (ins->type == PushVariable && variableSlot[ins->variable] < 0) {
+            Value v = s->variables[ins->variable];
+            if (!isScalar(v) || code->variables == JIT_MAX_INPUTS)
+                return false;
+            code->variableIndex[code->variables] = ins->variable;
+            code->variableTypes[code->variables++] = v.type;
+            variableSlot[ins->variable] = e->slots++;
+        }
+    }
+
+    emit(e, "\x53\x48\x89\xFB", 4); //push rbx; mov rbx, rdi
+    for (long long i = 0; i < p->size; i++) {
+        Instruction* ins = &p->code[i];
+        Operand t;
+
+        if (ins->type == PushValue)
+            stack[n++] = (Operand) { ins->value.type, true, ins->value.integer, 0 };
+        else if (ins->type == PushVariable) {
+            DataType type = s->variables[ins->variable].type;
+            stack[n++] = (Operand) { type, false, 0, variableSlot[ins->variable] };
+        } else switch (ins->word[0]) {
+            case '_':   stack[n] = stack[n - 1]; n++;                                       break;
+            case ';':   n--;                                                                break;
+            case '\\':  t = stack[n - 1]; stack[n - 1] = stack[n - 2]; stack[n - 2] = t;    break;
+            case '@':
+                t = stack[n - 3];
+                stack[n - 3] = stack[n - 2];
+                stack[n - 2] = stack[n - 1];
+                stack[n - 1] = t;
+                break;
+            case '(': case ')': case '!':
+                stack[n - 1] = emitUnary(e, ins->word[0], stack[n - 1]);
+                break;
+            default:
+                if (!emitBinary(e, ins->word[0], stack[n - 2], stack[n - 1], &t))
+                    return false;
+                stack[n - 2] = t;
+                n--;
+                break;
+        }
+    }
+    emit(e, "\xB8\x01\x00\x00\x00\x5B\xC3", 7); //mov eax, 1; pop rbx; ret
+
+    //saída sem resultado: o bloco é interpretado
+    for (int i = 0; i < e->bailCount; i++) {
+        long long rel = (long long) e->size - (long long) (e->bails[i] + 4);
+        memcpy(e->code + e->bails[i], &rel, 4);
+    }
+    emit(e, "\x31\xC0\x5B\xC3", 4); //xor eax, eax; pop rbx; ret
+
+    code->results = n;
+    code->result = allocate(ProgramAlloc, sizeof(Operand) * (n > 0 ? n : 1));
+    memcpy(code->result, stack, sizeof(Operand) * n);
+    code->slots = e->slots;
+    return true;
+}
+
+/**
+ * \brief Copia as instruções de um programa, substituindo as superinstruções
+ * pelas instruções que substituíram (ver fusion.c)
+ * @param p    O programa
+ * @param flat Onde guardar as instruções (as cópias partilham os valores do original)
+ */
+static void unfuse(Program p, struct program* flat) {
+    flat->size = 0;
+    flat->capacity = p->size;
+    for (long long i = 0; i < p->size; i++)
+        if (p->code[i].type == Fused)
+            flat->capacity += p->code[i].original->size;
+    flat->code = allocate(ProgramAlloc, sizeof(Instruction) * flat->capacity);
+
+    for (long long i = 0; i < p->size; i++) {
+        if (p->code[i].type != Fused) {
+            flat->code[flat->size++] = p->code[i];
+            continue;
+        }
+        Program original = p->code[i].original;
+        memcpy(flat->code + flat->size, original->code, sizeof(Instruction) * original->size);
+        flat->size += original->size;
+    }
+    flat->effect = p->effect;
+}
+
+/**
+ * \brief Compila um programa para código máquina
+ * @param s     O estado do programa (a stack tem os valores que o bloco vai consumir)
+ * @param p     O programa, sem superinstruções
+ * @return      O código máquina, ou &rejected se o programa não puder ser compilado
+ */
+static struct jitCode* compileProgram(State* s, Program p) {
+    //os valores consumidos e as variáveis são verificados pelos type guards
+    StackEffect effect = analyzeProgram(p, TYPE(Int) | TYPE(Double));
+
+    if (p->size > JIT_MAX_INSTRUCTIONS || !effect.bounded || !effect.numeric
+            || effect.inputs > JIT_MAX_INPUTS || effect.inputs > s->stack->size)
+        return &rejected;
+
+    struct jitCode* code = allocate(ProgramAlloc, sizeof(struct jitCode));
+    memset(code, 0, sizeof(struct jitCode));
+    code->inputs = effect.inputs;
+
+    Emitter e;
+    e.code = malloc(JIT_BYTES_PER_INSTRUCTION * (p->size + 1));
+    e.size = 0;
+    e.bails = malloc(sizeof(size_t) * 3 * (p->size + 1));
+    e.bailCount = 0;
+
+    bool ok = generate(code, p, s, &e) && install(code, &e);
+    free(e.code);
+    free(e.bails);
+
+    if (!ok) {
+        release(code->result);
+        release(code);
+        return &rejected;
+    }
+    return code;
+}
+
+/**
+ * \brief Compila um bloco para código máquina
+ * @param s     O estado do programa (a stack tem os valores que o bloco vai consumir)
+ * @param block O bloco
+ * @return      O código máquina, ou &rejected se o bloco não puder ser compilado
+ */
+static struct jitCode* compile(State* s, BlockCode block) {
+    struct program flat;
+    unfuse(compileBlock(s, block), &flat);
+    struct jitCode* code = compileProgram(s, &flat);
+    release(flat.code);
+    return code;
+}
+
+/**
+ * \brief Executa um bloco com o seu código máquina, compilando-o se tiver sido
+ * executado JIT_THRESHOLD vezes. Os valores consumidos são substituídos na stack
+ * atual do estado pelos resultados.
+ * @param s     O estado do programa
+ * @param block O bloco
+ * @return      1 se o bloco foi executado, 0 se tiver de ser interpretado
+ */
+bool jitExecute(State* s, BlockCode block) {
+    struct jitCode* code = block->jit;
+
+    if (code == NULL) {
+        if (!jitEnabled || ++block->calls < JIT_THRESHOLD)
+            return false;
+        //o código pertence à tabela de blocos e não pode ser alocado na região ativa
+        Region r = enterRegion(NULL);
+        code = block->jit = compile(s, block);
+        enterRegion(r);
+    }
+    if (code == &rejected)
+        return false;
+
+    Stack st = s->stack;
+    if (st->parent != NULL || st->size < code->inputs)
+        return false;
+
+    long long slots[code->slots + 1];
+    for (int i = 0; i < code->inputs; i++) {
+        Value v = valueAt(st, st->size - code->inputs + i);
+        if (v.type != code->inputTypes[i])
+            return false;
+        slots[i] = v.integer; //os bits do inteiro ou do double
+    }
+    for (int i = 0; i < code->variables; i++) {
+        Value v = s->variables[code->variableIndex[i]];
+        if (v.type != code->variableTypes[i])
+            return false;
+        slots[code->inputs + i] = v.integer;
+    }
+
+    if (!code->entry(slots))
+        return false;
+
+    for (int i = 0; i < code->inputs; i++) //os valores consumidos são números, que só podem ter uma caixa
+        releaseStored(st->values[--st->size]);
+    st->hash = 0;
+    for (int i = 0; i < code->results; i++) {
+        Operand o = code->result[i];
+        Value v;
+        v.type = o.type;
+        v.integer = o.constant ? o.bits : slots[o.slot];
+        push(st, v);
+    }
+    return true;
+}
+
+/**
+ * \brief Liberta o código máquina de um bloco
+ * @param code O código máquina (pode ser NULL)
+ */
+void disposeJit(struct jitCode* code) {
+    if (code == NULL || code == &rejected)
+        return;
+    munmap(code->memory, code->size);
+    release(code->result);
+    release(code);
+}
+
+#else
+
+/**
+ * \brief Fora de x86-64 Linux os blocos são sempre interpretados
+ * @param s     O estado do programa
+ * @param block O bloco
+ * @return      0
+ */
+bool jitExecute(State* s, BlockCode block) {
+    (void) s;
+    (void) block;
+    return false;
+}
+
+/**
+ * \brief Fora de x86-64 Linux não há código máquina para libertar
+ * @param code O código máquina (sempre NULL)
+ */
+void disposeJit(struct jitCode* code) {
+    (void) code;
+}
+
+#endif
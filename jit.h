@@ -0,0 +1,24 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que compilam os blocos numéricos para
+ * código máquina (x86-64) e o executam
+ */
+
+//! Include guard
+#ifndef JIT_H
+//! Include guard
+#define JIT_H
+
+#include "stack.h"
+
+//! Número de execuções a partir do qual um bloco é compilado para código máquina
+#define JIT_THRESHOLD 64
+
+//! É verdadeiro se os blocos puderem ser compilados para código máquina
+extern bool jitEnabled;
+
+bool jitExecute(State* s, BlockCode block);
+
+void disposeJit(struct jitCode* code);
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que reconhecem os números
+ * escritos no input
+ *
+ * Os números são lidos numa só passagem pelos caracteres. Os inteiros são
+ * acumulados diretamente num long long (sem perder precisão acima dos 32 bits),
+ * e os que não cabem num long long passam a inteiros grandes;
+ * os números fracionários usam o caminho rápido de Clinger (mantissa até 2^53
+ * e expoente decimal até 22, resultado exato após um único arredondamento),
+ * recorrendo ao strtod, que também arredonda corretamente, nos restantes casos.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include "lexer.h"
+#include "bigInt.h"
+
+//! O maior inteiro representável exatamente num double
+#define MAX_EXACT_DOUBLE (1ULL << 53)
+
+//! As potências de 10 representáveis exatamente num double
+static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * \brief Verifica se o caracter é um algarismo
+ * @param c O caracter
+ * @return  1 se for um algarismo, 0 caso contrário
+ */
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * \brief Acumula os algarismos seguintes na mantissa dada
+ * @param s        Apontador para o primeiro algarismo; fica a apontar para o caracter seguinte
+ * @param m        A mantissa
+ * @param overflow Passa a verdadeiro se a mantissa deixar de caber em 64 bits
+ * @return         O número de algarismos lidos
+ */
+static long long readDigits(char** s, unsigned long long* m, bool* overflow) {
+    char* start = *s;
+
+    for (; isDigit(**s); (*s)++) {
+        unsigned d = **s - '0';
+        if (*m > (ULLONG_MAX - d) / 10)
+            *overflow = true;
+        else
+            *m = *m * 10 + d;
+    }
+
+    return *s - start;
+}
+
+/**
+ * \brief Lê o número que se encontra no início da string dada.
+ *
+ * Um número é um sinal opcional seguido de algarismos, opcionalmente seguidos
+ * de uma parte decimal (com expoente opcional); só os números com parte decimal
+ * são fracionários. Caracteres a seguir ao número são ignorados pelo lexer.
+ *
+ * @param str Apontador para a string; em caso de sucesso fica a apontar para
+ *            o caracter a seguir ao número
+ * @param v   Onde guardar o valor lido
+ * @return    1 se foi lido um número, 0 caso contrário
+ */
+bool readNumber(char** str, Value* v) {
+    char* s = *str;
+    bool negative = *s == '-';
+    bool overflow = false;
+    unsigned long long m = 0;
+
+    if (*s == '-' || *s == '+')
+        s++;
+
+    long long digits = readDigits(&s, &m, &overflow);
+
+    if (*s != '.') { //inteiro
+        if (digits == 0)
+            return false;
+
+        if (!overflow && m <= (unsigned long long) LLONG_MAX + negative)
+            *v = fromInteger(negative ? (long long) (0 - m) : (long long) m);
+        else //não cabe num long long
+            *v = fromBigInteger(bigFromString(*str));
+
+        *str = s;
+        return true;
+    }
+
+    s++;
+    long long fraction = readDigits(&s, &m, &overflow);
+    if (digits + fraction == 0)
+        return false;
+
+    long long exponent = 0;
+    char* e = s + 1;
+    if ((*s == 'e' || *s == 'E') && (isDigit(*e) || ((*e == '-' || *e == '+') && isDigit(e[1])))) {
+        s = e;
+        bool negativeExponent = *s == '-';
+        if (*s == '-' || *s == '+')
+            s++;
+        for (; isDigit(*s); s++)
+            if (exponent < 100000)
+                exponent = exponent * 10 + (*s - '0');
+        if (negativeExponent)
+            exponent = -exponent;
+    }
+    exponent -= fraction;
+
+    if (!overflow && m <= MAX_EXACT_DOUBLE && exponent >= -22 && exponent <= 22) {
+        double d = (double) m;
+        d = exponent < 0 ? d / powersOfTen[-exponent] : d * powersOfTen[exponent];
+        *v = fromDecimal(negative ? -d : d);
+    } else
+        *v = fromDecimal(strtod(*str, NULL));
+
+    *str = s;
+    return true;
+}
+
+/**
+ * \brief Lê uma array composta apenas por números (por exemplo `[1 2 3]`)
+ * diretamente para um valor, sem a compilar.
+ *
+ * @param str Apontador para o '[' que inicia a array; em caso de sucesso fica
+ *            a apontar para o ']' que a termina
+ * @param v   Onde guardar a array lida
+ * @return    1 se a array só contém números, 0 caso contrário (str não é alterado)
+ */
+bool readNumberArray(char** str, Value* v) {
+    Stack st = empty();
+    char* s = *str + 1;
+
+    while (true) {
+        while (*s == ' ')
+            s++;
+
+        if (*s == ']') {
+            *str = s;
+            *v = fromStack(st);
+            return true;
+        }
+
+        Value n;
+        if (!readNumber(&s, &n) || (*s != ' ' && *s != ']')) {
+            disposeStack(st);
+            return false;
+        }
+        push(st, n);
+    }
+}
@@ -0,0 +1,18 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que reconhecem os números
+ * escritos no input
+ */
+
+//! Include guard
+#ifndef LEXER_H
+//! Include guard
+#define LEXER_H
+
+#include "stack.h"
+
+bool readNumber(char** str, Value* v);
+
+bool readNumberArray(char** str, Value* v);
+
+#endif
@@ -8,12 +8,18 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
 #include "stack.h"
 #include "stackOperations.h"
 #include "arrayOperations.h"
 #include "blockOperations.h"
 #include "operations.h"
+#include "memory.h"
+#include "bigInt.h"
+#include "rrb.h"
+#include "error.h"
+
+//! Resultado da comparação de dois números que não são comparáveis (NaN)
+#define UNORDERED 2
 
 /**
  * \brief Avalia o valor lógico do value
@@ -23,11 +29,12 @@
 bool isTrue(Value a) {
 	switch (a.type) {
 		case Double:	return a.decimal != 0;
+		case BigInt:	return true; //um inteiro grande nunca é 0
 		case Int: 		return a.integer != 0;
 		case Char: 		return a.character != '\0';
 		case String:	
 		case Array:		return !isEmpty(a.array);
-		case Block: 	return !isEmptyBlock(a.block);
+		case Block: 	return !isEmptyBlock(a.block->source);
 		default:		return false;
 	}
 }
@@ -43,11 +50,14 @@ bool isTrue(Value a) {
 Value shortcutSelect(char* str, Value x, Value y) {
 	Value* r;
 
+	if (*str == '<' || *str == '>')
+		checkComparison(x, y);
+
 	switch (*str) {
 		case '&':	r = isTrue(x) ? &y : &x;									break;
 		case '|':	r = isTrue(x) ? &x : &y;									break;
-		case '<':	r = isTrue(isLess(deepCopy(x), deepCopy(y))) ? &x : &y;		break;
-		case '>':	r = isTrue(isGreater(deepCopy(x), deepCopy(y))) ? &x : &y;	break;
+		case '<':	r = lessThan(x, y) ? &x : &y;								break;
+		case '>':	r = greaterThan(x, y) ? &x : &y;							break;
 		default: 	r = isTrue(x) ? &x : &y;									break;
 	}
 
@@ -81,40 +91,171 @@ Value conditional(Value x, Value y, Value z){
 }
 
 /**
- * \brief Compara duas arrays. Destrói-as no final.
- * @param a   a primeira array
- * @param b   a segunda array
+ * \brief Verifica se o valor é uma string ou uma array
+ * @param a   o elemento do tipo #Value
+ * @return    1 se for, 0 se não
+ */
+static bool isCollection(Value a) {
+	return a.type == String || a.type == Array;
+}
+
+/**
+ * \brief Compara dois valores numéricos, depois de os converter para o mesmo tipo.
+ * Não altera os valores.
+ * @param x   o primeiro número
+ * @param y   o segundo número
+ * @return    -1, 0 ou 1 se x for menor, igual ou maior que y; UNORDERED se não
+ *            forem comparáveis (NaN)
+ */
+static int compareNumbers(Value x, Value y) {
+	//a conversão para inteiro grande alocaria memória: os inteiros são comparados diretamente
+	if (x.type == BigInt && y.type == Double)
+		x = fromDecimal(bigToDouble(x.big));
+	else if (y.type == BigInt && x.type == Double)
+		y = fromDecimal(bigToDouble(y.big));
+	else if (x.type == BigInt || y.type == BigInt)
+		return compareBig(x, y);
+
+	NumericOperationAux(&x, &y);
+	switch (x.type) {
+		case Double:
+			if (x.decimal < y.decimal)	return -1;
+			if (x.decimal > y.decimal)	return 1;
+			return x.decimal == y.decimal ? 0 : UNORDERED;
+		case Int:		return (x.integer > y.integer) - (x.integer < y.integer);
+		default:		return (x.character > y.character) - (x.character < y.character);
+	}
+}
+
+/**
+ * \brief Compara duas stacks elemento a elemento, sem alterar os seus valores
+ * (só passa os valores das árvores RRB para buffers, ver flatten). Termina assim
+ * que os tamanhos ou os hashes (se já estiverem calculados) forem diferentes.
+ * @param a   a primeira stack
+ * @param b   a segunda stack
  * @return    1 se forem iguais, 0 se não
  */
-bool compareArrays(Stack a, Stack b) {
-	while (!isEmpty(a) && !isEmpty(b)) {
-		if (!isTrue(isEqual(pop(a), pop(b)))) {
-			disposeStack(a);
-			disposeStack(b);
+bool equalStacks(Stack a, Stack b) {
+	if (length(a) != length(b))
+		return false;
+	if (a->hash != 0 && b->hash != 0 && a->hash != b->hash)
+		return false;
+
+	flatten(a);
+	flatten(b);
+	for (long long i = 0; i < length(a); i++) {
+		Value x = valueAt(a, i), y = valueAt(b, i);
+		if (x.type == Char && y.type == Char) { //caso mais frequente (strings)
+			if (x.character != y.character)
+				return false;
+		} else if (!equalValues(x, y))
 			return false;
-		}
 	}
+	return true;
+}
 
-	bool r = isEmpty(a) && isEmpty(b);
-	disposeStack(a);
-	disposeStack(b);
-	return r;
+/**
+ * \brief Verifica se dois valores são iguais, sem os alterar: os números são
+ * comparados depois de convertidos para o mesmo tipo, as strings e as arrays
+ * elemento a elemento e os blocos pela sua identidade.
+ * @param x   o primeiro valor
+ * @param y   o segundo valor
+ * @return    1 se forem iguais, 0 se não
+ */
+bool equalValues(Value x, Value y) {
+	if (isCollection(x) && isCollection(y))
+		return equalStacks(x.array, y.array);
+	if (x.type < String && y.type < String)
+		return compareNumbers(x, y) == 0;
+	return x.type == Block && y.type == Block && x.block == y.block;
 }
 
 /**
- * \brief Compara duas strings (sob a forma de valores) usando strcmp. Destrói-as no final.
+ * \brief Compara duas strings caracter a caracter, sem as alterar (tal como o
+ * strcmp, um caracter nulo termina a string).
  * @param a   a primeira string
  * @param b   a segunda string
- * @return    o resultado de strcmp: 0 se as strings forem iguais, negativo se
- * 			  a é inferior a b, positivo se b é inferior a a
+ * @return    0 se as strings forem iguais, negativo se a é inferior a b,
+ *            positivo se b é inferior a a
+ */
+int compareStrings(Stack a, Stack b) {
+	flatten(a);
+	flatten(b);
+	for (long long i = 0; ; i++) {
+		unsigned char x = i < length(a) ? valueAt(a, i).character : '\0';
+		unsigned char y = i < length(b) ? valueAt(b, i).character : '\0';
+		if (x != y)
+			return x < y ? -1 : 1;
+		if (x == '\0')
+			return 0;
+	}
+}
+
+/**
+ * \brief Verifica se dois valores que pertencem ao chamador podem ser comparados
+ * com lessThan e greaterThan. Se não puderem, liberta-os e assinala o mesmo erro
+ * que essas funções assinalariam (sem libertar os operandos).
+ * @param x   o primeiro valor
+ * @param y   o segundo valor
+ */
+void checkComparison(Value x, Value y) {
+	CHECK_OPERANDS(x.type != Block && y.type != Block, "comparação não definida para blocos", x, y);
+	if (x.type >= String && y.type == Int)
+		CHECK_OPERANDS(y.integer >= 0 && y.integer <= length(x.array), "índice fora dos limites", x, y);
+	else if (x.type == String)
+		CHECK_OPERANDS(y.type == String, "operandos de tipos incompatíveis", x, y);
+	else
+		CHECK_OPERANDS(x.type < String && y.type < String, "operandos de tipos incompatíveis", x, y);
+}
+
+/**
+ * \brief Verifica se o primeiro argumento é menor que o segundo, sem os alterar.
+ * Se x for uma string ou array e y um inteiro, verifica se os primeiros y
+ * elementos de x formam uma array não vazia. Se os valores não puderem ser
+ * comparados, o erro é assinalado sem os libertar (ver checkComparison).
+ * @param x   o elemento do tipo #Value
+ * @param y   o elemento do tipo #Value
+ * @return    1 se for verdade, 0 se for falso
+ */
+bool lessThan(Value x, Value y) {
+	//comparações entre blocos não suportadas
+	CHECK(x.type != Block && y.type != Block, "comparação não definida para blocos");
+	if (x.type >= String && y.type == Int) {
+		CHECK(y.integer >= 0 && y.integer <= length(x.array), "índice fora dos limites");
+		return y.integer > 0;
+	}
+	if (x.type == String) { //comparação entre strings
+		CHECK(y.type == String, "operandos de tipos incompatíveis");
+		return compareStrings(x.array, y.array) < 0;
+	}
+	//x e y são valores numéricos
+	CHECK(x.type < String && y.type < String, "operandos de tipos incompatíveis");
+	return compareNumbers(x, y) == -1;
+}
+
+/**
+ * \brief Verifica se o primeiro argumento é maior que o segundo, sem os alterar.
+ * Se x for uma string ou array e y um inteiro, verifica se os últimos y
+ * elementos de x formam uma array não vazia. Se os valores não puderem ser
+ * comparados, o erro é assinalado sem os libertar (ver checkComparison).
+ * @param x   o elemento do tipo #Value
+ * @param y   o elemento do tipo #Value
+ * @return    1 se for verdade, 0 se for falso
  */
-int compareStrings(Value x, Value y) {
-	char *xstr = toString(x), *ystr = toString(y);
-	int res = strcmp (xstr,ystr);
-	//libertar variáveis
-	free(xstr); 		free(ystr);
-	disposeValue(x);	disposeValue(y);
-	return res;
+bool greaterThan(Value x, Value y) {
+	//comparações entre blocos não suportadas
+	CHECK(x.type != Block && y.type != Block, "comparação não definida para blocos");
+	if (x.type >= String && y.type == Int) {
+		CHECK(y.integer >= 0 && y.integer <= length(x.array), "índice fora dos limites");
+		return y.integer > 0;
+	}
+	if (x.type == String) { //comparação entre strings
+		CHECK(y.type == String, "operandos de tipos incompatíveis");
+		return compareStrings(x.array, y.array) > 0;
+	}
+	//x e y são valores numéricos
+	CHECK(x.type < String && y.type < String, "operandos de tipos incompatíveis");
+	return compareNumbers(x, y) == 1;
 }
 
 /**
@@ -125,31 +266,29 @@ int compareStrings(Value x, Value y) {
  */
 Value isEqual (Value x, Value y){
 	//comparações entre blocos não suportadas
-	assert(x.type != Block && y.type != Block);
-
-	if (x.type >= String) {
-		if (y.type == Int) { //aceder ao elemento especificado
-			assert(y.integer >= 0 && y.integer < length(x.array));
-			Value resultado = x.array->values[y.integer];
+	CHECK_OPERANDS(x.type != Block && y.type != Block, "comparação não definida para blocos", x, y);
+	if (x.type >= String && y.type == Int) { //aceder ao elemento especificado
+		CHECK_OPERANDS(y.integer >= 0 && y.integer < length(x.array), "índice fora dos limites", x, y);
+		Value resultado;
+		if (x.array->tree != NULL) //o valor pertence a uma árvore que pode ser partilhada
+			resultado = deepCopy(loadValue(rrbGet(x.array->tree, y.integer)));
+		else if (isView(x.array)) //os valores pertencem a outra stack
+			resultado = deepCopy(valueAt(x.array, y.integer));
+		else {
+			resultado = valueAt(x.array, y.integer);
 			//para evitar usar deepCopy (pode ser dispendioso), tiramos o Value da array diretamente
 			//e depois substituímo-lo por outro valor para nao o apagar no dispose da array
-			x.array->values[y.integer] = fromInteger(0);
-			disposeValue(x);
-			return resultado;
+			setValueAt(x.array, y.integer, fromInteger(0));
 		}
-		assert(y.type >= String);
-		return fromInteger(compareArrays(x.array, y.array));
-	}
-
-	assert(y.type < String); //x e y são numéricos
-	//convertemos para o mesmo tipo antes de comparar
-	NumericOperationAux(&x,&y);
-	switch(x.type){
-		case Double: 	return fromInteger(x.decimal==y.decimal);//testar tolerâncias
-		case Int:		return fromInteger(x.integer==y.integer);
-		case Char:		return fromInteger(x.character==y.character);
-		default:		return fromInteger(UNDEFINED); //Caso de erro
+		disposeValue(x);
+		return resultado;
 	}
+	//x e y são ambos strings/arrays ou ambos números
+	CHECK_OPERANDS((x.type >= String) == (y.type >= String), "operandos de tipos incompatíveis", x, y);
+	Value r = fromInteger(equalValues(x, y));
+	disposeValue(x);
+	disposeValue(y);
+	return r;
 }
 
 /**
@@ -158,32 +297,19 @@ Value isEqual (Value x, Value y){
  * @param y   o elemento do tipo #Value 
  * @return    1 se for verdade, 0 se for falso
  */
-
 Value isLess (Value x, Value y){
 	//comparações entre blocos não suportadas
-	assert(x.type != Block && y.type != Block);
-
-    if(x.type >= String && y.type==Int){ //manter os primeiros y elementos
-    	assert(y.integer >= 0 && y.integer <= length(x.array));
-		disposeStack(split(x.array, length(x.array) - y.integer));
+	CHECK_OPERANDS(x.type != Block && y.type != Block, "comparação não definida para blocos", x, y);
+    if(x.type >= String && y.type==Int){ //manter os primeiros y elementos (sem os copiar)
+    	CHECK_OPERANDS(y.integer >= 0 && y.integer <= length(x.array), "índice fora dos limites", x, y);
+		x.array = slice(x.array, 0, y.integer);
 		return x;
 	}
-	if (x.type == String) { //comparação entre strings
-		assert(y.type == String);
-		return fromInteger(compareStrings(x, y) < 0);
-	}
-	
-	//x e y são valores numéricos
-	assert(x.type < String && y.type < String);
-
-	//convertemos para o mesmo tipo antes de comparar
-    NumericOperationAux(&x,&y);
-	switch(x.type){
-		case Double:	return fromInteger(x.decimal < y.decimal);//testar tolerâncias
-		case Int:		return fromInteger(x.integer < y.integer);
-		case Char:		return fromInteger(x.character < y.character);
-		default:		return fromInteger(UNDEFINED); //Caso de erro
-	}
+	checkComparison(x, y);
+	Value r = fromInteger(lessThan(x, y));
+	disposeValue(x);
+	disposeValue(y);
+	return r;
 }
 
 /**
@@ -192,34 +318,19 @@ Value isLess (Value x, Value y){
  * @param y   o elemento do tipo #Value 
  * @return    1 se for verdade, 0 se for falso
  */
-
 Value isGreater (Value x, Value y){
 	//comparações entre blocos não suportadas
-	assert(x.type != Block && y.type != Block);
-
-    if(x.type >= String && y.type==Int){ //manter os últimos y elementos da array
-    	assert(y.integer >= 0 && y.integer <= length(x.array));
-		Stack ans = split(x.array,y.integer);
-		disposeValue(x);
-		return fromStack(ans);
-	}
-
-	if (x.type == String) { //comparação entre strings
-		assert(y.type == String);
-		return fromInteger(compareStrings(x, y) > 0);
-	}
-	
-	//x e y são valores numéricos
-	assert(x.type < String && y.type < String);
-
-	//convertemos para o mesmo tipo antes de comparar
-    NumericOperationAux(&x,&y);
-	switch(x.type){
-		case Double:	return fromInteger(x.decimal>y.decimal);//testar tolerâncias
-		case Int:		return fromInteger(x.integer>y.integer);
-		case Char:		return fromInteger(x.character>y.character);
-		default:		return fromInteger(UNDEFINED); //Caso de erro
+	CHECK_OPERANDS(x.type != Block && y.type != Block, "comparação não definida para blocos", x, y);
+    if(x.type >= String && y.type==Int){ //manter os últimos y elementos (sem os copiar)
+    	CHECK_OPERANDS(y.integer >= 0 && y.integer <= length(x.array), "índice fora dos limites", x, y);
+		x.array = slice(x.array, length(x.array) - y.integer, y.integer);
+		return x;
 	}
+	checkComparison(x, y);
+	Value r = fromInteger(greaterThan(x, y));
+	disposeValue(x);
+	disposeValue(y);
+	return r;
 }
 
 /**
@@ -242,7 +353,13 @@ Value logicNot (Value x){
  */
 void setVariable(char var, State* s){
 	disposeValue(s->variables[var - 'A']);
-	s->variables[var-'A'] = deepCopy(top(s->stack));
+	if (isView(s->stack)) //não se pode alterar o topo de uma vista
+		s->variables[var-'A'] = deepCopy(top(s->stack));
+	else { //a variável e o topo da stack partilham os elementos
+		Value v = top(s->stack);
+		s->variables[var-'A'] = share(&v);
+		setValueAt(s->stack, s->stack->size - 1, v);
+	}
 }
 
 /**
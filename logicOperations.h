@@ -18,9 +18,17 @@ Value shortcutSelect(char*, Value, Value);
 
 Value conditional(Value x, Value y, Value z);
 
-bool compareArrays(Stack a, Stack b);
+bool equalStacks(Stack a, Stack b);
 
-int compareStrings(Value a, Value b);
+bool equalValues(Value x, Value y);
+
+int compareStrings(Stack a, Stack b);
+
+void checkComparison(Value x, Value y);
+
+bool lessThan(Value x, Value y);
+
+bool greaterThan(Value x, Value y);
 
 Value isEqual (Value x, Value y);
 
@@ -11,26 +11,131 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <unistd.h>
 #include "parser.h"
 #include "operations.h"
+#include "memory.h"
+#include "trace.h"
+#include "records.h"
+#include "jit.h"
+#include "profile.h"
+#include "analysis.h"
 
 /**
  *
  * \brief O ponto de entrada da aplicação.
- * 
+ *
+ * Opções aceites:
+ *  -m          escreve as estatísticas de memória no stderr no fim da execução
+ *  -t ficheiro regista a execução dos blocos no formato Chrome trace
+ *  -f ficheiro regista a execução dos blocos no formato folded stacks (flamegraphs)
+ *  -r n        cronometra apenas uma execução de bloco em cada n (por omissão 1)
+ *  -j n        executa o programa sobre cada uma das linhas seguintes do input,
+ *              em n threads (ver records.c)
+ *  -a          com -j, aloca a memória de cada linha numa região, libertada
+ *              de uma vez no fim da linha
+ *  -J          não compila os blocos para código máquina (ver jit.c)
+ *  -n ficheiro acrescenta ao ficheiro as contagens das sequências de
+ *              instruções executadas (ver profile.c)
+ *  -e          escreve no stderr, no fim da execução, o efeito sobre a stack de
+ *              cada bloco compilado (ver analysis.c)
+ *  -s          executa o programa sobre cada uma das linhas seguintes do input,
+ *              à medida que são lidas, com a linha na stack (ver records.c)
+ *  -k letras   com -s, as variáveis que mantêm o valor de uma linha para a seguinte
+ *
  */
-int main() {
+int main(int argc, char** argv) {
     State st;
+    bool memoryReport = false, regions = false, effects = false, stream = false;
+    char *chromeFile = NULL, *foldedFile = NULL, *profileFile = NULL, *keep = NULL;
+    long long sampleRate = 1;
+    int opt, workers = 0;
+
+    while ((opt = getopt(argc, argv, "mt:f:r:j:aJn:esk:")) != -1) {
+        switch (opt) {
+            case 'm':   memoryReport = true;            break;
+            case 't':   chromeFile = optarg;            break;
+            case 'f':   foldedFile = optarg;            break;
+            case 'r':   sampleRate = atoll(optarg);     break;
+            case 'j':   workers = atoi(optarg);         break;
+            case 'a':   regions = true;                 break;
+            case 'J':   jitEnabled = false;             break;
+            case 'n':   profileFile = optarg;           break;
+            case 'e':   effects = true;                 break;
+            case 's':   stream = true;                  break;
+            case 'k':   keep = optarg;                  break;
+            default:
+                fprintf(stderr, "Uso: %s [-m] [-t trace.json] [-f stacks.folded] [-r n] [-j n [-a]] [-J] [-n ngramas.tsv] [-e] [-s [-k letras]]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (workers < 0 || (workers > 0 && (chromeFile != NULL || foldedFile != NULL || profileFile != NULL || effects))) {
+        fprintf(stderr, "erro: -j precisa de um número positivo de threads e não pode ser usado com -t, -f, -n ou -e\n");
+        return 1;
+    }
+
+    if (stream && (workers > 0 || chromeFile != NULL || foldedFile != NULL || profileFile != NULL || effects)) {
+        fprintf(stderr, "erro: -s não pode ser usado com -j, -t, -f, -n ou -e\n");
+        return 1;
+    }
+
+    if (keep != NULL && !stream) {
+        fprintf(stderr, "erro: -k só pode ser usado com -s\n");
+        return 1;
+    }
+
     char *line = getInput();
+    if (line == NULL) {
+        fprintf(stderr, "erro: o input não contém nenhum programa\n");
+        return 1;
+    }
+
+    if (workers > 0 || stream) {
+        bool ok = stream ? streamRecords(line, stdin, stdout, keep) : processRecords(line, stdin, stdout, workers, regions);
+        free(line);
+        if (memoryReport)
+            printMemoryStats(stderr);
+        return ok ? 0 : 1;
+    }
+
+    if (chromeFile != NULL || foldedFile != NULL) {
+        const char* failed = startTrace(chromeFile, foldedFile, sampleRate);
+        if (failed != NULL) {
+            perror(failed);
+            free(line);
+            return 1;
+        }
+    }
+
+    if (profileFile != NULL) {
+        if (!startProfile(profileFile)) {
+            perror(profileFile);
+            free(line);
+            return 1;
+        }
+        jitEnabled = false; //o código máquina não executa as instruções uma a uma
+    }
 
     char *pointer = line;
-    st.stack=empty();
-    initializeVariables(&st);
-    processInput(&pointer, &st);
-    printStackLine(st.stack);
+    EvalError error;
+    BlockTable blocks = newBlockTable();
+    initializeState(&st, blocks);
+    bool ok = tryProcessInput(&pointer, &st, &error);
+    stopTrace();
+    stopProfile();
+    if (ok)
+        printStackLine(stdout, st.stack);
+    else
+        printError(stderr, &error);
+    if (effects)
+        printBlockEffects(stderr, blocks);
     //O line é alocado dinamicamente e, por isso, deve ser desalocado quando deixar de ser usado.
     free(line);
-    disposeVariables(&st);
-    disposeStack(st.stack);
-    return 0;
+    disposeState(&st);
+    disposeBlockTable(blocks);
+
+    if (memoryReport)
+        printMemoryStats(stderr);
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,381 @@
+/**
+ * @file
+ * @brief contém a implementação das funções de alocação de memória
+ * e da contabilização da memória usada pelo programa
+ *
+ * Enquanto uma região estiver ativa na thread (enterRegion), as alocações são
+ * feitas sequencialmente nos blocos da região, e release não faz nada: toda a
+ * memória da região é libertada de uma vez por resetRegion. Os blocos da região
+ * são mantidos e reutilizados pelas alocações seguintes. As alocações maiores do
+ * que metade de um bloco são feitas à parte (com malloc) e libertadas no reset.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+
+/**
+ * \brief Cabeçalho guardado imediatamente antes de cada bloco alocado,
+ * permitindo saber o tamanho e a categoria do bloco quando este é libertado
+ */
+typedef struct allocHeader {
+    //! O tamanho pedido (sem o cabeçalho)
+    size_t size;
+    //! A categoria da alocação (com IN_REGION se pertencer a uma região)
+    long long category;
+} AllocHeader;
+
+//! Marca, na categoria do cabeçalho, as alocações feitas numa região
+#define IN_REGION (1LL << 32)
+
+//! Tamanho de cada bloco de uma região
+#define REGION_CHUNK_SIZE (64 * 1024)
+
+//! Alinhamento das alocações feitas numa região
+#define REGION_ALIGNMENT 16
+
+/**
+ * \brief Um bloco de memória de uma região
+ */
+typedef struct regionChunk {
+    //! O bloco seguinte
+    struct regionChunk* next;
+    //! O tamanho da memória do bloco
+    size_t size;
+    //! A memória do bloco (alinhada a REGION_ALIGNMENT)
+    _Alignas(REGION_ALIGNMENT) char data[];
+} RegionChunk;
+
+/**
+ * \brief Uma região de memória
+ */
+struct region {
+    //! O primeiro bloco
+    RegionChunk* first;
+    //! O bloco onde são feitas as alocações
+    RegionChunk* current;
+    //! Número de bytes usados no bloco atual
+    size_t used;
+    //! A última alocação feita no bloco atual (pode crescer sem ser copiada)
+    AllocHeader* last;
+    //! As alocações grandes, feitas à parte
+    RegionChunk* large;
+    //! Número de alocações de cada categoria desde o último reset
+    long long allocations[ALLOC_CATEGORIES];
+    //! Bytes alocados de cada categoria desde o último reset
+    long long bytes[ALLOC_CATEGORIES];
+};
+
+//! As estatísticas de memória acumuladas (de cada thread)
+static _Thread_local MemoryStats stats;
+
+//! A região ativa na thread (NULL se as alocações forem feitas com malloc)
+static _Thread_local Region currentRegion = NULL;
+
+//! Nomes das categorias, usados no relatório
+static const char* categoryNames[ALLOC_CATEGORIES] = {
+    "stacks", "value buffers", "block strings", "temp strings", "programs",
+    "hash tables", "big integers", "boxed integers", "rrb nodes"
+};
+
+/**
+ * \brief Contabiliza a variação de bytes de uma categoria
+ * @param category A categoria
+ * @param delta    A variação (positiva numa alocação, negativa numa libertação)
+ */
+static void account(AllocCategory category, long long delta) {
+    AllocStats* c = &stats.category[category];
+
+    c->liveBytes += delta;
+    if (c->liveBytes > c->peakBytes)
+        c->peakBytes = c->liveBytes;
+
+    stats.liveBytes += delta;
+    if (stats.liveBytes > stats.peakBytes)
+        stats.peakBytes = stats.liveBytes;
+}
+
+/**
+ * \brief Cria um bloco de memória de uma região
+ * @param size O tamanho da memória do bloco
+ * @return     O bloco
+ */
+static RegionChunk* newChunk(size_t size) {
+    RegionChunk* c = aligned_alloc(REGION_ALIGNMENT, sizeof(RegionChunk) + size);
+    c->next = NULL;
+    c->size = size;
+    return c;
+}
+
+/**
+ * \brief Aloca memória numa região (sem a contabilizar nas estatísticas)
+ * @param r        A região
+ * @param category A categoria da alocação
+ * @param size     O número de bytes a alocar
+ * @return         O apontador para a memória alocada
+ */
+static void* regionAllocate(Region r, AllocCategory category, size_t size) {
+    size_t total = (sizeof(AllocHeader) + size + REGION_ALIGNMENT - 1) & ~(size_t) (REGION_ALIGNMENT - 1);
+    AllocHeader* h;
+
+    r->allocations[category]++;
+    r->bytes[category] += size;
+
+    if (total > REGION_CHUNK_SIZE / 2) {
+        RegionChunk* c = newChunk(total);
+        c->next = r->large;
+        r->large = c;
+        h = (AllocHeader*) c->data;
+    } else {
+        if (r->used + total > r->current->size) {
+            if (r->current->next == NULL)
+                r->current->next = newChunk(REGION_CHUNK_SIZE);
+            r->current = r->current->next;
+            r->used = 0;
+        }
+
+        h = (AllocHeader*) (r->current->data + r->used);
+        r->used += total;
+        r->last = h;
+    }
+
+    h->size = size;
+    h->category = category | IN_REGION;
+    return h + 1;
+}
+
+/**
+ * \brief Aloca memória, contabilizando-a na categoria dada.
+ *
+ * A memória devolvida deve ser libertada com #release.
+ *
+ * @param category A categoria da alocação
+ * @param size     O número de bytes a alocar
+ * @return         O apontador para a memória alocada
+ */
+void* allocate(AllocCategory category, size_t size) {
+    stats.category[category].allocations++;
+    account(category, size);
+
+    if (currentRegion != NULL)
+        return regionAllocate(currentRegion, category, size);
+
+    AllocHeader* h = malloc(sizeof(AllocHeader) + size);
+    h->size = size;
+    h->category = category;
+    return h + 1;
+}
+
+/**
+ * \brief Altera o tamanho de um bloco alocado com #allocate
+ * @param ptr  O bloco
+ * @param size O novo tamanho
+ * @return     O apontador para o bloco (possivelmente noutra posição)
+ */
+void* reallocate(void* ptr, size_t size) {
+    AllocHeader* h = (AllocHeader*) ptr - 1;
+    long long delta = (long long) size - (long long) h->size;
+
+    if (h->category & IN_REGION) {
+        AllocCategory category = h->category & ~IN_REGION;
+        Region r = currentRegion;
+        size_t total = (sizeof(AllocHeader) + size + REGION_ALIGNMENT - 1) & ~(size_t) (REGION_ALIGNMENT - 1);
+
+        //a última alocação do bloco atual cresce no lugar, se couber
+        if (r != NULL && h == r->last && (char*) h - r->current->data + total <= r->current->size) {
+            r->used = (char*) h - r->current->data + total;
+            r->bytes[category] += delta;
+            h->size = size;
+            account(category, delta);
+            return ptr;
+        }
+
+        //caso contrário, é copiada (a cópia antiga só é libertada no reset)
+        void* copy = allocate(category, size);
+        memcpy(copy, ptr, h->size < size ? h->size : size);
+        return copy;
+    }
+
+    h = realloc(h, sizeof(AllocHeader) + size);
+    h->size = size;
+    account(h->category, delta);
+    return h + 1;
+}
+
+/**
+ * \brief Liberta um bloco alocado com #allocate
+ * @param ptr O bloco (pode ser NULL)
+ */
+void release(void* ptr) {
+    if (ptr == NULL)
+        return;
+
+    AllocHeader* h = (AllocHeader*) ptr - 1;
+    if (h->category & IN_REGION) //é libertado no reset da região
+        return;
+
+    stats.category[h->category].frees++;
+    account(h->category, -(long long) h->size);
+    free(h);
+}
+
+/**
+ * \brief Cria uma região vazia
+ * @return A região, que deve ser libertada com #disposeRegion
+ */
+Region newRegion() {
+    Region r = calloc(1, sizeof(struct region));
+    r->first = r->current = newChunk(REGION_CHUNK_SIZE);
+    return r;
+}
+
+/**
+ * \brief Torna a região dada a região ativa da thread: as alocações seguintes
+ * da thread são feitas nela
+ * @param r A região (NULL para voltar a alocar com malloc)
+ * @return  A região que estava ativa
+ */
+Region enterRegion(Region r) {
+    Region previous = currentRegion;
+    currentRegion = r;
+    return previous;
+}
+
+/**
+ * \brief Verifica se um bloco alocado com #allocate foi alocado fora da região
+ * ativa da thread, pelo que sobrevive ao seu reset
+ * @param ptr O bloco
+ * @return    1 se houver uma região ativa e o bloco não tiver sido alocado numa região
+ */
+int outlivesRegion(const void* ptr) {
+    return currentRegion != NULL && !(((const AllocHeader*) ptr - 1)->category & IN_REGION);
+}
+
+/**
+ * \brief Liberta de uma vez toda a memória alocada numa região, que fica
+ * pronta a ser reutilizada
+ * @param r A região
+ */
+void resetRegion(Region r) {
+    for (int i = 0; i < ALLOC_CATEGORIES; i++) {
+        stats.category[i].frees += r->allocations[i];
+        account(i, -r->bytes[i]);
+        r->allocations[i] = r->bytes[i] = 0;
+    }
+
+    while (r->large != NULL) {
+        RegionChunk* c = r->large;
+        r->large = c->next;
+        free(c);
+    }
+
+    r->current = r->first;
+    r->used = 0;
+    r->last = NULL;
+}
+
+/**
+ * \brief Liberta uma região e toda a memória alocada nela
+ * @param r A região
+ */
+void disposeRegion(Region r) {
+    resetRegion(r);
+    while (r->first != NULL) {
+        RegionChunk* c = r->first;
+        r->first = c->next;
+        free(c);
+    }
+    free(r);
+}
+
+/**
+ * \brief Cria uma cópia da string dada, contabilizando-a na categoria dada
+ * @param category A categoria da alocação
+ * @param str      A string a copiar
+ * @return         A cópia, que deve ser libertada com #release
+ */
+char* duplicateString(AllocCategory category, const char* str) {
+    size_t size = strlen(str) + 1;
+    char* copy = allocate(category, size);
+    memcpy(copy, str, size);
+    return copy;
+}
+
+/**
+ * \brief Regista uma chamada a deepCopy
+ * @param bytes O número de bytes copiados diretamente pela chamada
+ */
+void registerDeepCopy(long long bytes) {
+    stats.deepCopies++;
+    stats.bytesCopied += bytes;
+}
+
+/**
+ * \brief Regista uma chamada a clone
+ * @param bytes O número de bytes copiados diretamente pela chamada
+ */
+void registerClone(long long bytes) {
+    stats.clones++;
+    stats.bytesCopied += bytes;
+}
+
+/**
+ * \brief Devolve as estatísticas de memória atuais
+ * @return Uma cópia das estatísticas
+ */
+MemoryStats getMemoryStats() {
+    return stats;
+}
+
+/**
+ * \brief Junta às estatísticas da thread atual as de outra thread. Os máximos
+ * são somados, pelo que o resultado é um majorante do máximo em simultâneo.
+ * @param other As estatísticas da outra thread
+ */
+void mergeMemoryStats(MemoryStats other) {
+    for (int i = 0; i < ALLOC_CATEGORIES; i++) {
+        AllocStats* c = &stats.category[i];
+        c->allocations += other.category[i].allocations;
+        c->frees += other.category[i].frees;
+        c->liveBytes += other.category[i].liveBytes;
+        c->peakBytes += other.category[i].peakBytes;
+    }
+
+    stats.liveBytes += other.liveBytes;
+    stats.peakBytes += other.peakBytes;
+    stats.deepCopies += other.deepCopies;
+    stats.clones += other.clones;
+    stats.bytesCopied += other.bytesCopied;
+}
+
+/**
+ * \brief Recomeça a contagem das estatísticas, mantendo os bytes ainda alocados
+ */
+void resetMemoryStats() {
+    for (int i = 0; i < ALLOC_CATEGORIES; i++) {
+        AllocStats* c = &stats.category[i];
+        c->allocations = c->frees = 0;
+        c->peakBytes = c->liveBytes;
+    }
+
+    stats.peakBytes = stats.liveBytes;
+    stats.deepCopies = stats.clones = stats.bytesCopied = 0;
+}
+
+/**
+ * \brief Escreve um relatório das estatísticas de memória
+ * @param f O ficheiro onde escrever
+ */
+void printMemoryStats(FILE* f) {
+    fprintf(f, "%-14s %12s %12s %14s %14s\n", "category", "allocs", "frees", "live bytes", "peak bytes");
+
+    for (int i = 0; i < ALLOC_CATEGORIES; i++) {
+        AllocStats c = stats.category[i];
+        fprintf(f, "%-14s %12lld %12lld %14lld %14lld\n", categoryNames[i],
+                c.allocations, c.frees, c.liveBytes, c.peakBytes);
+    }
+
+    fprintf(f, "%-14s %12s %12s %14lld %14lld\n", "total", "", "", stats.liveBytes, stats.peakBytes);
+    fprintf(f, "deepCopy calls: %lld, clone calls: %lld, bytes copied: %lld\n",
+            stats.deepCopies, stats.clones, stats.bytesCopied);
+}
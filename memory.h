@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @brief contém a declaração das funções de alocação de memória
+ * e da contabilização da memória usada pelo programa
+ */
+
+//! Include guard
+#ifndef MEMORY_H
+//! Include guard
+#define MEMORY_H
+
+#include <stdio.h>
+
+/**
+ * \brief Representa as diferentes categorias de alocações contabilizadas
+ */
+typedef enum allocCategory {
+    StackAlloc,     //!< Estruturas das stacks
+    ValueBuffer,    //!< Arrays de valores das stacks
+    BlockString,    //!< Texto dos blocos
+    TempString,     //!< Strings temporárias (toString e conversões)
+    ProgramAlloc,   //!< Programas compilados
+    HashTable,      //!< Tabelas de dispersão temporárias (operações de conjuntos)
+    BigIntAlloc,    //!< Inteiros grandes (estrutura e algarismos)
+    BoxedInt,       //!< Inteiros guardados fora das stacks (só com NAN_BOXING, ver stack.h)
+    RrbNodeAlloc,   //!< Nós das árvores RRB das arrays grandes (ver rrb.c)
+    ALLOC_CATEGORIES //!< Número de categorias
+} AllocCategory;
+
+/**
+ * \brief Estatísticas de uma categoria de alocações
+ */
+typedef struct allocStats {
+    long long allocations;  //!< Número de alocações efetuadas
+    long long frees;        //!< Número de libertações efetuadas
+    long long liveBytes;    //!< Bytes atualmente alocados
+    long long peakBytes;    //!< Máximo de bytes alocados em simultâneo
+} AllocStats;
+
+/**
+ * \brief Estatísticas de memória do programa
+ */
+typedef struct memoryStats {
+    //! Estatísticas de cada categoria
+    AllocStats category[ALLOC_CATEGORIES];
+    //! Bytes atualmente alocados (todas as categorias)
+    long long liveBytes;
+    //! Máximo de bytes alocados em simultâneo (todas as categorias)
+    long long peakBytes;
+    //! Número de chamadas a deepCopy
+    long long deepCopies;
+    //! Número de chamadas a clone
+    long long clones;
+    //! Bytes copiados por deepCopy e clone
+    long long bytesCopied;
+} MemoryStats;
+
+//! Uma região de memória, libertada de uma vez (ver memory.c)
+typedef struct region* Region;
+
+void* allocate(AllocCategory category, size_t size);
+
+void* reallocate(void* ptr, size_t size);
+
+void release(void* ptr);
+
+Region newRegion();
+
+Region enterRegion(Region r);
+
+int outlivesRegion(const void* ptr);
+
+void resetRegion(Region r);
+
+void disposeRegion(Region r);
+
+char* duplicateString(AllocCategory category, const char* str);
+
+void registerDeepCopy(long long bytes);
+
+void registerClone(long long bytes);
+
+MemoryStats getMemoryStats();
+
+void mergeMemoryStats(MemoryStats other);
+
+void resetMemoryStats();
+
+void printMemoryStats(FILE* f);
+
+#endif
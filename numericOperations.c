@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @brief contém a implementação das operações numéricas especializadas para
+ * cada par de tipos dos operandos e da tabela que as seleciona
+ *
+ * Os operadores genéricos (sum, subtract, isLess, ...) verificam os tipos dos
+ * operandos numa cascata de condições e convertem-nos para o mesmo tipo antes
+ * de calcular o resultado. Para os pares mais frequentes (Int×Int,
+ * Double×Double, Char×Char e Int×Double) há uma função que calcula o resultado
+ * diretamente. A tabela é indexada pelo operador e pelos tipos dos dois
+ * operandos; os pares sem entrada (inteiros grandes, operações não definidas)
+ * são sempre tratados pelo operador genérico.
+ *
+ * Cada operação produz exatamente o mesmo valor que o operador genérico. Os
+ * casos em que este passa para inteiros grandes ou falha (divisão por zero) não
+ * são tratados: a operação devolve 0 e o operador genérico é executado.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "numericOperations.h"
+
+//! Os operadores que têm operações especializadas, pela ordem das linhas da tabela
+#define NUMERIC_OPERATORS "+-*/%#&|^=<>"
+
+//! Número de operadores que têm operações especializadas
+#define OPERATOR_COUNT (sizeof(NUMERIC_OPERATORS) - 1)
+
+//! Constrói um Value inteiro
+#define INTEGER(x) ((Value) { .type = Int, .integer = (x) })
+//! Constrói um Value fracionário
+#define DECIMAL(x) ((Value) { .type = Double, .decimal = (x) })
+//! Constrói um Value caracter
+#define CHARACTER(x) ((Value) { .type = Char, .character = (x) })
+
+/**
+ * \brief Define uma operação entre dois inteiros que deixa para o operador
+ * genérico os resultados que não cabem num long long
+ */
+#define INT_CHECKED(name, builtin) \
+    static bool name##Int(Value a, Value b, Value* r) { \
+        r->type = Int; \
+        return !builtin(a.integer, b.integer, &r->integer); \
+    }
+
+/**
+ * \brief Define uma operação entre dois operandos do mesmo tipo (x e y), que só
+ * é calculada se a condição for verdadeira
+ */
+#define SAME_TYPE(name, suffix, field, condition, result) \
+    static bool name##suffix(Value a, Value b, Value* r) { \
+        __typeof__(a.field) x = a.field, y = b.field; \
+        if (!(condition)) \
+            return false; \
+        *r = result; \
+        return true; \
+    }
+
+/**
+ * \brief Define uma operação entre doubles, para os pares Double×Double,
+ * Int×Double e Double×Int (o inteiro é convertido para double, tal como no
+ * operador genérico)
+ */
+#define DOUBLE_OPERATION(name, condition, result) \
+    static inline bool name##Decimal(double x, double y, Value* r) { \
+        if (!(condition)) \
+            return false; \
+        *r = result; \
+        return true; \
+    } \
+    static bool name##DD(Value a, Value b, Value* r) { return name##Decimal(a.decimal, b.decimal, r); } \
+    static bool name##ID(Value a, Value b, Value* r) { return name##Decimal((double) a.integer, b.decimal, r); } \
+    static bool name##DI(Value a, Value b, Value* r) { return name##Decimal(a.decimal, (double) b.integer, r); }
+
+INT_CHECKED(sum, __builtin_add_overflow)
+INT_CHECKED(subtract, __builtin_sub_overflow)
+INT_CHECKED(multiply, __builtin_mul_overflow)
+//LLONG_MIN / -1 não cabe num long long
+SAME_TYPE(divide, Int, integer, y != 0 && y != -1, INTEGER(x / y))
+//LLONG_MIN % -1 excede um long long no cálculo intermédio
+SAME_TYPE(module, Int, integer, y != 0, INTEGER(y == -1 ? 0 : x % y))
+SAME_TYPE(and, Int, integer, true, INTEGER(x & y))
+SAME_TYPE(or, Int, integer, true, INTEGER(x | y))
+SAME_TYPE(xor, Int, integer, true, INTEGER(x ^ y))
+SAME_TYPE(equal, Int, integer, true, INTEGER(x == y))
+SAME_TYPE(less, Int, integer, true, INTEGER(x < y))
+SAME_TYPE(greater, Int, integer, true, INTEGER(x > y))
+
+SAME_TYPE(sum, Char, character, true, CHARACTER(x + y))
+SAME_TYPE(subtract, Char, character, true, CHARACTER(x - y))
+SAME_TYPE(multiply, Char, character, true, CHARACTER(x * y))
+SAME_TYPE(divide, Char, character, y != 0, CHARACTER(x / y))
+SAME_TYPE(module, Char, character, y != 0, CHARACTER(x % y))
+SAME_TYPE(and, Char, character, true, CHARACTER(x & y))
+SAME_TYPE(or, Char, character, true, CHARACTER(x | y))
+SAME_TYPE(xor, Char, character, true, CHARACTER(x ^ y))
+SAME_TYPE(equal, Char, character, true, INTEGER(x == y))
+SAME_TYPE(less, Char, character, true, INTEGER(x < y))
+SAME_TYPE(greater, Char, character, true, INTEGER(x > y))
+
+DOUBLE_OPERATION(sum, true, DECIMAL(x + y))
+DOUBLE_OPERATION(subtract, true, DECIMAL(x - y))
+DOUBLE_OPERATION(multiply, true, DECIMAL(x * y))
+DOUBLE_OPERATION(divide, y != 0, DECIMAL(x / y))
+DOUBLE_OPERATION(module, true, DECIMAL(fmod(x, y)))
+DOUBLE_OPERATION(power, true, DECIMAL(pow(x, y)))
+//com NaN as três comparações são falsas
+DOUBLE_OPERATION(equal, true, INTEGER(x == y))
+DOUBLE_OPERATION(less, true, INTEGER(x < y))
+DOUBLE_OPERATION(greater, true, INTEGER(x > y))
+
+//! Preenche a linha da tabela de um operador definido para todos os pares
+#define ALL_PAIRS(name) { \
+        [Double] = { [Double] = name##DD, [Int] = name##DI }, \
+        [Int] = { [Double] = name##ID, [Int] = name##Int }, \
+        [Char] = { [Char] = name##Char }, \
+    }
+
+//! Preenche a linha da tabela de um operador definido apenas para inteiros e caracteres
+#define INTEGRAL_PAIRS(name) { \
+        [Int] = { [Int] = name##Int }, \
+        [Char] = { [Char] = name##Char }, \
+    }
+
+//! Preenche a linha da tabela de um operador especializado apenas para doubles
+#define DECIMAL_PAIRS(name) { \
+        [Double] = { [Double] = name##DD, [Int] = name##DI }, \
+        [Int] = { [Double] = name##ID }, \
+    }
+
+/**
+ * \brief A tabela das operações especializadas, indexada pelo operador (pela
+ * ordem de NUMERIC_OPERATORS), pelo tipo do primeiro operando e pelo tipo do
+ * segundo. As entradas vazias são NULL.
+ */
+static const NumericHandler handlers[OPERATOR_COUNT][NUMERIC_TYPES][NUMERIC_TYPES] = {
+    ALL_PAIRS(sum),
+    ALL_PAIRS(subtract),
+    ALL_PAIRS(multiply),
+    ALL_PAIRS(divide),
+    ALL_PAIRS(module),
+    DECIMAL_PAIRS(power),
+    INTEGRAL_PAIRS(and),
+    INTEGRAL_PAIRS(or),
+    INTEGRAL_PAIRS(xor),
+    ALL_PAIRS(equal),
+    ALL_PAIRS(less),
+    ALL_PAIRS(greater),
+};
+
+/**
+ * \brief Devolve a linha da tabela correspondente ao operador
+ * @param op O primeiro caracter do operador
+ * @return   O índice da linha, ou -1 se o operador não tiver operações especializadas
+ */
+static int operatorIndex(char op) {
+    const char* p = op == '\0' ? NULL : strchr(NUMERIC_OPERATORS, op);
+    return p == NULL ? -1 : p - NUMERIC_OPERATORS;
+}
+
+/**
+ * \brief Verifica se o operador tem operações especializadas para algum par de tipos
+ * @param op O primeiro caracter do operador
+ * @return   1 se tiver, 0 caso contrário
+ */
+bool hasNumericHandlers(char op) {
+    return operatorIndex(op) >= 0;
+}
+
+/**
+ * \brief Seleciona a operação especializada para o operador e os tipos dados
+ * @param op O primeiro caracter do operador
+ * @param a  O tipo do primeiro operando (o mais fundo da stack)
+ * @param b  O tipo do segundo operando
+ * @return   A operação, ou NULL se o par for tratado apenas pelo operador genérico
+ */
+NumericHandler findNumericHandler(char op, DataType a, DataType b) {
+    int i = operatorIndex(op);
+
+    if (i < 0 || a >= NUMERIC_TYPES || b >= NUMERIC_TYPES)
+        return NULL;
+    return handlers[i][a][b];
+}
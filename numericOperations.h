@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief contém a declaração das operações numéricas especializadas para cada
+ * par de tipos dos operandos e da tabela que as seleciona
+ */
+
+//! Include guard
+#ifndef NUMERIC_OPERATIONS_H
+//! Include guard
+#define NUMERIC_OPERATIONS_H
+
+#include "stack.h"
+
+//! Número de tipos numéricos (Double, BigInt, Int e Char), que indexam a tabela de operações
+#define NUMERIC_TYPES 4
+
+/**
+ * \brief Uma operação especializada para um par de tipos numéricos: calcula o
+ * resultado sem converter os operandos e devolve 0, sem alterar nenhum valor,
+ * nos casos que deixa para o operador genérico (resultados que não cabem num
+ * long long, divisões por zero)
+ */
+typedef bool (*NumericHandler)(Value a, Value b, Value* r);
+
+bool hasNumericHandlers(char op);
+
+NumericHandler findNumericHandler(char op, DataType a, DataType b);
+
+#endif
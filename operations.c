@@ -8,7 +8,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
+#include <limits.h>
 #include "value.h"
 #include "stack.h"
 #include "operations.h"
@@ -16,23 +16,31 @@
 #include "typeOperations.h"
 #include "arrayOperations.h"
 #include "blockOperations.h"
+#include "setOperations.h"
+#include "logicOperations.h"
+#include "bigInt.h"
+#include "error.h"
 
 //! O comprimento máximo de uma string de input
 #define MAXINPUTLENGTH 1000000
 
 /**
- * \brief Lê uma linha de input
+ * \brief Lê uma linha de input, de qualquer tamanho
  *
  * De notar que a função retorna um apontador alocado dinamicamente que, por isso,
  * deve ser desalocado quando deixar de ser usado.
  *
- * @return A string que contém a linha que foi lida
+ * @return A string que contém a linha que foi lida, ou NULL se o input tiver terminado
  */
 char* getInput ()
 {
-    char *line = malloc(MAXINPUTLENGTH);
-    assert(fgets(line, MAXINPUTLENGTH,stdin) != NULL);
-    long long l = strlen(line);
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t l = getline(&line, &capacity, stdin);
+    if (l <= 0) { //fim do input
+        free(line);
+        return NULL;
+    }
 
     if (line[l - 1] == '\n')
         line[l - 1] = '\0';
@@ -50,7 +58,9 @@ char* getInput ()
  */
 Value decrement(State* s,Value a) {
     //operação não definida para blocos
-    assert(a.type != Block);
+    CHECK_OPERAND(a.type != Block, "operação não definida para blocos", a);
+
+    CHECK_OPERAND(a.type < String || length(a.array) > 0, "a array está vazia", a);
 
     if (a.type >= String) { //Se o tipo do Value for string ou array retira o último elemento da array/string
         Value aux = popBottom(a.array);
@@ -61,7 +71,11 @@ Value decrement(State* s,Value a) {
     switch (a.type) {
         case Double:
             a.decimal = a.decimal - 1; break;
+        case BigInt:
+            return bigArithmetic('-', a, fromInteger(1));
         case Int:
+            if (a.integer == LLONG_MIN)
+                return bigArithmetic('-', a, fromInteger(1));
             a.integer = a.integer - 1; break;
         case Char:
             a.character = a.character - 1; break;
@@ -81,7 +95,9 @@ Value decrement(State* s,Value a) {
  */
 Value increment(State* s,Value a) {
     //operação não definida para blocos
-    assert(a.type != Block);
+    CHECK_OPERAND(a.type != Block, "operação não definida para blocos", a);
+
+    CHECK_OPERAND(a.type < String || length(a.array) > 0, "a array está vazia", a);
 
     if (a.type >= String) {
         Value aux = pop(a.array);
@@ -92,7 +108,11 @@ Value increment(State* s,Value a) {
     switch (a.type) {
         case Double:
             a.decimal = a.decimal + 1; break;
+        case BigInt:
+            return bigArithmetic('+', a, fromInteger(1));
         case Int:
+            if (a.integer == LLONG_MAX)
+                return bigArithmetic('+', a, fromInteger(1));
             a.integer = a.integer + 1; break;
         case Char:
             a.character = a.character + 1; break;
@@ -111,7 +131,7 @@ Value increment(State* s,Value a) {
  */
 void negate(State* s, Value a) {
     //Negação não definida para números fracionários
-    assert(a.type != Double);
+    CHECK_OPERAND(a.type != Double, "operação não definida para doubles", a);
 
     if (a.type == Block) {
         execute(s, s->stack, a);
@@ -123,6 +143,8 @@ void negate(State* s, Value a) {
     else {
         if(a.type == Int) {
             a.integer = ~a.integer;
+        } else if (a.type == BigInt) { //~a = -a - 1
+            a = bigArithmetic('-', fromInteger(-1), a);
         } else {
             a.character = ~a.character;
         }
@@ -144,10 +166,13 @@ void NumericOperationAux(Value *a, Value *b) {
         que se use o menor dos dois tipos (Double é o menor, depois Int, e
         finalmente Char)
     */
-    if(a->type < b->type)
-        NumericOperationAux(b,a);
-    
-    *a = convertToType(b->type, *a);
+    if (a->type == b->type) //não há nada a converter
+        return;
+
+    Value* larger = a->type > b->type ? a : b; //o valor do maior tipo é convertido
+    Value converted = convertToType(a->type > b->type ? b->type : a->type, *larger);
+    disposeValue(*larger); //só os inteiros grandes ocupam memória
+    *larger = converted;
 }
 
 
@@ -160,12 +185,12 @@ void NumericOperationAux(Value *a, Value *b) {
  */
 Value sum(Value a, Value b) {
     //operação não definida para blocos
-    assert(a.type != Block && b.type != Block);
+    CHECK_OPERANDS(a.type != Block && b.type != Block, "operação não definida para blocos", a, b);
 
     if (a.type >= String || b.type >= String) {//Se um dos dois elementos for uma string ou array 
         a = convertToStack(a);
         b = convertToStack(b);
-        Value ans = fromStack(merge(a.array,b.array));
+        Value ans = fromStack(concatenate(a.array, b.array));
         ans.type = a.type > b.type ? a.type : b.type; //o maior dos dois tipos
         return ans;
     }
@@ -173,11 +198,16 @@ Value sum(Value a, Value b) {
     //Converte os valores para o mesmo tipo
     NumericOperationAux(&a, &b);
     
+    long long r;
     switch (a.type) {
         case Double:
             a.decimal += b.decimal; break;
+        case BigInt:
+            return bigArithmetic('+', a, b);
         case Int:
-            a.integer += b.integer; break;
+            if (__builtin_add_overflow(a.integer, b.integer, &r))
+                return bigArithmetic('+', a, b);
+            a.integer = r; break;
         case Char:
             a.character += b.character; break;
         default:
@@ -188,22 +218,31 @@ Value sum(Value a, Value b) {
 
 
 /**
- * \brief Subtrai dois elementos do tipo #Value.
+ * \brief Subtrai dois elementos do tipo #Value. Se um deles for uma string ou array, retira de a os elementos que existem em b.
  *
  * @param a  o elemento do tipo #Value.
  * @param b  o elemento do tipo #Value.
  * @return     resultado da subtração de a com b.
  */
 Value subtract(Value a, Value b) {
+    //Se um dos elementos for uma string ou array, faz a diferença de conjuntos
+    if (a.type >= String || b.type >= String)
+        return setDifference(a, b);
+
     //operação só definida para valores numéricos
-    assert(a.type < String && b.type < String);
+    CHECK_OPERANDS(a.type < String && b.type < String, "operandos de tipos incompatíveis", a, b);
 
     NumericOperationAux(&a,&b);
+    long long r;
     switch (a.type) {
         case Double:
             a.decimal -= b.decimal; break;
+        case BigInt:
+            return bigArithmetic('-', a, b);
         case Int:
-            a.integer -= b.integer; break;
+            if (__builtin_sub_overflow(a.integer, b.integer, &r))
+                return bigArithmetic('-', a, b);
+            a.integer = r; break;
         case Char:
             a.character -= b.character; break;
         default:
@@ -220,24 +259,28 @@ Value subtract(Value a, Value b) {
  */
 Value divide(Value a, Value b) {
     //operação não definida para blocos
-    assert(a.type != Block && b.type != Block);
+    CHECK_OPERANDS(a.type != Block && b.type != Block, "operação não definida para blocos", a, b);
 
     //Se estivermos a tratar de strings, faz a operação correspondente
     if(a.type >= String) {
-        assert(b.type >= String); //ambos os operandos são strings ou arrays
+        CHECK_OPERANDS(b.type >= String, "operandos de tipos incompatíveis", a, b); //ambos os operandos são strings ou arrays
         return separateBySubstr(a,b);
     }
 
 
     //Converte os valores para o mesmo tipo
     NumericOperationAux(&a, &b);
-    assert(!isTrue(isEqual(fromInteger(0), b))); //descartar divisão por zero
+    CHECK_OPERANDS(isTrue(b), "divisão por zero", a, b);
 
     switch (a.type) {
         case Double:
             a.decimal /= b.decimal;
             break;
+        case BigInt:
+            return bigArithmetic('/', a, b);
         case Int:
+            if (a.integer == LLONG_MIN && b.integer == -1) //o resultado não cabe num long long
+                return bigArithmetic('/', a, b);
             a.integer /= b.integer;
             break;
         case Char:
@@ -257,27 +300,37 @@ Value divide(Value a, Value b) {
  */
 Value multiply(State* s, Value a, Value b) {
     if (b.type == Block) {
-        assert(a.type == Array || a.type == String); //a é um array ou string
+        CHECK_OPERANDS(a.type == Array || a.type == String, "o operando tem de ser uma string ou uma array", a, b);
         fold(s, a.array, b);
         disposeValue(b);
         return a;
-    } else if (a.type >= String) {
-        assert(b.type == Int); //b é um inteiro
+    }
+
+    //operação não definida para blocos
+    CHECK_OPERANDS(a.type != Block, "operação não definida para blocos", a, b);
+
+    if (a.type == String || a.type == Array) {
+        CHECK_OPERANDS(b.type == Int, "o número de repetições tem de ser um inteiro", a, b);
         a.array = repeat(a.array, b.integer);
         return a;
     }
 
-    assert(a.type < String && b.type < String); //a e b são numéricos
+    CHECK_OPERANDS(a.type < String && b.type < String, "operandos de tipos incompatíveis", a, b); //a e b são numéricos
 
     //Converte os valores para o mesmo tipo
     NumericOperationAux(&a, &b);
 
+    long long r;
     switch (a.type) {
         case Double:
             a.decimal *= b.decimal;
             break;
+        case BigInt:
+            return bigArithmetic('*', a, b);
         case Int:
-            a.integer *= b.integer;
+            if (__builtin_mul_overflow(a.integer, b.integer, &r))
+                return bigArithmetic('*', a, b);
+            a.integer = r;
             break;
         case Char:
             a.character *= b.character;
@@ -288,15 +341,19 @@ Value multiply(State* s, Value a, Value b) {
     return a;
 }
 /**
- * \brief Aplica a conjunção a dois elementos do tipo #Value.
+ * \brief Aplica a conjunção a dois elementos do tipo #Value. Se um deles for uma string ou array, calcula a interseção.
  *
  * @param a  o elemento do tipo #Value.
  * @param b  o elemento do tipo #Value.
  * @return     o elemento do tipo #Value resultante de aplicar a conjunção.
  */
 Value and(Value a, Value b) {
+    //Se um dos elementos for uma string ou array, faz a operação de conjuntos
+    if (a.type >= String || b.type >= String)
+        return setIntersection(a, b);
+
     //operação definida apenas para inteiros e caracteres
-    assert((a.type == Int && b.type == Int) || (a.type == Char && b.type == Char));
+    CHECK_OPERANDS((a.type == Int && b.type == Int) || (a.type == Char && b.type == Char), "operação definida apenas para inteiros e caracteres", a, b);
 
     //Converte os valores para o mesmo tipo
     NumericOperationAux(&a, &b);
@@ -310,15 +367,19 @@ Value and(Value a, Value b) {
     return a;
 }
 /**
- * \brief Aplica a disjunção a dois elementos de tipo #Value.
+ * \brief Aplica a disjunção a dois elementos de tipo #Value. Se um deles for uma string ou array, calcula a união.
  *
  * @param a  o elemento do tipo #Value.
  * @param b  o elemento do tipo #Value.
  * @return   o elemento do tipo #Value resultante de aplicar a disjunção.
  */
 Value or(Value a, Value b) {
+    //Se um dos elementos for uma string ou array, faz a operação de conjuntos
+    if (a.type >= String || b.type >= String)
+        return setUnion(a, b);
+
     //operação definida apenas para inteiros e caracteres
-    assert((a.type == Int && b.type == Int) || (a.type == Char && b.type == Char));
+    CHECK_OPERANDS((a.type == Int && b.type == Int) || (a.type == Char && b.type == Char), "operação definida apenas para inteiros e caracteres", a, b);
     
     if(a.type == Int) {
         a.integer |= b.integer;
@@ -329,15 +390,19 @@ Value or(Value a, Value b) {
     return a;
 }
 /**
- * \brief Aplica o ou explosivo a dois elementos do tipo #Value.
+ * \brief Aplica o ou explosivo a dois elementos do tipo #Value. Se um deles for uma string ou array, calcula a diferença simétrica.
  *
  * @param a  o elemento do tipo #Value.
  * @param b  o elemento do tipo #Value.
  * @return   o elemento do tipo #Value resultante de aplicar o ou explosivo.
  */
 Value xor(Value a, Value b) {
+    //Se um dos elementos for uma string ou array, faz a operação de conjuntos
+    if (a.type >= String || b.type >= String)
+        return setSymmetricDifference(a, b);
+
     //operação definida apenas para inteiros e caracteres
-    assert((a.type == Int && b.type == Int) || (a.type == Char && b.type == Char));
+    CHECK_OPERANDS((a.type == Int && b.type == Int) || (a.type == Char && b.type == Char), "operação definida apenas para inteiros e caracteres", a, b);
     
     //Converte os valores para o mesmo tipo
     NumericOperationAux(&a, &b);
@@ -361,21 +426,25 @@ Value xor(Value a, Value b) {
 Value module(State* s, Value a, Value b) {
     //Se for um bloco faz um map
     if (b.type == Block) {
-        assert(a.type == Array || a.type == String);
+        CHECK_OPERANDS(a.type == Array || a.type == String, "o operando tem de ser uma string ou uma array", a, b);
         map(s, a.array, b);
         disposeValue(b);
     } else {
         //a e b são valores numéricos
-        assert(a.type < String && b.type < String);
+        CHECK_OPERANDS(a.type < String && b.type < String, "operandos de tipos incompatíveis", a, b);
 
         //Converte os valores para o mesmo tipo
         NumericOperationAux(&a, &b);
+        CHECK_OPERANDS(a.type == Double || isTrue(b), "divisão por zero", a, b);
 
         switch(a.type) {
             case Double:
                 a.decimal = fmod(a.decimal, b.decimal); break;
+            case BigInt:
+                return bigArithmetic('%', a, b);
             case Int:
-                a.integer %= b.integer; break;
+                //LLONG_MIN % -1 excede um long long no cálculo intermédio
+                a.integer = b.integer == -1 ? 0 : a.integer % b.integer; break;
             case Char:
                 a.character %= b.character; break;
             default:    break;
@@ -385,6 +454,27 @@ Value module(State* s, Value a, Value b) {
     return a;
 }
 
+/**
+ * \brief Calcula a potência de dois inteiros por quadrados sucessivos, de forma
+ * exata. Só passa para inteiros grandes se o resultado não couber num long long.
+ *
+ * @param a  a base (Int)
+ * @param b  o expoente (Int, não negativo)
+ * @return   a potência de a com b
+ */
+static Value integerPower(Value a, Value b) {
+    long long result = 1, base = a.integer, e = b.integer;
+
+    while (e > 0) {
+        if ((e & 1) && __builtin_mul_overflow(result, base, &result))
+            return bigArithmetic('#', a, b);
+        e >>= 1;
+        if (e > 0 && __builtin_mul_overflow(base, base, &base))
+            return bigArithmetic('#', a, b);
+    }
+    return fromInteger(result);
+}
+
 /**
  * \brief Calcula a potencia entre dois elementos do tipo #Value. Se o tipo do #Value a for um array ou string devolve o índice onde se encontra a sub-string. 
  *
@@ -393,22 +483,29 @@ Value module(State* s, Value a, Value b) {
  * @return   a potencia de a com b.
  */
 Value exponentiate(Value a, Value b) {
-    assert(a.type != Block && b.type != Block);
+    CHECK_OPERANDS(a.type != Block && b.type != Block, "operação não definida para blocos", a, b);
 
     //Se estivermos a tratar de strings, faz a operação correspondente
     if (a.type >= Char && b.type >= Char)
         return substrAndDispose(a,b);
 
     //a e b são valores numéricos
-    assert(a.type < String && b.type < String);
+    CHECK_OPERANDS(a.type < String && b.type < String, "operandos de tipos incompatíveis", a, b);
 
     NumericOperationAux(&a, &b);
 
     switch(a.type) {
         case Double:
             a.decimal = pow(a.decimal, b.decimal); break;
+        case BigInt:
         case Int:
-            a.integer = (long long)pow(a.integer, b.integer); break;
+            if (lessThan(b, fromInteger(0))) { //resultado fracionário, truncado
+                Value d = fromDecimal(pow(convertToDouble(a).decimal, convertToDouble(b).decimal));
+                disposeValue(a);
+                disposeValue(b);
+                return convertToInt(d);
+            }
+            return a.type == Int ? integerPower(a, b) : bigArithmetic('#', a, b);
         case Char:
             a.character = (char)pow(a.character, b.character); break;
         default:    break;
@@ -420,11 +517,18 @@ Value exponentiate(Value a, Value b) {
 /**
  * \brief    Lê todas as linhas restantes do input e insere-as na stack.
  *           
- *           Concatena todas as linhas numa só string.
+ *           Concatena todas as linhas numa só string. O input é o texto dado
+ *           ao estado ou, se não houver nenhum, o stdin.
  * 
- * @param st A stack fornecida
+ * @param s  O estado do programa
  */
-void readAllLines(Stack st) {
+void readAllLines(State* s) {
+    if (s->input != NULL) {
+        push(s->stack, fromText(s->input, s->inputEnd - s->input));
+        s->input = s->inputEnd;
+        return;
+    }
+
     //Alocar dinamicamente a string de resultado e a
     //string que guarda o valor de cada linha individualmente
     char* str = malloc(sizeof(char) * MAXINPUTLENGTH);
@@ -439,7 +543,7 @@ void readAllLines(Stack st) {
 
     //Liberta a string que guarda a linha atual, por não ser mais precisa
     free(curLine);
-    push(st, fromString(str));
+    push(s->stack, fromString(str));
     free(str);
 }
 
@@ -452,10 +556,12 @@ void readAllLines(Stack st) {
  */
 Value splitByWhitespace(Value v) {
     Value copy = deepCopy(v);
+    materialize(copy.array); //os caracteres vão ser alterados
     for(long long i = 0; i < length(v.array); i++) {
-        if(v.array->values[i].character == '\n')
-            copy.array->values[i].character = ' ';
+        if(valueAt(v.array, i).character == '\n')
+            setValueAt(copy.array, i, fromCharacter(' '));
     }
+    copy.array->hash = 0;
     return separateBySubstr(copy, convertToString(fromCharacter(' ')));
 }
 
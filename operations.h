@@ -32,7 +32,7 @@ Value xor(Value a, Value b);
 Value module(State* s, Value a, Value b);
 Value exponentiate(Value a, Value b);
 
-void readAllLines(Stack st);
+void readAllLines(State* s);
 Value splitByWhitespace(Value v);
 Value splitByLinebreak(Value v);
 #endif
\ No newline at end of file
@@ -0,0 +1,421 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que otimizam programas compilados
+ *
+ * A otimização é feita numa só passagem sobre as instruções:
+ *  - operações puras cujos operandos são todos constantes são avaliadas
+ *    durante a compilação (por exemplo `2 3 #`, `10 ,` ou `"a" "b" +`);
+ *  - sequências sem efeito (`_ ;`, `\ \`, `@ @ @`) são removidas;
+ *  - arrays cujo conteúdo é constante são construídas uma única vez, passando a
+ *    ser copiadas em vez de reconstruídas sempre que o bloco é executado.
+ *
+ * No fim, as sequências frequentes de instruções são substituídas por
+ * superinstruções (ver fusion.c).
+ *
+ * Cada substituição é verificada executando as instruções originais e as novas
+ * sobre a mesma stack de teste; a substituição só é feita se as stacks
+ * resultantes forem idênticas e se nenhuma das execuções falhar.
+ */
+
+#include <string.h>
+#include "optimizer.h"
+#include "parser.h"
+#include "bigInt.h"
+#include "error.h"
+#include "fusion.h"
+#include "profile.h"
+#include "analysis.h"
+
+//! Número de valores colocados na stack de teste antes de executar as instruções
+#define PROBE_SIZE 3
+
+/**
+ * \brief Verifica se o valor é numérico
+ * @param v O valor
+ * @return  1 se for Double, BigInt, Int ou Char, 0 caso contrário
+ */
+static bool isNumeric(Value v) {
+    return v.type < String;
+}
+
+/**
+ * \brief Verifica se o valor é uma array ou uma string
+ * @param v O valor
+ * @return  1 se for Array ou String, 0 caso contrário
+ */
+static bool isCollection(Value v) {
+    return v.type == String || v.type == Array;
+}
+
+/**
+ * \brief Verifica se dois valores podem ser comparados com `<` e `>`
+ * @param a O primeiro valor
+ * @param b O segundo valor
+ * @return  1 se ambos forem numéricos ou ambos strings
+ */
+static bool comparable(Value a, Value b) {
+    return (isNumeric(a) && isNumeric(b)) || (a.type == String && b.type == String);
+}
+
+/**
+ * \brief Devolve o número de operandos de um operador que pode ser avaliado
+ * durante a compilação, ou -1 se o operador tiver efeitos laterais
+ * (ler o input, escrever, aceder a variáveis ou a elementos abaixo dos operandos).
+ * @param op A instrução do operador
+ * @return   O número de operandos
+ */
+static int foldArity(Instruction* op) {
+    switch (op->word[0]) {
+        case '_': case ';': case '!': case '(': case ')': case '~': case ',':
+        case 'f': case 'i': case 'c': case 's': case 'S': case 'N':
+            return 1;
+        case '\\': case '+': case '-': case '*': case '/': case '%': case '#':
+        case '&': case '|': case '^': case '=': case '<': case '>': case 'e':
+            return 2;
+        case '@': case '?':
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+/**
+ * \brief Verifica se o operador pode ser avaliado com os operandos dados sem
+ * executar blocos nem falhar
+ * @param op A instrução do operador
+ * @param v  Os operandos (v[0] é o mais fundo da stack)
+ * @return   1 se puder ser avaliado, 0 caso contrário
+ */
+static bool canFold(Instruction* op, Value* v) {
+    Value a = v[0], b = v[1];
+
+    switch (op->word[0]) {
+        case '_': case ';': case '\\': case '@': case '?': case '!': case 's':
+            return true;
+        case 'e':
+            return (op->word[1] != '<' && op->word[1] != '>') || comparable(a, b);
+        case '(': case ')':
+            return isNumeric(a) || (isCollection(a) && length(a.array) > 0);
+        case '~':
+            return a.type == Int || a.type == BigInt || a.type == Char || isCollection(a);
+        case ',':
+            if (a.type == Int)      return a.integer <= FOLD_LIMIT;
+            if (a.type == Double)   return a.decimal <= FOLD_LIMIT;
+            return a.type == Char || isCollection(a);
+        case 'f': case 'i': case 'c':
+            return isNumeric(a) || a.type == String;
+        case 'S': case 'N':
+            return a.type == String;
+        case '+':
+            return a.type != Block && b.type != Block;
+        case '-':
+            return (isNumeric(a) && isNumeric(b)) || (isCollection(a) && isCollection(b));
+        case '*':
+            if (isNumeric(a) && isNumeric(b))
+                return true;
+            return isCollection(a) && b.type == Int && b.integer <= FOLD_LIMIT
+                && length(a.array) * b.integer <= FOLD_LIMIT;
+        case '/':
+            if (isNumeric(a) && isNumeric(b))
+                return isTrue(b); //o divisor não pode ser zero
+            return a.type == String && b.type == String;
+        case '%':
+            return isNumeric(a) && isNumeric(b) && isTrue(b);
+        case '#':
+            if (isNumeric(a) && isNumeric(b))
+                return true;
+            return (a.type == String || a.type == Char) && (b.type == String || b.type == Char);
+        case '&': case '|': case '^':
+            if (isCollection(a) && isCollection(b))
+                return true;
+            return (a.type == Int && b.type == Int) || (a.type == Char && b.type == Char);
+        case '=':
+            if (isCollection(a) && b.type == Int)
+                return b.integer >= 0 && b.integer < length(a.array);
+            return comparable(a, b);
+        case '<': case '>':
+            if (isCollection(a) && b.type == Int)
+                return b.integer >= 0 && b.integer <= length(a.array);
+            return comparable(a, b);
+        default:
+            return false;
+    }
+}
+
+static bool sameStack(Stack a, Stack b);
+
+/**
+ * \brief Verifica se dois valores são idênticos (mesmo tipo e mesmo conteúdo)
+ * @param a O primeiro valor
+ * @param b O segundo valor
+ * @return  1 se forem idênticos, 0 caso contrário
+ */
+static bool sameValue(Value a, Value b) {
+    if (a.type != b.type)
+        return false;
+
+    switch (a.type) {
+        case Double:    return memcmp(&a.decimal, &b.decimal, sizeof(double)) == 0;
+        case BigInt:    return compareBig(a, b) == 0;
+        case Int:       return a.integer == b.integer;
+        case Char:      return a.character == b.character;
+        case Block:     return a.block == b.block; //cada texto tem um único bloco
+        default:        return sameStack(a.array, b.array);
+    }
+}
+
+/**
+ * \brief Verifica se duas stacks são idênticas, elemento a elemento
+ * @param a A primeira stack
+ * @param b A segunda stack
+ * @return  1 se forem idênticas, 0 caso contrário
+ */
+static bool sameStack(Stack a, Stack b) {
+    if (length(a) != length(b))
+        return false;
+
+    flatten(a);
+    flatten(b);
+    for (long long i = 0; i < length(a); i++)
+        if (!sameValue(valueAt(a, i), valueAt(b, i)))
+            return false;
+
+    return true;
+}
+
+/**
+ * \brief Executa instruções sobre uma stack de teste
+ * @param code    As instruções
+ * @param n       O número de instruções
+ * @param sandbox O estado usado para executar as instruções
+ * @return        A stack resultante (inclui os PROBE_SIZE valores de teste no
+ *                fundo), ou NULL se a execução falhar
+ */
+static Stack evaluate(Instruction* code, long long n, State* sandbox) {
+    sandbox->stack = empty();
+
+    for (int i = 1; i <= PROBE_SIZE; i++)
+        push(sandbox->stack, fromInteger(i));
+
+    Evaluation ev;
+    beginEvaluation(&ev, sandbox);
+    if (setjmp(ev.boundary) != 0) { //as instruções falham, pelo que não são avaliadas
+        disposeStack(sandbox->stack);
+        return NULL;
+    }
+
+    for (long long i = 0; i < n; i++)
+        runInstruction(&code[i], sandbox);
+
+    endEvaluation(&ev);
+    return sandbox->stack;
+}
+
+/**
+ * \brief Substitui as últimas instruções do programa pelas instruções dadas, se
+ * produzirem a mesma stack.
+ *
+ * As instruções substituídas são libertadas. Se a substituição não for feita,
+ * as instruções novas são libertadas e o programa não é alterado.
+ *
+ * @param out         O programa
+ * @param n           O número de instruções a substituir
+ * @param replacement As instruções novas
+ * @param sandbox     O estado usado para verificar a substituição
+ * @return            1 se a substituição foi feita, 0 caso contrário
+ */
+static bool rewrite(Program out, long long n, Program replacement, State* sandbox) {
+    Stack before = evaluate(out->code + out->size - n, n, sandbox);
+    Stack after = evaluate(replacement->code, replacement->size, sandbox);
+    bool same = before != NULL && after != NULL && sameStack(before, after);
+    if (before != NULL)
+        disposeStack(before);
+    if (after != NULL)
+        disposeStack(after);
+
+    if (!same) {
+        disposeProgram(replacement);
+        return false;
+    }
+
+    while (n--)
+        disposeInstruction(out->code[--out->size]);
+
+    for (long long i = 0; i < replacement->size; i++)
+        addInstruction(out, replacement->code[i]);
+
+    replacement->size = 0; //as instruções passaram a pertencer a out
+    disposeProgram(replacement);
+    return true;
+}
+
+/**
+ * \brief Avalia as últimas instruções do programa, substituindo-as pelos valores
+ * que produzem
+ * @param out     O programa
+ * @param n       O número de instruções a avaliar
+ * @param sandbox O estado usado para avaliar as instruções
+ * @return        1 se as instruções foram substituídas, 0 caso contrário
+ */
+static bool foldConstants(Program out, long long n, State* sandbox) {
+    Stack result = evaluate(out->code + out->size - n, n, sandbox);
+    if (result == NULL)
+        return false;
+
+    Program replacement = newProgram();
+    bool small = true;
+
+    for (long long i = PROBE_SIZE; i < length(result); i++) {
+        Value v = takeValue(result->values[i]);
+        addInstruction(replacement, fromValue(v));
+
+        if (isCollection(v) && length(v.array) > FOLD_LIMIT)
+            small = false;
+    }
+
+    result->size = PROBE_SIZE; //os valores passaram a pertencer a replacement
+    disposeStack(result);
+
+    if (!small) {
+        disposeProgram(replacement);
+        return false;
+    }
+    return rewrite(out, n, replacement, sandbox);
+}
+
+/**
+ * \brief Conta as instruções PushValue consecutivas que terminam antes da posição dada
+ * @param p   O programa
+ * @param end A posição
+ * @return    O número de instruções
+ */
+static long long constantsBefore(Program p, long long end) {
+    long long n = 0;
+
+    while (n < end && p->code[end - 1 - n].type == PushValue)
+        n++;
+
+    return n;
+}
+
+/**
+ * \brief Verifica se as últimas instruções do programa são os operadores dados
+ * @param p   O programa
+ * @param ops Os operadores (um carácter por instrução)
+ * @return    1 se coincidirem, 0 caso contrário
+ */
+static bool endsWith(Program p, const char* ops) {
+    long long n = strlen(ops);
+
+    if (p->size < n)
+        return false;
+
+    for (long long i = 0; i < n; i++) {
+        Instruction* ins = &p->code[p->size - n + i];
+        if (ins->type != Operation || ins->word[0] != ops[i])
+            return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Verifica se a stack tem pelo menos n valores antes das últimas
+ * instruções do programa, qualquer que seja a stack inicial (se as instruções
+ * anteriores não falharem)
+ * @param p   O programa
+ * @param end O número de instruções anteriores
+ * @param n   O número de valores
+ * @return    1 se a análise do efeito o garantir, 0 caso contrário
+ */
+static bool hasDepth(Program p, long long end, long long n) {
+    struct program prefix = *p;
+    prefix.size = end;
+
+    StackEffect e = analyzeProgram(&prefix, ANY_TYPE);
+    return e.bounded && e.inputs + e.minDelta >= n;
+}
+
+/**
+ * \brief Tenta simplificar o fim do programa depois de lhe ser acrescentado um operador
+ * @param out     O programa
+ * @param sandbox O estado usado para verificar as substituições
+ */
+static void simplify(Program out, State* sandbox) {
+    Instruction* op = &out->code[out->size - 1];
+    int arity = foldArity(op);
+
+    //Avaliação de operações sobre constantes
+    if (arity >= 0 && constantsBefore(out, out->size - 1) >= arity) {
+        Value operands[3];
+        for (int i = 0; i < arity; i++)
+            operands[i] = out->code[out->size - 1 - arity + i].value;
+
+        if (canFold(op, operands) && foldConstants(out, arity + 1, sandbox))
+            return;
+    }
+
+    //Remoção de sequências sem efeito, se a stack tiver os valores de que precisam
+    //(caso contrário falham, e a remoção esconderia o erro)
+    if (endsWith(out, "_;") && hasDepth(out, out->size - 2, 1))
+        rewrite(out, 2, newProgram(), sandbox);
+    else if (endsWith(out, "\\\\") && hasDepth(out, out->size - 2, 2))
+        rewrite(out, 2, newProgram(), sandbox);
+    else if (endsWith(out, "@@@") && hasDepth(out, out->size - 3, 3))
+        rewrite(out, 3, newProgram(), sandbox);
+}
+
+/**
+ * \brief Verifica se um programa é composto apenas por instruções PushValue
+ * @param p O programa
+ * @return  1 se for, 0 caso contrário
+ */
+static bool isConstant(Program p) {
+    return constantsBefore(p, p->size) == p->size;
+}
+
+/**
+ * \brief Otimiza o programa dado, alterando-o.
+ * @param p O programa
+ */
+void optimizeProgram(Program p) {
+    State sandbox;
+    Program out = newProgram();
+    initializeState(&sandbox, NULL); //os operadores avaliados não compilam blocos
+    disposeStack(sandbox.stack); //cada avaliação usa uma stack nova
+
+    for (long long i = 0; i < p->size; i++) {
+        addInstruction(out, p->code[i]);
+
+        switch (p->code[i].type) {
+            case PushArray:
+                optimizeProgram(p->code[i].array);
+                //arrays constantes são construídas uma única vez
+                if (isConstant(p->code[i].array))
+                    foldConstants(out, 1, &sandbox);
+                break;
+
+            case Operation:
+                simplify(out, &sandbox);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    disposeVariables(&sandbox);
+
+    //As instruções passaram a pertencer a out, que substitui o conteúdo de p
+    struct program aux = *p;
+    *p = *out;
+    *out = aux;
+    out->size = 0;
+    disposeProgram(out);
+
+    //as sequências frequentes passam a ser executadas como superinstruções
+    if (!profiling)
+        fuseProgram(p);
+
+    //o efeito sobre a stack permite executar o programa sem verificar os operandos
+    p->effect = analyzeProgram(p, ANY_TYPE);
+}
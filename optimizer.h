@@ -0,0 +1,18 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que otimizam programas compilados
+ */
+
+//! Include guard
+#ifndef OPTIMIZER_H
+//! Include guard
+#define OPTIMIZER_H
+
+#include "program.h"
+
+//! Tamanho máximo das arrays e strings produzidas pela avaliação de constantes
+#define FOLD_LIMIT 1024
+
+void optimizeProgram(Program p);
+
+#endif
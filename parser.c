@@ -11,6 +11,8 @@
 #include <math.h>
 #include <string.h>
 #include "parser.h"
+#include "optimizer.h"
+#include "lexer.h"
 
 /**
  * \brief Verifica se o caracter especificado existe na string no tamanho indicado
@@ -29,18 +31,28 @@ bool contains(char* str, long long length, char c) {
 }
 
 /**
- * \brief Lê um input e retorna um value com o valor do input
+ * \brief Lê um input que não é um número nem um operador e retorna a instrução
+ * que empurra o valor do input
  * @param str input dado
- * @param st o state do programa
- * @return value que foi dado no input
+ * @param length o tamanho do input
+ * @return instrução que empurra a variável dada ou, se o input não for uma
+ *         variável, o valor 0
  */
-Value readValue(char* str, long long length, State* st) {
-    if ('A' <= *str && *str <= 'Z') //variável
-        return deepCopy(st->variables[*str-'A']);
+Instruction readValue(char* str, long long length) {
+    Instruction ins;
+
+    if ('A' <= *str && *str <= 'Z') { //variável
+        ins.type = PushVariable;
+        ins.variable = *str - 'A';
+        return ins;
+    }
+
+    ins.type = PushValue;
     if (contains(str, length, '.')) //double (contém um separador decimal)
-        return fromDecimal(atof(str));
+        ins.value = fromDecimal(0);
     else
-        return fromInteger(atoi(str)); //inteiro
+        ins.value = fromInteger(0); //inteiro
+    return ins;
 }
 
 /**
@@ -54,6 +66,39 @@ bool operation(char* str, long long length, State* st) {
     return false;
 }
 
+/**
+ * \brief Executa um operador sem verificar se a stack tem os operandos que o
+ * operador retira. Só pode ser usado quando a análise do programa o garante
+ * (ver analysis.c).
+ * @param str    O operador
+ * @param length O tamanho da palavra
+ * @param st     O estado do programa
+ * @return Um inteiro que simboliza o valor lógico (1 caso seja verdadeiro ou 0 caso seja falso)
+ */
+bool uncheckedOperation(char* str, long long length, State* st) {
+#undef ENTRY
+#define ENTRY ENTRY_UNCHECKED
+    switch (*str) { JUMP_TABLE }
+#undef ENTRY
+#define ENTRY ENTRY_CALL
+    return false;
+}
+
+/**
+ * \brief Verifica se a palavra dada corresponde a um operador, sem o executar.
+ * @param str    A palavra
+ * @param length O tamanho da palavra
+ * @return Um inteiro que simboliza o valor lógico (1 caso seja verdadeiro ou 0 caso seja falso)
+ */
+bool isOperation(char* str, long long length) {
+#undef ENTRY
+#define ENTRY ENTRY_CHECK
+    switch (*str) { JUMP_TABLE }
+#undef ENTRY
+#define ENTRY ENTRY_CALL
+    return false;
+}
+
 /**
  * \brief Converte um caracter escapado para o respetivo caracter de controlo
  * @param c Caracter dado
@@ -73,17 +118,35 @@ char getControlChar(char c) {
     }
 }
 
+/**
+ * \brief Devolve o delimitador do índice que abre na posição dada, avançando o
+ * cursor do parser até ele
+ * @param p   O parser
+ * @param pos A posição do delimitador
+ * @return    O delimitador
+ */
+static Delimiter* findDelimiter(Parser* p, char* pos) {
+    long long open = pos - p->index->source;
+
+    while (p->index->delimiters[p->next].open < open)
+        p->next++;
+
+    return &p->index->delimiters[p->next];
+}
+
 /**
  * \brief converte uma string para uma Stack de caracteres
- * @param str String dada
+ * @param p   O parser
+ * @param str String dada; fica a apontar para a aspa que fecha
  * @return Stack de caracteres
  */
-Value readString(char** str) {
-    //mete *str a apontar para a aspa que fecha
+Value readString(Parser* p, char** str) {
+    Delimiter* d = findDelimiter(p, *str);
+    char* end = p->index->source + d->close;
     Stack read = empty();
     bool escape = false;
 
-    for ((*str)++; escape || **str != '"'; (*str)++) {
+    for ((*str)++; *str < end; (*str)++) {
         if (escape) {
             push(read, fromCharacter(getControlChar(**str)));
             escape = false;
@@ -92,103 +155,211 @@ Value readString(char** str) {
         else
             push(read, fromCharacter(**str));
     }
-    
+    p->next = d->after;
+
     Value r = fromStack(read);
     r.type = String;
     return r;
 }
 
 /**
- * \brief converte uma string para uma array, retornada sob a forma de um Value
+ * \brief Compila o conteúdo de uma array, deixando a string a apontar para o ']'
  *
- * @param s     O estado atual
+ * @param p     O parser
  * @param str   A string
+ * @return      O programa que, executado numa stack vazia, constrói a array
  */
-Value readArray(State* s, char** str) {
+Program readArray(Parser* p, char** str) {
+    p->next = findDelimiter(p, *str) - p->index->delimiters + 1;
     (*str)++;
-    Stack current = s->stack; //guarda a stack atual
-    s->stack = empty();
-    processInput(str, s); //chama processInput recursivamente com uma stack vazia
-    Value r = fromStack(s->stack);
-    s->stack = current; //recupera a stack
-    return r;
+    return compileCode(p, str); //chama compileCode recursivamente
 }
 
 /**
- * \brief Avança o pointer dado até ao fim do bloco
+ * \brief Lê o bloco que começa na posição dada, saltando diretamente para o seu
+ * fim. O bloco é compilado a partir do mesmo índice, ficando o programa
+ * guardado para quando for executado.
  *
- * @param str Pointer dado
+ * @param p   O parser
+ * @param str Pointer dado; fica a apontar para o delimitador que fecha o bloco
+ * @return    O bloco
  */
-void readBlock(char** str) {
-    for ((*str)++; **str != '}' && **str != ']'; (*str)++) {
-        switch (**str) {
-            case '"':
-            //dispose do valor lido (só queremos mudar a posição de *str) TODO: otimizar
-            disposeValue(readString(str));
-            break;
+Value readBlock(Parser* p, char** str) {
+    Delimiter* d = findDelimiter(p, *str);
+    char* start = *str + 1;
+    BlockCode block = internBlock(p->blocks, start, d->close - d->open - 1);
 
-            case '[':
-            case '{':
-            //chamada recursiva em vez de contar os parênteses e as chavetas
-            readBlock(str);
-            break;
-        }
+    if (block->program == NULL) {
+        Parser inner = { p->index, p->index->source + d->close, d - p->index->delimiters + 1, p->blocks };
+        char* aux = start;
+        Program code = compileCode(&inner, &aux);
+        optimizeProgram(code);
+        block->program = code;
     }
+
+    *str = p->index->source + d->close;
+    p->next = d->after;
+    return fromBlock(block);
 }
 
 /**
- * \brief Processa a palavra fornecida, preenchendo a stack dada ou efetuando a operação descrita.
+ * \brief Acrescenta uma instrução ao fim do programa, registando a sua posição
+ * no texto compilado
+ * @param p        O programa
+ * @param ins      A instrução
+ * @param position A posição da instrução no texto
+ */
+static void addAt(Program p, Instruction ins, long long position) {
+    ins.position = position;
+    addInstruction(p, ins);
+}
+
+/**
+ * \brief Compila a palavra fornecida, acrescentando ao programa a instrução que
+ * empurra o seu valor ou que efetua a operação descrita.
  * 
  * @param str       A string correspondente à palavra
  * @param length    O tamanho da palavra
- * @param st        O state a preencherstr
+ * @param position  A posição da palavra no texto compilado
+ * @param p         O programa a preencher
  */
-void resolveWord(char* str, long long length, State* st)
+void resolveWord(char* str, long long length, long long position, Program p)
 {
     if (length <= 0)
         return;
-    
-    if(atof(str) != 0 || !operation(str, length, st))
-        push(st->stack, readValue(str, length, st));
+
+    Value number;
+    char* end = str;
+
+    if (readNumber(&end, &number))
+        addAt(p, fromValue(number), position);
+    else if (isOperation(str, length))
+        addAt(p, fromOperation(str, length), position);
+    else
+        addAt(p, readValue(str, length), position);
 }
 
 /**
- * \brief Processa a string fornecida, e preenche a stack dada, efetuando todas as operações descritas na string.
+ * \brief Compila o texto indexado pelo parser a partir da posição dada,
+ * produzindo o programa com todas as operações descritas.
  * 
- * @param str   A string correspondente ao input
- * @param st    O state a preencher
+ * @param p     O parser
+ * @param str   A posição inicial. Fica a apontar para o fim do programa.
+ * @return      O programa compilado
  */
-void processInput(char** str, State* st) {
-    char *aux, *accum = *str;
-    while(**str && **str != '\n' && **str != ']') {
+Program compileCode(Parser* p, char** str) {
+    Program code = newProgram();
+    Instruction ins;
+    char *accum = *str;
 
-        //printStack(st->stack);
-        //printf(" | %s\n", *str);
+    while(*str < p->end && **str != '\n' && **str != ']') {
+        long long position = *str - p->index->source;
 
         switch (**str) {
             case ' ': //Value simples ou operador
-            resolveWord(accum, *str - accum, st);
+            resolveWord(accum, *str - accum, accum - p->index->source, code);
             break;
 
             case '"': //String
-            push(st->stack, readString(str));
+            addAt(code, fromValue(readString(p, str)), position);
             break;
 
             case '[': //Array
-            push(st->stack, readArray(st, str));
+            if (readNumberArray(str, &ins.value)) { //só contém números
+                ins.type = PushValue;
+            } else {
+                ins.type = PushArray;
+                ins.array = readArray(p, str);
+            }
+            addAt(code, ins, position);
             break;
 
             case '{': //Bloco
-            aux = *str;     //guarda o início do bloco
-            readBlock(str); //avança até ao fim do bloco
-            //calcula o tamanho (dado como a diferença entre as posições das chavetas)
-            push(st->stack, fromBlock(aux + 1, *str - aux));
+            addAt(code, fromValue(readBlock(p, str)), position);
             break;
 
             default:    (*str)++;   continue; //nao foi lido um símbolo
         }
+        if (*str >= p->end) { //delimitador por fechar
+            accum = *str;
+            break;
+        }
         accum = *str + 1; //foi lido um símbolo
         (*str)++;
     }
-    resolveWord(accum, *str - accum, st); // Resolve o que faltar
+    resolveWord(accum, *str - accum, accum - p->index->source, code); // Resolve o que faltar
+    return code;
+}
+
+/**
+ * \brief Compila a string fornecida, produzindo o programa com todas as operações descritas na string.
+ * 
+ * @param str    A string correspondente ao input. Fica a apontar para o fim do programa.
+ * @param blocks A tabela onde guardar os blocos do programa
+ * @return       O programa compilado
+ */
+Program compileInput(char** str, BlockTable blocks) {
+    SourceIndex index = indexSource(*str);
+    Parser p = { index, index->source + index->length, 0, blocks };
+    Program code = compileCode(&p, str);
+    disposeSourceIndex(index);
+    return code;
+}
+
+/**
+ * \brief Processa a string fornecida, e preenche a stack dada, efetuando todas as operações descritas na string.
+ * 
+ * @param str   A string correspondente ao input
+ * @param st    O state a preencher
+ */
+void processInput(char** str, State* st) {
+    Program p = compileInput(str, st->blocks);
+    optimizeProgram(p);
+    runProgram(p, st);
+    disposeProgram(p);
+}
+
+/**
+ * \brief Processa a string fornecida tal como processInput, recuperando dos
+ * erros de avaliação.
+ *
+ * Se um operador falhar, o resto do programa não é executado: as stacks em uso
+ * são libertadas, a stack do state fica vazia (as variáveis mantêm os valores
+ * que tinham) e a descrição do erro é guardada em error.
+ *
+ * @param str   A string correspondente ao input
+ * @param st    O state a preencher
+ * @param error Onde guardar a descrição do erro, se ocorrer
+ * @return      1 se o programa foi executado até ao fim, 0 se ocorreu um erro
+ */
+bool tryProcessInput(char** str, State* st, EvalError* error) {
+    Program p = compileInput(str, st->blocks);
+    optimizeProgram(p);
+    bool ok = tryRunProgram(p, st, error);
+    disposeProgram(p);
+    return ok;
+}
+
+/**
+ * \brief Executa um programa já compilado, recuperando dos erros de avaliação
+ * tal como tryProcessInput. O programa não é libertado e pode voltar a ser
+ * executado.
+ *
+ * @param p     O programa
+ * @param st    O state a preencher
+ * @param error Onde guardar a descrição do erro, se ocorrer
+ * @return      1 se o programa foi executado até ao fim, 0 se ocorreu um erro
+ */
+bool tryRunProgram(Program p, State* st, EvalError* error) {
+    Evaluation ev;
+    beginEvaluation(&ev, st);
+    if (setjmp(ev.boundary) == 0) {
+        runProgram(p, st);
+        endEvaluation(&ev);
+        return true;
+    }
+
+    //a avaliação foi terminada por raiseError
+    *error = ev.error;
+    return false;
 }
\ No newline at end of file
@@ -12,6 +12,9 @@
 
 
 #include "stack.h"
+#include "program.h"
+#include "sourceIndex.h"
+#include "error.h"
 #include "operations.h"
 #include "stackOperations.h"
 #include "typeOperations.h"
@@ -19,22 +22,80 @@
 #include "blockOperations.h"
 #include "arrayOperations.h"
 
+//! Seleciona o argumento das funções sobre o estado
+#define POP_S st
 //! Seleciona os argumentos das funções sobre a stack
 #define POP_0S st->stack
 //! Seleciona o argumento das funções com um arguemnto
-#define POP_1 pop(st->stack)
+#define POP_1 flattened(pop(st->stack))
 //! Seleciona o argumento das funções com um argumento sobre a stack
-#define POP_1S st, pop(st->stack)
+#define POP_1S st, flattened(pop(st->stack))
+//! Seleciona o argumento das funções com um argumento sobre a stack que aceitam árvores RRB (ver flatten)
+#define POP_1ST st, pop(st->stack)
 //! Seleciona o argumento das funções com um argumento e sub operações
 #define POP_0SO *(str + 1), st
 //! Seleciona o argumento das funções com dois argumentos
-#define POP_2 pop(st->stack), pop(st->stack)
+#define POP_2 flattened(pop(st->stack)), flattened(pop(st->stack))
+//! Seleciona o argumento das funções com dois argumentos que aceitam árvores RRB
+#define POP_2T pop(st->stack), pop(st->stack)
 //! Seleciona o argumento das funções com dois argumentos sobre a stack
-#define POP_2S st, pop(st->stack), pop(st->stack)
+#define POP_2S st, flattened(pop(st->stack)), flattened(pop(st->stack))
+//! Seleciona o argumento das funções com dois argumentos sobre a stack que aceitam árvores RRB
+#define POP_2ST st, pop(st->stack), pop(st->stack)
 //! Seleciona o argumento das funções com dois argumentos e sub operações
-#define POP_2O str + 1, pop(st->stack), pop(st->stack)
+#define POP_2O str + 1, flattened(pop(st->stack)), flattened(pop(st->stack))
 //! Seleciona o argumento das funções com três argumentos
-#define POP_3 pop(st->stack), pop(st->stack), pop(st->stack)
+#define POP_3 flattened(pop(st->stack)), flattened(pop(st->stack)), flattened(pop(st->stack))
+
+//! Seleciona os argumentos sem verificar se a stack tem os operandos (ver uncheckedOperation)
+#define UNCHECKED_POP_S POP_S
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_0S POP_0S
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_1 flattened(popUnchecked(st->stack))
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_1S st, flattened(popUnchecked(st->stack))
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_1ST st, popUnchecked(st->stack)
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_0SO POP_0SO
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_2 flattened(popUnchecked(st->stack)), flattened(popUnchecked(st->stack))
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_2T popUnchecked(st->stack), popUnchecked(st->stack)
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_2S st, flattened(popUnchecked(st->stack)), flattened(popUnchecked(st->stack))
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_2ST st, popUnchecked(st->stack), popUnchecked(st->stack)
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_2O str + 1, flattened(popUnchecked(st->stack)), flattened(popUnchecked(st->stack))
+//! Seleciona os argumentos sem verificar se a stack tem os operandos
+#define UNCHECKED_POP_3 flattened(popUnchecked(st->stack)), flattened(popUnchecked(st->stack)), flattened(popUnchecked(st->stack))
+
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_S 0
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_0S 0
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_1 1
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_1S 1
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_1ST 1
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_0SO 0
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_2 2
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_2T 2
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_2S 2
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_2ST 2
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_2O 2
+//! Número de valores que os argumentos selecionados retiram da stack
+#define ARITY_3 3
 
 //! Não efetua push do resultado da operação.
 #define PUSH_0(x,y) y
@@ -48,13 +109,13 @@
  *
  */
 #define JUMP_TABLE \
-        ENTRY('l', 1, readLine, 0S, 0) \
+        ENTRY('l', 1, readLine, S, 0) \
         ENTRY('_', 1, duplicate, 0S, 0) \
         ENTRY(';', 1, eraseTop, 0S, 0) \
         ENTRY('\\', 1, swap, 0S, 0) \
         ENTRY('@', 1, rotate, 0S, 0) \
-        ENTRY('t', 1, readAllLines, 0S, 0) \
-        ENTRY('p', 1, printTop, 0S, 0) \
+        ENTRY('t', 1, readAllLines, S, 0) \
+        ENTRY('p', 1, printTop, S, 0) \
         \
         \
         ENTRY('f', 1, convertAndDisposeToDouble, 1, 1) \
@@ -69,24 +130,24 @@
         ENTRY('$', 1, copyElement, 1S, 1) \
         ENTRY('(', 1, decrement, 1S, 1) \
         ENTRY(')', 1, increment, 1S, 1) \
-        ENTRY(',', 1, comma, 1S, 1) \
+        ENTRY(',', 1, comma, 1ST, 1) \
         ENTRY('w', 1, executeWhileTrue, 1S, 0) \
         \
         ENTRY(':', 2, setVariable, 0SO, 0) \
         \
         \
-        ENTRY('+', 1, sum, 2, 1) \
+        ENTRY('+', 1, sum, 2T, 1) \
         ENTRY('-', 1, subtract, 2, 1) \
-        ENTRY('*', 1, multiply, 2S, 1) \
+        ENTRY('*', 1, multiply, 2ST, 1) \
         ENTRY('/', 1, divide, 2, 1) \
         ENTRY('%', 1, module, 2S, 1) \
         ENTRY('#', 1, exponentiate, 2, 1) \
         ENTRY('&', 1, and, 2, 1) \
         ENTRY('|', 1, or, 2, 1) \
         ENTRY('^', 1, xor, 2, 1) \
-        ENTRY('=', 1, isEqual, 2, 1) \
-        ENTRY('<', 1, isLess, 2, 1) \
-        ENTRY('>', 1, isGreater, 2, 1) \
+        ENTRY('=', 1, isEqual, 2T, 1) \
+        ENTRY('<', 1, isLess, 2T, 1) \
+        ENTRY('>', 1, isGreater, 2T, 1) \
         \
         ENTRY('e', 1, shortcutSelect, 2O, 1) \
         \
@@ -94,7 +155,11 @@
         ENTRY('?', 1, conditional, 3, 1)
 
 
-//! Expansão da JumpTable para Switch.
+//! Verifica que a stack tem todos os operandos antes de retirar o primeiro, para que
+//! um erro não deixe por libertar os operandos já retirados
+#define CHECK_ARITY(st, d) CHECK((st)->stack->size >= ARITY_##d, "a stack está vazia")
+
+//! Expansão da JumpTable para Switch, que executa o operador.
 /*!
  *  a é o primeiro caracter do operador
 
@@ -106,20 +171,57 @@
 
  *  e é 1 se o valor de retorno deve ser empurrado para a stack e 0 se não
  */
-#define ENTRY(a, b, c, d, e) case a: if (length >= b) { PUSH_##e(st->stack, c(POP_##d)); return true; } break;
+#define ENTRY_CALL(a, b, c, d, e) case a: if (length >= b) { CHECK_ARITY(st, d); PUSH_##e(st->stack, c(POP_##d)); return true; } break;
+
+//! Expansão da JumpTable para Switch, que apenas verifica se a palavra é um operador.
+#define ENTRY_CHECK(a, b, c, d, e) case a: return length >= b;
+
+//! Expansão da JumpTable para Switch, que executa o operador sem verificar se a stack tem os operandos.
+#define ENTRY_UNCHECKED(a, b, c, d, e) case a: if (length >= b) { PUSH_##e(st->stack, c(UNCHECKED_POP_##d)); return true; } break;
+
+//! Expansão da JumpTable usada por omissão.
+#define ENTRY ENTRY_CALL
+
+/**
+ * \brief Representa o estado da compilação de um texto indexado
+ */
+typedef struct parser {
+    //! O índice dos delimitadores do texto
+    SourceIndex index;
+    //! O fim do texto a compilar
+    char* end;
+    //! O índice do próximo delimitador a encontrar
+    long long next;
+    //! A tabela onde são guardados os blocos compilados
+    BlockTable blocks;
+} Parser;
 
 bool operation(char* str, long long length, State* st);
 
-Value readValue(char* str, long long length, State* st);
+bool uncheckedOperation(char* str, long long length, State* st);
+
+bool isOperation(char* str, long long length);
+
+Instruction readValue(char* str, long long length);
 
 char getControlChar(char c);
 
-Value readString(char** str);
+Value readString(Parser* p, char** str);
+
+Program readArray(Parser* p, char** str);
+
+Value readBlock(Parser* p, char** str);
 
-void readBlock(char** str);
+void resolveWord(char* str, long long length, long long position, Program p);
 
-void resolveWord(char* str, long long length, State* st);
+Program compileCode(Parser* p, char** str);
+
+Program compileInput(char** str, BlockTable blocks);
 
 void processInput(char** str, State* st);
 
+bool tryProcessInput(char** str, State* st, EvalError* error);
+
+bool tryRunProgram(Program p, State* st, EvalError* error);
+
 #endif
@@ -0,0 +1,225 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que contam as sequências de
+ * instruções executadas (n-gramas)
+ *
+ * Cada instrução executada forma, com as instruções que a precedem no mesmo
+ * programa, um bigrama e um trigrama. As sequências são identificadas pelo
+ * texto das instruções (os operadores, as constantes numéricas e as
+ * variáveis), pelo que as contagens de programas diferentes se podem somar.
+ *
+ * No fim da execução, cada sequência é acrescentada ao ficheiro pedido numa
+ * linha com a contagem, o tamanho da sequência, a superinstrução que a
+ * substitui (ver fusion.c; `-` se não houver) e o texto da sequência,
+ * separados por tabs. Como as linhas são acrescentadas, o mesmo ficheiro
+ * acumula as contagens de um corpus de programas (ver profile.sh).
+ *
+ * Enquanto as sequências são contadas, os programas não são fundidos em
+ * superinstruções nem compilados para código máquina, para que todas as
+ * instruções sejam executadas uma a uma.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "profile.h"
+#include "fusion.h"
+
+//! Tamanho máximo do texto de uma instrução
+#define LABEL_SIZE 32
+
+/**
+ * \brief Uma sequência de instruções executada
+ */
+typedef struct ngram {
+    //! O texto das instruções, separadas por espaços (NULL se a posição da tabela estiver livre)
+    char* key;
+    //! O número de instruções
+    int n;
+    //! O nome da superinstrução que substitui a sequência (NULL se não houver)
+    const char* fusion;
+    //! Número de execuções
+    long long count;
+} NGram;
+
+bool profiling = false;
+
+//! O ficheiro onde escrever as contagens
+static FILE* output;
+//! A tabela de dispersão das sequências
+static NGram* table;
+//! O tamanho da tabela (uma potência de 2)
+static long long capacity;
+//! Número de sequências guardadas
+static long long used;
+
+/**
+ * \brief Escreve o texto de uma instrução
+ * @param ins A instrução
+ * @param buf Onde escrever o texto (com LABEL_SIZE caracteres)
+ */
+static void describe(Instruction* ins, char* buf) {
+    switch (ins->type) {
+        case PushValue:
+            switch (ins->value.type) {
+                case Int:       snprintf(buf, LABEL_SIZE, "%lld", ins->value.integer);    return;
+                case Double:    snprintf(buf, LABEL_SIZE, "%g", ins->value.decimal);      return;
+                case BigInt:    snprintf(buf, LABEL_SIZE, "<big>");                       return;
+                case Char:
+                    if (isgraph((unsigned char) ins->value.character))
+                        snprintf(buf, LABEL_SIZE, "'%c", ins->value.character);
+                    else
+                        snprintf(buf, LABEL_SIZE, "'\\x%02x", (unsigned char) ins->value.character);
+                    return;
+                case String:    snprintf(buf, LABEL_SIZE, "\"...\"");                     return;
+                case Array:     snprintf(buf, LABEL_SIZE, "[...]");                       return;
+                default:        snprintf(buf, LABEL_SIZE, "{...}");                       return;
+            }
+        case PushVariable:  snprintf(buf, LABEL_SIZE, "%c", 'A' + ins->variable);         return;
+        case PushArray:     snprintf(buf, LABEL_SIZE, "[...]");                           return;
+        case Operation:     snprintf(buf, LABEL_SIZE, "%s", ins->word);                   return;
+        default:            snprintf(buf, LABEL_SIZE, "%s", fusionName(ins->fusion));     return;
+    }
+}
+
+/**
+ * \brief Calcula o hash do texto de uma sequência (FNV-1a)
+ * @param key O texto
+ * @return    O hash
+ */
+static unsigned long long hashKey(const char* key) {
+    unsigned long long h = 14695981039346656037ULL;
+
+    for (; *key != '\0'; key++)
+        h = (h ^ (unsigned char) *key) * 1099511628211ULL;
+    return h;
+}
+
+/**
+ * \brief Devolve a posição da tabela onde está (ou deve ficar) a sequência
+ * @param key O texto da sequência
+ * @return    A posição
+ */
+static NGram* find(const char* key) {
+    long long i = hashKey(key) & (capacity - 1);
+
+    while (table[i].key != NULL && strcmp(table[i].key, key) != 0)
+        i = (i + 1) & (capacity - 1);
+    return &table[i];
+}
+
+/**
+ * \brief Duplica o tamanho da tabela, voltando a inserir as sequências
+ */
+static void grow() {
+    NGram* old = table;
+    long long oldCapacity = capacity;
+
+    capacity *= 2;
+    table = calloc(capacity, sizeof(NGram));
+    for (long long i = 0; i < oldCapacity; i++)
+        if (old[i].key != NULL)
+            *find(old[i].key) = old[i];
+    free(old);
+}
+
+/**
+ * \brief Conta uma execução da sequência de n instruções que começa em first
+ * @param first A primeira instrução
+ * @param n     O número de instruções
+ */
+static void count(Instruction* first, int n) {
+    char key[3 * (LABEL_SIZE + 1)], *end = key;
+
+    for (int i = 0; i < n; i++) {
+        if (i > 0)
+            *end++ = ' ';
+        describe(&first[i], end);
+        end += strlen(end);
+    }
+
+    NGram* g = find(key);
+    if (g->key == NULL) {
+        FusionType fusion;
+        long long operand;
+
+        g->key = strdup(key);
+        g->n = n;
+        g->fusion = matchFusion(first, n, &fusion, &operand) == n ? fusionName(fusion) : NULL;
+        g->count = 0;
+        if (2 * ++used > capacity) {
+            grow();
+            g = find(key);
+        }
+    }
+    g->count++;
+}
+
+/**
+ * \brief Inicia a contagem das sequências de instruções executadas
+ * @param file O ficheiro a que acrescentar as contagens
+ * @return     false se não foi possível abrir o ficheiro
+ */
+bool startProfile(const char* file) {
+    output = fopen(file, "a");
+    if (output == NULL)
+        return false;
+
+    capacity = 1024;
+    used = 0;
+    table = calloc(capacity, sizeof(NGram));
+    profiling = true;
+    return true;
+}
+
+/**
+ * \brief Conta as sequências que terminam na instrução dada
+ * @param first A primeira instrução do programa em execução
+ * @param ins   A instrução a executar
+ */
+void profileInstruction(Instruction* first, Instruction* ins) {
+    if (ins - first >= 1)
+        count(ins - 1, 2);
+    if (ins - first >= 2)
+        count(ins - 2, 3);
+}
+
+/**
+ * \brief Compara duas sequências, para as ordenar por tamanho e pelo número de
+ * execuções (decrescente)
+ * @param a A primeira sequência
+ * @param b A segunda sequência
+ * @return  Negativo se a vier antes de b, positivo se vier depois
+ */
+static int compareNGrams(const void* a, const void* b) {
+    const NGram *x = a, *y = b;
+
+    if (x->n != y->n)
+        return x->n - y->n;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+/**
+ * \brief Termina a contagem, acrescentando as sequências ao ficheiro
+ */
+void stopProfile() {
+    if (!profiling)
+        return;
+    profiling = false;
+
+    long long n = 0;
+    for (long long i = 0; i < capacity; i++)
+        if (table[i].key != NULL)
+            table[n++] = table[i];
+    qsort(table, n, sizeof(NGram), compareNGrams);
+
+    for (long long i = 0; i < n; i++) {
+        fprintf(output, "%lld\t%d\t%s\t%s\n", table[i].count, table[i].n,
+                table[i].fusion != NULL ? table[i].fusion : "-", table[i].key);
+        free(table[i].key);
+    }
+
+    fclose(output);
+    free(table);
+}
@@ -0,0 +1,23 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que contam as sequências de
+ * instruções executadas (n-gramas)
+ */
+
+//! Include guard
+#ifndef PROFILE_H
+//! Include guard
+#define PROFILE_H
+
+#include "program.h"
+
+//! É verdadeiro enquanto as sequências de instruções executadas estiverem a ser contadas
+extern bool profiling;
+
+bool startProfile(const char* file);
+
+void profileInstruction(Instruction* first, Instruction* ins);
+
+void stopProfile();
+
+#endif
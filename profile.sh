@@ -0,0 +1,25 @@
+#!/bin/sh
+# Conta as sequências de instruções (bigramas e trigramas) executadas por um
+# corpus de programas e mostra as mais frequentes, com a superinstrução que
+# substitui cada uma (ver fusion.c).
+#
+# Uso: ./profile.sh ficheiro...
+# Cada ficheiro tem um programa na primeira linha e o seu input nas seguintes.
+# O executável e o número de sequências mostradas de cada tamanho podem ser
+# mudados com as variáveis CALC e TOP.
+
+CALC=${CALC:-./calc}
+TOP=${TOP:-20}
+COUNTS=$(mktemp)
+trap 'rm -f "$COUNTS"' EXIT
+
+for f in "$@"; do
+    "$CALC" -n "$COUNTS" < "$f" > /dev/null || echo "aviso: $f terminou com erro" >&2
+done
+
+for n in 2 3; do
+    echo "== sequências de $n instruções"
+    awk -F '\t' -v n="$n" '$2 == n { count[$4] += $1; fusion[$4] = $3 }
+        END { for (s in count) printf "%12d  %-16s %s\n", count[s], fusion[s], s }' "$COUNTS" \
+        | sort -rn | head -n "$TOP"
+done
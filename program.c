@@ -0,0 +1,289 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que criam e executam programas
+ * compilados
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "program.h"
+#include "parser.h"
+#include "memory.h"
+#include "error.h"
+#include "fusion.h"
+#include "profile.h"
+
+/**
+ * \brief Cria um programa sem instruções
+ * @return O programa vazio
+ */
+Program newProgram() {
+    Program p = allocate(ProgramAlloc, sizeof(struct program));
+    p->size = 0;
+    p->capacity = 16;
+    p->code = allocate(ProgramAlloc, sizeof(Instruction) * p->capacity);
+    p->effect.bounded = false; //ainda não foi analisado (ver optimizeProgram)
+    return p;
+}
+
+/**
+ * \brief Acrescenta uma instrução ao fim do programa
+ * @param p   O programa
+ * @param ins A instrução
+ */
+void addInstruction(Program p, Instruction ins) {
+    if (p->size == p->capacity) {
+        p->capacity *= 2;
+        p->code = reallocate(p->code, sizeof(Instruction) * p->capacity);
+    }
+    p->code[p->size++] = ins;
+}
+
+/**
+ * \brief Cria uma instrução que empurra o valor dado
+ * @param v O valor (passa a pertencer à instrução)
+ * @return  A instrução
+ */
+Instruction fromValue(Value v) {
+    Instruction ins;
+
+    ins.type = PushValue;
+    ins.value = v;
+    ins.position = -1;
+    return ins;
+}
+
+/**
+ * \brief Cria uma instrução que executa o operador dado pela palavra
+ * @param str    A palavra
+ * @param length O tamanho da palavra
+ * @return       A instrução
+ */
+Instruction fromOperation(char* str, long long length) {
+    Instruction ins;
+
+    ins.type = Operation;
+    ins.word[0] = str[0];
+    ins.word[1] = length > 1 ? str[1] : '\0';
+    ins.word[2] = '\0';
+    ins.length = length;
+    ins.cachedTypes = hasNumericHandlers(ins.word[0]) ? EMPTY_CACHE : NO_CACHE;
+    ins.handler = NULL;
+    ins.position = -1;
+    return ins;
+}
+
+/**
+ * \brief Cria uma superinstrução que substitui uma sequência de instruções
+ * @param fusion   A sequência substituída
+ * @param operand  A constante inteira ou o índice da variável da sequência
+ * @param original As instruções substituídas (passam a pertencer à superinstrução)
+ * @return         A instrução
+ */
+Instruction fromFusion(FusionType fusion, long long operand, struct program* original) {
+    Instruction ins;
+
+    ins.type = Fused;
+    ins.fusion = fusion;
+    ins.topType = EMPTY_CACHE;
+    ins.operand = operand;
+    ins.topHandler = NULL;
+    ins.original = original;
+    ins.position = original->code[0].position;
+    return ins;
+}
+
+/**
+ * \brief Executa o programa de uma array numa stack vazia
+ * @param p  O programa
+ * @param st O estado do programa
+ * @return   A array resultante
+ */
+static Value runArray(Program p, State* st) {
+    Suspended current = { st->stack, st->suspended }; //guarda a stack atual
+    st->suspended = &current;
+    st->stack = empty();
+    runProgram(p, st);
+    Value r = fromStack(st->stack);
+    st->stack = current.stack; //recupera a stack
+    st->suspended = current.previous;
+    return r;
+}
+
+/**
+ * \brief Executa um operador numérico com a operação especializada para os
+ * tipos dos dois valores do topo da stack.
+ *
+ * A instrução guarda os tipos da última execução e a operação selecionada para
+ * eles na tabela de operações (ver numericOperations.c): enquanto os tipos se
+ * repetirem, a operação é chamada diretamente. O resultado substitui os
+ * operandos na stack.
+ *
+ * @param ins A instrução Operation
+ * @param st  A stack
+ * @return    1 se o operador foi executado, 0 se deve ser executado pelo operador genérico
+ */
+static bool runCached(Instruction* ins, Stack st) {
+    //os valores de uma vista pertencem a outra stack
+    if (st->size < 2 || st->parent != NULL)
+        return false;
+
+    Value x = valueAt(st, st->size - 2), y = valueAt(st, st->size - 1);
+    DataType a = x.type, b = y.type;
+    if (a >= NUMERIC_TYPES || b >= NUMERIC_TYPES)
+        return false;
+
+    int types = a * NUMERIC_TYPES + b;
+    if (types != ins->cachedTypes) {
+        ins->cachedTypes = types;
+        ins->handler = findNumericHandler(ins->word[0], a, b);
+    }
+
+    Value r;
+    if (ins->handler == NULL || !ins->handler(x, y, &r))
+        return false;
+
+    releaseStored(st->values[--st->size]);
+    setValueAt(st, st->size - 1, r);
+    st->hash = 0;
+    return true;
+}
+
+/**
+ * \brief Executa uma instrução
+ * @param ins     A instrução
+ * @param st      O estado do programa
+ * @param checked 0 se a análise do programa garante que a stack tem os operandos dos operadores
+ */
+static inline void dispatch(Instruction* ins, State* st, bool checked) {
+    switch (ins->type) {
+        case PushValue:
+            //os valores numéricos não precisam de ser copiados e as arrays
+            //constantes (e os inteiros grandes) são partilhadas em vez de copiadas
+            if (ins->value.type < String && ins->value.type != BigInt)
+                push(st->stack, ins->value);
+            else
+                push(st->stack, share(&ins->value));
+            break;
+
+        case PushVariable:
+            push(st->stack, deepCopy(st->variables[ins->variable]));
+            break;
+
+        case PushArray:
+            push(st->stack, runArray(ins->array, st));
+            break;
+
+        case Operation: {
+            if (ins->cachedTypes != NO_CACHE && runCached(ins, st->stack))
+                break;
+
+            //a instrução em execução identifica o operador nos erros de avaliação
+            Instruction* previous = st->current;
+            st->current = ins;
+            if (checked)
+                operation(ins->word, ins->length, st);
+            else
+                uncheckedOperation(ins->word, ins->length, st);
+            st->current = previous;
+            break;
+        }
+
+        case Fused:
+            runFused(ins, st);
+            break;
+    }
+}
+
+/**
+ * \brief Executa uma instrução
+ * @param ins A instrução
+ * @param st  O estado do programa
+ */
+void runInstruction(Instruction* ins, State* st) {
+    dispatch(ins, st, true);
+}
+
+/**
+ * \brief Executa todas as instruções do programa.
+ *
+ * Quando a análise determinou o efeito do programa (ver analysis.c) e a stack
+ * tem os valores que ele consome, os operadores não verificam se a stack tem
+ * os operandos e o espaço de que a stack vai precisar é reservado de uma vez.
+ *
+ * @param p  O programa
+ * @param st O estado do programa
+ */
+void runProgram(Program p, State* st) {
+    Instruction* end = p->code + p->size;
+
+    if (profiling) { //conta as sequências de instruções executadas
+        for (Instruction* ins = p->code; ins < end; ins++) {
+            profileInstruction(p->code, ins);
+            runInstruction(ins, st);
+        }
+        return;
+    }
+
+    //as vistas não são alteradas (os valores pertencem a outra stack)
+    if (p->effect.bounded && st->stack->parent == NULL && st->stack->size >= p->effect.inputs) {
+        if (p->effect.growth != UNBOUNDED)
+            reserve(st->stack, p->effect.growth);
+        for (Instruction* ins = p->code; ins < end; ins++)
+            dispatch(ins, st, false);
+        return;
+    }
+
+    for (Instruction* ins = p->code; ins < end; ins++)
+        runInstruction(ins, st);
+}
+
+/**
+ * \brief Prepara um estado para executar programas: a stack fica vazia, as
+ * variáveis com os valores iniciais, o input é o stdin e o output o stdout
+ * @param st     O estado
+ * @param blocks A tabela onde são guardados os blocos compilados
+ */
+void initializeState(State* st, struct blockTable* blocks) {
+    st->stack = empty();
+    st->suspended = NULL;
+    st->current = NULL;
+    st->blocks = blocks;
+    st->input = st->inputEnd = NULL;
+    st->output = stdout;
+    initializeVariables(st);
+}
+
+/**
+ * \brief Liberta a stack e as variáveis de um estado (a tabela de blocos não é libertada)
+ * @param st O estado
+ */
+void disposeState(State* st) {
+    disposeVariables(st);
+    disposeStack(st->stack);
+}
+
+/**
+ * \brief Liberta os valores guardados numa instrução
+ * @param ins A instrução
+ */
+void disposeInstruction(Instruction ins) {
+    switch (ins.type) {
+        case PushValue:     disposeValue(ins.value);        break;
+        case PushArray:     disposeProgram(ins.array);      break;
+        case Fused:         disposeProgram(ins.original);   break;
+        default:                                            break;
+    }
+}
+
+/**
+ * \brief Liberta um programa e todas as suas instruções
+ * @param p O programa
+ */
+void disposeProgram(Program p) {
+    for (long long i = 0; i < p->size; i++)
+        disposeInstruction(p->code[i]);
+
+    release(p->code);
+    release(p);
+}
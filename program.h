@@ -0,0 +1,154 @@
+/**
+ * @file
+ * @brief contém a definição da representação compilada de um programa
+ * (ou de um bloco) e das funções que a executam
+ */
+
+//! Include guard
+#ifndef PROGRAM_H
+//! Include guard
+#define PROGRAM_H
+
+#include <limits.h>
+#include "stack.h"
+#include "numericOperations.h"
+
+/**
+ * \brief Representa os diferentes tipos de instruções de um programa compilado
+ */
+typedef enum instructionType {
+    PushValue,      //!< Empurra uma cópia de um valor constante
+    PushVariable,   //!< Empurra uma cópia de uma variável
+    PushArray,      //!< Executa um programa numa stack vazia e empurra-a como array
+    Operation,      //!< Executa um operador
+    Fused,          //!< Executa uma sequência frequente de instruções como uma só (ver fusion.c)
+} InstructionType;
+
+/**
+ * \brief Representa as sequências de instruções substituídas por uma
+ * superinstrução (Fused)
+ */
+typedef enum fusionType {
+    FuseConstant,       //!< Uma constante inteira seguida de um operador binário (`1+`, `0=`, `2%`)
+    FuseIncrement,      //!< `)` seguido de uma constante inteira e de um operador binário (`) 10<`)
+    FuseDecrement,      //!< `(` seguido de uma constante inteira e de um operador binário (`( 0=`)
+    FuseDuplicate,      //!< `_` seguido de um operador binário (`_*`)
+    FuseNip,            //!< `\;`: apaga o valor abaixo do topo
+    FuseRunVariable,    //!< Uma variável seguida de `~` (`A~`)
+    FusePipeline,       //!< Uma cadeia de map, filter e fold com blocos constantes (`{3*}%{2%},{+}*`)
+} FusionType;
+
+/**
+ * \brief Representa uma instrução de um programa compilado
+ */
+typedef struct instruction {
+    //! O tipo da instrução
+    InstructionType type;
+    //! Os argumentos da instrução (dependem do tipo)
+    union {
+        //! O valor de uma instrução PushValue
+        Value value;
+        //! O programa de uma instrução PushArray
+        struct program* array;
+        //! O índice da variável de uma instrução PushVariable
+        int variable;
+        //! A palavra de uma instrução Operation
+        struct {
+            //! Os dois primeiros caracteres da palavra (os únicos relevantes para os operadores)
+            char word[3];
+            //! O tamanho original da palavra
+            long long length;
+            //! Os tipos dos operandos da última execução (cache da instrução, ver runInstruction)
+            int cachedTypes;
+            //! A operação especializada para os tipos em cache (NULL se não houver)
+            NumericHandler handler;
+        };
+        //! A superinstrução de uma instrução Fused
+        struct {
+            //! A sequência substituída
+            FusionType fusion;
+            //! O tipo do topo da stack na última execução (cache da superinstrução)
+            int topType;
+            //! A constante inteira ou o índice da variável da sequência
+            long long operand;
+            //! A operação especializada para o tipo em cache (NULL se não houver)
+            NumericHandler topHandler;
+            //! As instruções substituídas, executadas quando a superinstrução não se aplica
+            struct program* original;
+        };
+    };
+    //! A posição da instrução no texto de onde foi compilada (-1 se não for conhecida)
+    long long position;
+} Instruction;
+
+//! A cache de uma instrução Operation ainda não foi preenchida
+#define EMPTY_CACHE -1
+//! A instrução Operation não tem cache (o operador não tem operações especializadas)
+#define NO_CACHE -2
+
+//! Um conjunto de tipos de dados: um bit (1 << tipo) por cada DataType
+typedef unsigned TypeSet;
+
+//! Um limite da análise que não pode ser determinado
+#define UNBOUNDED LLONG_MAX
+
+/**
+ * \brief Representa o efeito de um programa sobre a stack, determinado pela
+ * análise estática (ver analysis.c)
+ */
+typedef struct stackEffect {
+    //! 1 se a análise determinou quantos valores o programa consome (e, por isso, inputs e minDelta são válidos)
+    bool bounded;
+    //! O número de valores que têm de estar na stack para o programa não a esvaziar
+    long long inputs;
+    //! A menor variação do tamanho da stack no fim do programa
+    long long minDelta;
+    //! A maior variação do tamanho da stack no fim do programa (UNBOUNDED se não tiver limite)
+    long long maxDelta;
+    //! O maior crescimento da stack durante o programa (UNBOUNDED se não tiver limite)
+    long long growth;
+    //! Os tipos possíveis do topo da stack no fim do programa
+    TypeSet top;
+    //! 1 se o programa não lê o input, não escreve e não altera variáveis (pode ser executado em paralelo)
+    bool pure;
+    //! 1 se o programa só usa números e operadores numéricos (pode ser compilado para código máquina)
+    bool numeric;
+} StackEffect;
+
+/**
+ * \brief Representa um programa compilado: uma sequência de instruções
+ */
+typedef struct program {
+    //! As instruções
+    Instruction* code;
+    //! O número de instruções
+    long long size;
+    //! O tamanho da array de instruções
+    long long capacity;
+    //! O efeito do programa sobre a stack (bounded é 0 se não tiver sido analisado)
+    StackEffect effect;
+} * Program;
+
+Program newProgram();
+
+void addInstruction(Program p, Instruction ins);
+
+Instruction fromValue(Value v);
+
+Instruction fromOperation(char* str, long long length);
+
+Instruction fromFusion(FusionType fusion, long long operand, struct program* original);
+
+void runProgram(Program p, State* st);
+
+void runInstruction(Instruction* ins, State* st);
+
+void initializeState(State* st, struct blockTable* blocks);
+
+void disposeState(State* st);
+
+void disposeInstruction(Instruction ins);
+
+void disposeProgram(Program p);
+
+#endif
@@ -0,0 +1,354 @@
+/**
+ * @file
+ * @brief contém a implementação da execução do programa sobre cada registo
+ * (linha) do input, em várias threads
+ *
+ * O programa é executado uma vez por cada linha do input, com a linha como
+ * input dos operadores `l` e `t`. Os registos são independentes: cada um começa
+ * com a stack vazia e as variáveis com os valores iniciais. Cada thread
+ * (worker) compila o programa uma vez, para a sua tabela de blocos, e tem o seu
+ * State.
+ *
+ * Os workers obtêm o número do próximo registo com um contador atómico e
+ * guardam o resultado no anel de resultados, na posição do registo módulo o
+ * tamanho do anel. Cada posição tem um número de sequência: é igual a i quando
+ * a posição está livre para o registo i, e a i + 1 quando o resultado do
+ * registo i está pronto. A thread principal escreve os resultados pela ordem
+ * do input e liberta cada posição para o registo i + tamanho do anel. O anel
+ * não usa locks: cada posição só tem um escritor de cada vez, e as esperas
+ * são feitas com sched_yield.
+ *
+ * Com regiões, toda a memória alocada durante um registo é alocada na região
+ * do worker (ver memory.c), e o estado do registo é libertado de uma vez com
+ * resetRegion, em vez de percorrer e libertar cada valor com disposeState.
+ *
+ * No modo contínuo (streamRecords), as linhas são executadas numa só thread à
+ * medida que são lidas, sem ler primeiro todo o input: cada linha é empurrada
+ * para a stack como uma string, e a stack final é escrita (e descartada) no
+ * fim da linha. A memória de cada linha é sempre alocada numa região, pelo que
+ * a memória usada é proporcional à linha mais comprida, e não ao tamanho do
+ * input. As variáveis pedidas mantêm o valor entre linhas (para acumular
+ * totais): no fim de cada linha, os valores que lhes foram atribuídos são
+ * copiados para fora da região com promoteValue.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "records.h"
+#include "parser.h"
+#include "optimizer.h"
+#include "memory.h"
+#include "logicOperations.h"
+
+//! Número de posições do anel de resultados por worker
+#define SLOTS_PER_WORKER 16
+
+/**
+ * \brief Uma posição do anel de resultados
+ */
+typedef struct recordSlot {
+    //! O número de sequência da posição (ocupa sozinho a linha de cache)
+    _Alignas(64) _Atomic long long sequence;
+    //! O texto escrito pelo registo (alocado por open_memstream)
+    char* output;
+    //! O tamanho do texto escrito
+    size_t length;
+    //! 1 se o programa foi executado até ao fim
+    bool ok;
+    //! O erro que interrompeu o programa, se não foi executado até ao fim
+    EvalError error;
+} RecordSlot;
+
+/**
+ * \brief O trabalho partilhado pelos workers
+ */
+typedef struct recordBatch {
+    //! O texto do programa
+    const char* program;
+    //! O texto dos registos
+    const char* text;
+    //! O início de cada registo no texto (o último elemento é o fim do texto)
+    long long* starts;
+    //! Número de registos
+    long long count;
+    //! O número do próximo registo a executar
+    _Atomic long long next;
+    //! O anel de resultados
+    RecordSlot* ring;
+    //! Número de posições do anel
+    long long ringSize;
+    //! 1 se a memória de cada registo for alocada numa região
+    bool regions;
+    //! As estatísticas de memória de cada worker, no fim da execução
+    MemoryStats* stats;
+    //! O número do próximo worker a terminar
+    _Atomic int finished;
+} RecordBatch;
+
+/**
+ * \brief Lê todo o conteúdo de um ficheiro
+ * @param in     O ficheiro
+ * @param length Onde guardar o número de caracteres lidos
+ * @return       O conteúdo (deve ser libertado com free)
+ */
+static char* readAll(FILE* in, long long* length) {
+    size_t capacity = 1 << 16, size = 0, n;
+    char* text = malloc(capacity);
+
+    while ((n = fread(text + size, 1, capacity - size, in)) > 0) {
+        size += n;
+        if (size == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+
+    *length = size;
+    return text;
+}
+
+/**
+ * \brief Divide o texto em registos, um por linha
+ * @param text   O texto
+ * @param length O tamanho do texto
+ * @param count  Onde guardar o número de registos
+ * @return       O início de cada registo, seguido do fim do texto (deve ser libertado com free)
+ */
+static long long* splitRecords(const char* text, long long length, long long* count) {
+    long long n = 0, capacity = 1024;
+    long long* starts = malloc(sizeof(long long) * capacity);
+    const char *p = text, *end = text + length;
+
+    while (p < end) {
+        if (n + 1 == capacity) {
+            capacity *= 2;
+            starts = realloc(starts, sizeof(long long) * capacity);
+        }
+        starts[n++] = p - text;
+
+        const char* nl = memchr(p, '\n', end - p);
+        p = nl == NULL ? end : nl + 1;
+    }
+
+    starts[n] = length;
+    *count = n;
+    return starts;
+}
+
+/**
+ * \brief Executa os registos obtidos do contador partilhado até não haver mais
+ * @param arg O trabalho partilhado (RecordBatch)
+ * @return    NULL
+ */
+static void* worker(void* arg) {
+    RecordBatch* b = arg;
+    BlockTable blocks = newBlockTable();
+    char* str = (char*) b->program; //o texto do programa não é alterado pela compilação
+    Program p = compileInput(&str, blocks);
+    optimizeProgram(p);
+    Region region = b->regions ? newRegion() : NULL;
+
+    long long i;
+    while ((i = atomic_fetch_add_explicit(&b->next, 1, memory_order_relaxed)) < b->count) {
+        RecordSlot* slot = &b->ring[i % b->ringSize];
+        while (atomic_load_explicit(&slot->sequence, memory_order_acquire) != i)
+            sched_yield();
+
+        State st;
+        FILE* out = open_memstream(&slot->output, &slot->length);
+        enterRegion(region);
+        initializeState(&st, blocks);
+        st.input = b->text + b->starts[i];
+        st.inputEnd = b->text + b->starts[i + 1];
+        st.output = out;
+
+        slot->ok = tryRunProgram(p, &st, &slot->error);
+        if (slot->ok)
+            printStackLine(out, st.stack);
+        fclose(out);
+        if (region != NULL) {
+            enterRegion(NULL);
+            resetRegion(region);
+        } else
+            disposeState(&st);
+
+        atomic_store_explicit(&slot->sequence, i + 1, memory_order_release);
+    }
+
+    if (region != NULL)
+        disposeRegion(region);
+    disposeProgram(p);
+    disposeBlockTable(blocks);
+    b->stats[atomic_fetch_add(&b->finished, 1)] = getMemoryStats();
+    return NULL;
+}
+
+/**
+ * \brief Executa o programa sobre cada linha do input, em várias threads, e
+ * escreve os resultados pela ordem do input.
+ *
+ * O resultado de cada registo é o texto escrito pelo operador `p` seguido da
+ * stack final. Se o programa falhar num registo, o erro é escrito no stderr
+ * (com o número do registo) e a execução continua nos registos seguintes.
+ *
+ * @param program O texto do programa
+ * @param in      O ficheiro de onde ler os registos
+ * @param out     O ficheiro onde escrever os resultados
+ * @param workers O número de threads que executam o programa
+ * @param regions 1 se a memória de cada registo deve ser alocada numa região
+ * @return        1 se o programa foi executado até ao fim em todos os registos, 0 caso contrário
+ */
+bool processRecords(const char* program, FILE* in, FILE* out, int workers, bool regions) {
+    RecordBatch b;
+    long long length;
+    char* text = readAll(in, &length);
+
+    b.program = program;
+    b.text = text;
+    b.regions = regions;
+    b.starts = splitRecords(text, length, &b.count);
+    atomic_init(&b.next, 0);
+    b.ringSize = (long long) workers * SLOTS_PER_WORKER;
+    b.ring = aligned_alloc(_Alignof(RecordSlot), sizeof(RecordSlot) * b.ringSize);
+    for (long long k = 0; k < b.ringSize; k++)
+        atomic_init(&b.ring[k].sequence, k);
+
+    b.stats = malloc(sizeof(MemoryStats) * workers);
+    atomic_init(&b.finished, 0);
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * workers);
+    int started = 0;
+    while (started < workers && pthread_create(&threads[started], NULL, worker, &b) == 0)
+        started++;
+
+    bool ok = true;
+    if (started == 0) {
+        fprintf(stderr, "erro: não foi possível criar as threads\n");
+        ok = false;
+        b.count = 0;
+    }
+
+    for (long long i = 0; i < b.count; i++) {
+        RecordSlot* slot = &b.ring[i % b.ringSize];
+        while (atomic_load_explicit(&slot->sequence, memory_order_acquire) != i + 1)
+            sched_yield();
+
+        fwrite(slot->output, 1, slot->length, out);
+        free(slot->output);
+        if (!slot->ok) {
+            fprintf(stderr, "registo %lld: ", i + 1);
+            printError(stderr, &slot->error);
+            ok = false;
+        }
+
+        atomic_store_explicit(&slot->sequence, i + b.ringSize, memory_order_release);
+    }
+
+    for (int k = 0; k < started; k++)
+        pthread_join(threads[k], NULL);
+    for (int k = 0; k < started; k++)
+        mergeMemoryStats(b.stats[k]);
+
+    free(threads);
+    free(b.stats);
+    free(b.ring);
+    free(b.starts);
+    free(text);
+    return ok;
+}
+
+/**
+ * \brief Verifica se dois valores são o mesmo (o mesmo tipo e o mesmo conteúdo
+ * ou objeto), sem comparar os elementos
+ * @param a O primeiro valor
+ * @param b O segundo valor
+ * @return  1 se forem o mesmo, 0 caso contrário
+ */
+static bool sameValue(Value a, Value b) {
+    return a.type == b.type && a.integer == b.integer;
+}
+
+/**
+ * \brief Executa o programa sobre cada linha do input, à medida que é lida, e
+ * escreve a stack final de cada linha logo que a linha termina.
+ *
+ * O programa é compilado uma só vez. Cada linha (sem o `\n`) começa com a
+ * stack contendo apenas a linha, como uma string, e com as variáveis com os
+ * valores iniciais, exceto as variáveis de keep, que ficam com o valor que
+ * tinham no fim da linha anterior. Os operadores `l` e `t` não leem nada. Se o
+ * programa falhar numa linha, o erro é escrito no stderr (com o número da
+ * linha) e a execução continua nas linhas seguintes.
+ *
+ * @param program O texto do programa
+ * @param in      O ficheiro de onde ler as linhas
+ * @param out     O ficheiro onde escrever os resultados
+ * @param keep    As letras das variáveis que mantêm o valor entre linhas (pode ser NULL)
+ * @return        1 se o programa foi executado até ao fim em todas as linhas, 0 caso contrário
+ */
+bool streamRecords(const char* program, FILE* in, FILE* out, const char* keep) {
+    BlockTable blocks = newBlockTable();
+    char* str = (char*) program; //o texto do programa não é alterado pela compilação
+    Program p = compileInput(&str, blocks);
+    optimizeProgram(p);
+    Region region = newRegion();
+
+    bool kept[26] = { false };
+    for (; keep != NULL && *keep != '\0'; keep++)
+        if (*keep >= 'A' && *keep <= 'Z')
+            kept[*keep - 'A'] = true;
+
+    //os valores das variáveis mantidas, alocados fora da região
+    State st;
+    Value saved[26];
+    initializeVariables(&st);
+    memcpy(saved, st.variables, sizeof(saved));
+
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t n;
+    bool ok = true;
+    for (long long number = 1; (n = getline(&line, &capacity, in)) != -1; number++) {
+        if (n > 0 && line[n - 1] == '\n')
+            n--;
+
+        EvalError error;
+        enterRegion(region);
+        initializeState(&st, blocks);
+        for (int i = 0; i < 26; i++)
+            if (kept[i])
+                st.variables[i] = saved[i];
+        st.input = st.inputEnd = line + n;
+        st.output = out;
+        push(st.stack, fromText(line, n));
+
+        bool done = tryRunProgram(p, &st, &error);
+        if (done)
+            printStackLine(out, st.stack);
+        fflush(out);
+        if (!done) {
+            fprintf(stderr, "linha %lld: ", number);
+            printError(stderr, &error);
+            ok = false;
+        }
+
+        //um valor atribuído durante a linha substituiu (e libertou) o anterior
+        for (int i = 0; i < 26; i++)
+            if (kept[i] && !sameValue(st.variables[i], saved[i]))
+                saved[i] = promoteValue(st.variables[i]);
+
+        enterRegion(NULL);
+        resetRegion(region);
+    }
+
+    for (int i = 0; i < 26; i++)
+        if (kept[i])
+            disposeValue(saved[i]);
+    free(line);
+    disposeRegion(region);
+    disposeProgram(p);
+    disposeBlockTable(blocks);
+    return ok;
+}
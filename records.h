@@ -0,0 +1,19 @@
+/**
+ * @file
+ * @brief contém a declaração das funções que executam o programa sobre cada
+ * registo (linha) do input, em várias threads ou à medida que é lido
+ */
+
+//! Include guard
+#ifndef RECORDS_H
+//! Include guard
+#define RECORDS_H
+
+#include <stdio.h>
+#include "stack.h"
+
+bool processRecords(const char* program, FILE* in, FILE* out, int workers, bool regions);
+
+bool streamRecords(const char* program, FILE* in, FILE* out, const char* keep);
+
+#endif
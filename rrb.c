@@ -0,0 +1,544 @@
+/**
+ * @file
+ * @brief contém a implementação das árvores RRB (relaxed radix balanced)
+ *
+ * Uma árvore RRB guarda os valores de uma array grande em folhas de até
+ * RRB_BRANCHING valores, agrupadas por nós internos de até RRB_BRANCHING
+ * filhos. Cada nó interno guarda o número de valores acumulado até cada
+ * filho, pelo que os filhos não precisam de estar cheios: o índice de um
+ * valor é estimado como numa árvore radix (i >> (RRB_BITS * altura)) e
+ * corrigido avançando pelos tamanhos acumulados.
+ *
+ * Os nós nunca são alterados depois de construídos. A concatenação, o
+ * take e o drop constroem apenas os nós do caminho até ao ponto de corte
+ * (O(log n) nós) e partilham os restantes com as árvores originais, através
+ * de contagens de referências. Na concatenação, os nós junto à fronteira são
+ * redistribuídos quando houver mais de RRB_EXTRAS nós a mais do que o mínimo
+ * necessário, para que a altura da árvore se mantenha logarítmica (segundo
+ * Bagwell e Rompf, "RRB-Trees: Efficient Immutable Vectors").
+ *
+ * Os valores de uma folha pertencem à folha: quando são lidos para fora da
+ * árvore têm de ser copiados com deepCopy (exceto nas folhas `plain`, cujos
+ * valores não têm memória própria e podem ser copiados com memcpy).
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "rrb.h"
+#include "memory.h"
+
+//! Número de nós a mais, em relação ao mínimo, tolerado num nível antes de redistribuir os filhos
+#define RRB_EXTRAS 2
+//! Número máximo de filhos juntados num nível pela concatenação
+#define MERGE_SIZE (2 * RRB_BRANCHING)
+//! Tamanho de uma folha (sem os campos dos nós internos)
+#define LEAF_SIZE (offsetof(struct rrbNode, values) + sizeof(StoredValue) * RRB_BRANCHING)
+
+/**
+ * \brief Cria uma folha vazia
+ * @return A folha
+ */
+static RrbNode newLeaf() {
+    RrbNode leaf = allocate(RrbNodeAlloc, LEAF_SIZE);
+    leaf->refs = 1;
+    leaf->height = 0;
+    leaf->count = 0;
+    leaf->plain = true;
+    return leaf;
+}
+
+/**
+ * \brief Cria um nó interno com os filhos dados
+ * @param height   A altura do nó
+ * @param children Os filhos (as referências passam a pertencer ao nó)
+ * @param n        O número de filhos
+ * @return         O nó
+ */
+static RrbNode newInternal(int height, RrbNode* children, int n) {
+    RrbNode node = allocate(RrbNodeAlloc, sizeof(struct rrbNode));
+    long long total = 0;
+
+    node->refs = 1;
+    node->height = height;
+    node->count = n;
+    node->plain = false;
+    for (int i = 0; i < n; i++) {
+        node->children[i] = children[i];
+        total += rrbSize(children[i]);
+        node->sizes[i] = total;
+    }
+    return node;
+}
+
+/**
+ * \brief Acrescenta valores a uma folha
+ * @param leaf   A folha
+ * @param values Os valores
+ * @param n      O número de valores (têm de caber na folha)
+ * @param copy   1 se os valores devem ser copiados, 0 se passam a pertencer à folha
+ */
+static void addValues(RrbNode leaf, StoredValue* values, int n, bool copy) {
+    for (int i = 0; i < n; i++) {
+        StoredValue s = values[i];
+        Value v = loadValue(s);
+
+        if (v.type == String || v.type == Array || v.type == BigInt || isBoxed(s)) {
+            leaf->plain = false;
+            if (copy)
+                s = storeValue(deepCopy(v));
+        }
+        leaf->values[leaf->count++] = s;
+    }
+}
+
+/**
+ * \brief Acrescenta a uma folha uma cópia de valores de outra folha
+ * @param leaf   A folha
+ * @param source A folha com os valores (não é alterada)
+ * @param offset A posição do primeiro valor
+ * @param n      O número de valores
+ */
+static void copyLeafValues(RrbNode leaf, RrbNode source, int offset, int n) {
+    if (source->plain) {
+        memcpy(leaf->values + leaf->count, source->values + offset, sizeof(StoredValue) * n);
+        leaf->count += n;
+    } else
+        addValues(leaf, source->values + offset, n, true);
+}
+
+/**
+ * \brief Cria uma árvore com os valores dados, com as folhas e os nós cheios
+ * @param values Os valores
+ * @param n      O número de valores (maior que 0)
+ * @param copy   1 se os valores devem ser copiados, 0 se passam a pertencer à árvore
+ * @return       A árvore
+ */
+RrbNode rrbFromValues(StoredValue* values, long long n, bool copy) {
+    long long count = (n + RRB_BRANCHING - 1) / RRB_BRANCHING;
+    RrbNode* level = malloc(sizeof(RrbNode) * count);
+
+    for (long long i = 0; i < count; i++) {
+        long long start = i * RRB_BRANCHING;
+        level[i] = newLeaf();
+        addValues(level[i], values + start, n - start < RRB_BRANCHING ? n - start : RRB_BRANCHING, copy);
+    }
+
+    for (int height = 1; count > 1; height++) {
+        long long parents = (count + RRB_BRANCHING - 1) / RRB_BRANCHING;
+        for (long long i = 0; i < parents; i++) {
+            long long start = i * RRB_BRANCHING;
+            level[i] = newInternal(height, level + start,
+                                   count - start < RRB_BRANCHING ? count - start : RRB_BRANCHING);
+        }
+        count = parents;
+    }
+
+    RrbNode root = level[0];
+    free(level);
+    return root;
+}
+
+/**
+ * \brief Devolve o número de valores de uma árvore
+ * @param t A árvore
+ * @return  O número de valores
+ */
+long long rrbSize(RrbNode t) {
+    return t->height == 0 ? t->count : t->sizes[t->count - 1];
+}
+
+/**
+ * \brief Acrescenta uma referência a uma árvore
+ * @param t A árvore
+ */
+void rrbRetain(RrbNode t) {
+    t->refs++;
+}
+
+/**
+ * \brief Liberta uma referência a uma árvore, libertando os nós que deixam de ser referidos
+ * @param t A árvore
+ */
+void rrbRelease(RrbNode t) {
+    if (--t->refs > 0)
+        return;
+
+    if (t->height > 0)
+        for (int i = 0; i < t->count; i++)
+            rrbRelease(t->children[i]);
+    else if (!t->plain)
+        for (int i = 0; i < t->count; i++)
+            disposeValue(takeValue(t->values[i]));
+
+    release(t);
+}
+
+/**
+ * \brief Devolve o valor numa posição da árvore
+ * @param t A árvore
+ * @param i A posição (0 é o primeiro valor)
+ * @return  O valor (continua a pertencer à árvore)
+ */
+StoredValue rrbGet(RrbNode t, long long i) {
+    while (t->height > 0) {
+        int k = (int) (i >> (RRB_BITS * t->height)); //os filhos têm no máximo 32^altura valores
+
+        while (t->sizes[k] <= i)
+            k++;
+        if (k > 0)
+            i -= t->sizes[k - 1];
+        t = t->children[k];
+    }
+    return t->values[i];
+}
+
+/**
+ * \brief Substitui a raiz da árvore pelo seu único filho, enquanto só tiver um
+ * @param t A árvore
+ * @return  A nova raiz
+ */
+static RrbNode unwrap(RrbNode t) {
+    while (t->height > 0 && t->count == 1) {
+        RrbNode child = t->children[0];
+        rrbRetain(child);
+        rrbRelease(t);
+        t = child;
+    }
+    return t;
+}
+
+/**
+ * \brief Decide como redistribuir os nós de um nível: os nós cheios são
+ * mantidos e os restantes são juntados até haver no máximo RRB_EXTRAS nós
+ * a mais do que o necessário
+ * @param all    Os nós
+ * @param n      O número de nós
+ * @param counts Onde escrever o número de filhos (ou valores) de cada nó do resultado
+ * @return       O número de nós do resultado
+ */
+static int planMerge(RrbNode* all, int n, int* counts) {
+    int total = 0;
+
+    for (int i = 0; i < n; i++) {
+        counts[i] = all[i]->count;
+        total += counts[i];
+    }
+
+    int optimal = (total + RRB_BRANCHING - 1) / RRB_BRANCHING;
+    int i = 0;
+
+    while (optimal + RRB_EXTRAS < n) {
+        while (counts[i] == RRB_BRANCHING) //os nós cheios ficam como estão
+            i++;
+
+        //o nó i é espalhado pelos seguintes, até o que sobra caber num deles
+        int remaining = counts[i];
+        do {
+            int size = remaining + counts[i + 1] < RRB_BRANCHING ? remaining + counts[i + 1] : RRB_BRANCHING;
+            remaining += counts[i + 1] - size;
+            counts[i] = size;
+            i++;
+        } while (remaining > 0);
+
+        for (int j = i; j < n - 1; j++)
+            counts[j] = counts[j + 1];
+        n--;
+        i--;
+    }
+    return n;
+}
+
+/**
+ * \brief Constrói os nós de um nível segundo o plano de planMerge. Os nós que
+ * ficam iguais são reutilizados; os restantes copiam os valores ou as
+ * referências aos filhos dos nós originais.
+ * @param all     Os nós (não são alterados)
+ * @param counts  O número de filhos (ou valores) de cada nó do resultado
+ * @param planned O número de nós do resultado
+ * @param out     Onde escrever os nós do resultado
+ */
+static void mergeNodes(RrbNode* all, int* counts, int planned, RrbNode* out) {
+    int index = 0, offset = 0;
+
+    for (int i = 0; i < planned; i++) {
+        RrbNode source = all[index];
+
+        if (offset == 0 && counts[i] == source->count) {
+            rrbRetain(source);
+            out[i] = source;
+            index++;
+            continue;
+        }
+
+        RrbNode leaf = source->height == 0 ? newLeaf() : NULL;
+        RrbNode children[RRB_BRANCHING];
+        int filled = 0;
+
+        while (filled < counts[i]) {
+            source = all[index];
+            int n = source->count - offset < counts[i] - filled ? source->count - offset : counts[i] - filled;
+
+            if (leaf != NULL)
+                copyLeafValues(leaf, source, offset, n);
+            else
+                for (int j = 0; j < n; j++) {
+                    children[filled + j] = source->children[offset + j];
+                    rrbRetain(children[filled + j]);
+                }
+
+            filled += n;
+            offset += n;
+            if (offset == source->count) {
+                index++;
+                offset = 0;
+            }
+        }
+
+        out[i] = leaf != NULL ? leaf : newInternal(source->height, children, filled);
+    }
+}
+
+/**
+ * \brief Junta os filhos de três nós da mesma altura (o último filho de left
+ * e o primeiro de right são substituídos por mid), redistribuindo-os
+ * @param left  O nó da esquerda (NULL se não houver)
+ * @param mid   O nó do meio (a referência é libertada)
+ * @param right O nó da direita (NULL se não houver)
+ * @param top   1 se for o nível de cima da concatenação
+ * @return      Um nó da altura de mid com o resultado, ou um nó mais alto com
+ *              um ou dois filhos com o resultado (sempre, se top for 0)
+ */
+static RrbNode rebalance(RrbNode left, RrbNode mid, RrbNode right, bool top) {
+    RrbNode all[MERGE_SIZE], merged[MERGE_SIZE];
+    int counts[MERGE_SIZE], n = 0, height = mid->height;
+
+    if (left != NULL)
+        for (int i = 0; i < left->count - 1; i++)
+            all[n++] = left->children[i];
+    for (int i = 0; i < mid->count; i++)
+        all[n++] = mid->children[i];
+    if (right != NULL)
+        for (int i = 1; i < right->count; i++)
+            all[n++] = right->children[i];
+
+    int planned = planMerge(all, n, counts);
+    mergeNodes(all, counts, planned, merged);
+    rrbRelease(mid);
+
+    if (planned <= RRB_BRANCHING) {
+        RrbNode node = newInternal(height, merged, planned);
+        return top ? node : newInternal(height + 1, &node, 1);
+    }
+
+    RrbNode halves[2] = {
+        newInternal(height, merged, RRB_BRANCHING),
+        newInternal(height, merged + RRB_BRANCHING, planned - RRB_BRANCHING)
+    };
+    return newInternal(height + 1, halves, 2);
+}
+
+/**
+ * \brief Concatena duas árvores, descendo pela fronteira entre elas
+ * @param left  A árvore da esquerda (não é alterada)
+ * @param right A árvore da direita (não é alterada)
+ * @param top   1 se for o nível de cima da concatenação
+ * @return      A árvore com a concatenação (ver rebalance)
+ */
+static RrbNode concatNodes(RrbNode left, RrbNode right, bool top) {
+    if (left->height > right->height)
+        return rebalance(left, concatNodes(left->children[left->count - 1], right, false), NULL, top);
+    if (left->height < right->height)
+        return rebalance(NULL, concatNodes(left, right->children[0], false), right, top);
+
+    if (left->height == 0) { //as folhas são juntadas (e redistribuídas) pelo nível de cima
+        RrbNode leaves[2] = { left, right };
+        rrbRetain(left);
+        rrbRetain(right);
+        return newInternal(1, leaves, 2);
+    }
+
+    RrbNode mid = concatNodes(left->children[left->count - 1], right->children[0], false);
+    return rebalance(left, mid, right, top);
+}
+
+/**
+ * \brief Concatena duas árvores em O(log n), partilhando os nós que não estão na fronteira
+ * @param a A primeira árvore (a referência é libertada)
+ * @param b A segunda árvore (a referência é libertada)
+ * @return  A árvore com os valores de a seguidos dos de b
+ */
+RrbNode rrbConcat(RrbNode a, RrbNode b) {
+    RrbNode root = concatNodes(a, b, true);
+
+    rrbRelease(a);
+    rrbRelease(b);
+    return unwrap(root);
+}
+
+/**
+ * \brief Repete os valores de uma árvore, concatenando-a consigo própria
+ * (O(log n) concatenações, que partilham os nós das repetições)
+ * @param t A árvore (a referência é libertada)
+ * @param n O número de repetições (maior que 0)
+ * @return  A árvore com as repetições
+ */
+RrbNode rrbRepeat(RrbNode t, long long n) {
+    RrbNode result = NULL;
+
+    while (true) {
+        if (n & 1) {
+            rrbRetain(t);
+            result = result == NULL ? t : rrbConcat(result, t);
+        }
+        n >>= 1;
+        if (n == 0)
+            break;
+        rrbRetain(t);
+        t = rrbConcat(t, t);
+    }
+
+    rrbRelease(t);
+    return result;
+}
+
+/**
+ * \brief Constrói um nó com os primeiros valores de outro
+ * @param t O nó (não é alterado)
+ * @param n O número de valores (entre 1 e o tamanho do nó)
+ * @return  O novo nó
+ */
+static RrbNode takeNode(RrbNode t, long long n) {
+    if (n == rrbSize(t)) {
+        rrbRetain(t);
+        return t;
+    }
+
+    if (t->height == 0) {
+        RrbNode leaf = newLeaf();
+        copyLeafValues(leaf, t, 0, (int) n);
+        return leaf;
+    }
+
+    RrbNode children[RRB_BRANCHING];
+    int k = 0;
+
+    while (t->sizes[k] < n) //o filho k tem o último valor
+        k++;
+    for (int i = 0; i < k; i++) {
+        children[i] = t->children[i];
+        rrbRetain(children[i]);
+    }
+    children[k] = takeNode(t->children[k], k > 0 ? n - t->sizes[k - 1] : n);
+    return newInternal(t->height, children, k + 1);
+}
+
+/**
+ * \brief Constrói um nó sem os primeiros valores de outro
+ * @param t O nó (não é alterado)
+ * @param n O número de valores a retirar (menor que o tamanho do nó)
+ * @return  O novo nó
+ */
+static RrbNode dropNode(RrbNode t, long long n) {
+    if (n == 0) {
+        rrbRetain(t);
+        return t;
+    }
+
+    if (t->height == 0) {
+        RrbNode leaf = newLeaf();
+        copyLeafValues(leaf, t, (int) n, t->count - (int) n);
+        return leaf;
+    }
+
+    RrbNode children[RRB_BRANCHING];
+    int k = 0;
+
+    while (t->sizes[k] <= n) //o filho k tem o primeiro valor que fica
+        k++;
+    children[0] = dropNode(t->children[k], k > 0 ? n - t->sizes[k - 1] : n);
+    for (int i = k + 1; i < t->count; i++) {
+        children[i - k] = t->children[i];
+        rrbRetain(children[i - k]);
+    }
+    return newInternal(t->height, children, t->count - k);
+}
+
+/**
+ * \brief Devolve os primeiros valores de uma árvore, em O(log n)
+ * @param t A árvore (a referência é libertada)
+ * @param n O número de valores (entre 1 e o tamanho da árvore)
+ * @return  A árvore com os valores
+ */
+RrbNode rrbTake(RrbNode t, long long n) {
+    RrbNode result = takeNode(t, n);
+    rrbRelease(t);
+    return unwrap(result);
+}
+
+/**
+ * \brief Retira os primeiros valores de uma árvore, em O(log n)
+ * @param t A árvore (a referência é libertada)
+ * @param n O número de valores a retirar (menor que o tamanho da árvore)
+ * @return  A árvore com os restantes valores
+ */
+RrbNode rrbDrop(RrbNode t, long long n) {
+    RrbNode result = dropNode(t, n);
+    rrbRelease(t);
+    return unwrap(result);
+}
+
+/**
+ * \brief Escreve os valores de um nó, pela ordem
+ * @param t      O nó
+ * @param out    Onde escrever os valores
+ * @param unique 1 se nenhum antecessor do nó for partilhado
+ * @return       A posição a seguir ao último valor escrito
+ */
+static StoredValue* flattenNode(RrbNode t, StoredValue* out, bool unique) {
+    unique = unique && t->refs == 1;
+
+    if (t->height > 0) {
+        for (int i = 0; i < t->count; i++)
+            out = flattenNode(t->children[i], out, unique);
+        return out;
+    }
+
+    int n = t->count;
+    if (unique || t->plain) {
+        memcpy(out, t->values, sizeof(StoredValue) * n);
+        if (!t->plain) //os valores foram movidos para out
+            t->count = 0;
+    } else
+        for (int i = 0; i < n; i++)
+            out[i] = storeValue(deepCopy(loadValue(t->values[i])));
+
+    return out + n;
+}
+
+/**
+ * \brief Escreve os valores de uma árvore, pela ordem, num buffer contíguo.
+ * Os valores das folhas que só pertencem a esta árvore são movidos; os das
+ * folhas partilhadas são copiados.
+ * @param t   A árvore (a referência é libertada)
+ * @param out Onde escrever os valores (com espaço para rrbSize(t) valores)
+ */
+void rrbFlatten(RrbNode t, StoredValue* out) {
+    flattenNode(t, out, true);
+    rrbRelease(t);
+}
+
+/**
+ * \brief Chama uma função com cada valor de uma árvore, pela ordem
+ * @param t       A árvore (não é alterada)
+ * @param f       A função
+ * @param context O argumento passado à função
+ */
+void rrbVisit(RrbNode t, void (*f)(Value v, void* context), void* context) {
+    if (t->height > 0)
+        for (int i = 0; i < t->count; i++)
+            rrbVisit(t->children[i], f, context);
+    else
+        for (int i = 0; i < t->count; i++)
+            f(loadValue(t->values[i]), context);
+}
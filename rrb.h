@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @brief contém a declaração das árvores RRB (relaxed radix balanced): os
+ * vetores persistentes usados para guardar os valores das arrays grandes
+ */
+
+//! Include guard
+#ifndef RRB_H
+//! Include guard
+#define RRB_H
+
+#include "stack.h"
+
+//! Número máximo de filhos de um nó interno e de valores de uma folha
+#define RRB_BRANCHING 32
+//! log2 de RRB_BRANCHING
+#define RRB_BITS 5
+//! Tamanho a partir do qual as arrays podem passar a ser guardadas numa árvore
+#define RRB_THRESHOLD 4096
+
+/**
+ * \brief Um nó de uma árvore RRB. Os nós nunca são alterados depois de
+ * construídos, pelo que podem ser partilhados por várias árvores (versões);
+ * são libertados quando deixam de ser referidos.
+ */
+typedef struct rrbNode {
+    //! O número de referências ao nó (árvores e nós pais)
+    long long refs;
+    //! A altura do nó (0 numa folha)
+    int height;
+    //! O número de filhos (ou de valores, numa folha)
+    int count;
+    //! Numa folha, 1 se nenhum valor tiver memória própria (podem ser copiados com memcpy)
+    bool plain;
+    union {
+        //! Os valores de uma folha
+        StoredValue values[RRB_BRANCHING];
+        //! Os filhos de um nó interno e o número de valores acumulado até cada filho
+        struct {
+            //! Os filhos
+            struct rrbNode* children[RRB_BRANCHING];
+            //! sizes[i] é o número de valores dos filhos 0 a i
+            long long sizes[RRB_BRANCHING];
+        };
+    };
+} * RrbNode;
+
+RrbNode rrbFromValues(StoredValue* values, long long n, bool copy);
+
+long long rrbSize(RrbNode t);
+
+void rrbRetain(RrbNode t);
+
+void rrbRelease(RrbNode t);
+
+StoredValue rrbGet(RrbNode t, long long i);
+
+RrbNode rrbConcat(RrbNode a, RrbNode b);
+
+RrbNode rrbRepeat(RrbNode t, long long n);
+
+RrbNode rrbTake(RrbNode t, long long n);
+
+RrbNode rrbDrop(RrbNode t, long long n);
+
+void rrbFlatten(RrbNode t, StoredValue* out);
+
+void rrbVisit(RrbNode t, void (*f)(Value v, void* context), void* context);
+
+#endif
@@ -0,0 +1,257 @@
+/**
+ * @file
+ * @brief contém a implementação das operações de conjuntos sobre strings e arrays
+ *
+ * Os elementos são procurados numa tabela de dispersão com endereçamento
+ * aberto, indexada pelo hash de cada valor (hashValue), pelo que cada operação
+ * é linear no tamanho dos operandos. A união, a interseção e a diferença
+ * simétrica removem os elementos repetidos; a diferença mantém-nos. Em todas
+ * é preservada a ordem da primeira ocorrência de cada elemento.
+ */
+
+#include <string.h>
+#include "setOperations.h"
+#include "logicOperations.h"
+#include "memory.h"
+#include "error.h"
+
+/**
+ * \brief Uma tabela de dispersão de valores. A tabela não é dona dos valores:
+ * guarda apenas apontadores para os elementos das stacks dadas.
+ */
+typedef struct valueSet {
+    //! Os valores guardados (NULL nas posições livres)
+    StoredValue** slots;
+    //! Os hashes dos valores guardados
+    unsigned long long* hashes;
+    //! O número de posições (potência de 2)
+    long long capacity;
+} ValueSet;
+
+/**
+ * \brief Cria uma tabela vazia com espaço para o número de valores dado
+ * @param n O número máximo de valores a guardar
+ * @return  A tabela
+ */
+static ValueSet newSet(long long n) {
+    ValueSet set;
+    set.capacity = 16;
+    while (set.capacity < 2 * n) //a tabela fica no máximo meio cheia
+        set.capacity *= 2;
+
+    set.slots = allocate(HashTable, sizeof(StoredValue*) * set.capacity);
+    set.hashes = allocate(HashTable, sizeof(unsigned long long) * set.capacity);
+    memset(set.slots, 0, sizeof(StoredValue*) * set.capacity);
+    return set;
+}
+
+/**
+ * \brief Liberta a tabela (os valores não são libertados)
+ * @param set A tabela
+ */
+static void disposeSet(ValueSet set) {
+    release(set.slots);
+    release(set.hashes);
+}
+
+/**
+ * \brief Procura um valor na tabela
+ * @param set A tabela
+ * @param v   O valor
+ * @param h   O hash do valor
+ * @return    A posição do valor, ou a posição livre onde deve ser inserido
+ */
+static long long findSlot(ValueSet* set, StoredValue* v, unsigned long long h) {
+    long long mask = set->capacity - 1;
+    long long i = h & mask;
+
+    while (set->slots[i] != NULL) {
+        if (set->hashes[i] == h && equalValues(loadValue(*set->slots[i]), loadValue(*v)))
+            return i;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+ * \brief Insere um valor na tabela, se ainda não existir um valor igual
+ * @param set A tabela
+ * @param v   O valor (deve continuar válido enquanto a tabela for usada)
+ * @return    1 se o valor foi inserido, 0 se já existia
+ */
+static bool insert(ValueSet* set, StoredValue* v) {
+    unsigned long long h = hashValue(loadValue(*v));
+    long long i = findSlot(set, v, h);
+
+    if (set->slots[i] != NULL)
+        return false;
+
+    set->slots[i] = v;
+    set->hashes[i] = h;
+    return true;
+}
+
+/**
+ * \brief Verifica se a tabela contém um valor igual ao dado
+ * @param set A tabela
+ * @param v   O valor
+ * @return    1 se contém, 0 caso contrário
+ */
+static bool contains(ValueSet* set, StoredValue* v) {
+    return set->slots[findSlot(set, v, hashValue(loadValue(*v)))] != NULL;
+}
+
+/**
+ * \brief Cria uma tabela com todos os elementos da stack dada
+ * @param st A stack
+ * @return   A tabela
+ */
+static ValueSet fromElements(Stack st) {
+    ValueSet set = newSet(length(st));
+
+    for (long long i = 0; i < length(st); i++)
+        insert(&set, &st->values[i]);
+
+    return set;
+}
+
+/**
+ * \brief Constrói o resultado de uma operação de conjuntos a partir dos
+ * elementos selecionados dos dois operandos, libertando os restantes
+ * @param a     O primeiro operando (já convertido para string ou array)
+ * @param keepA Os elementos de a que fazem parte do resultado
+ * @param b     O segundo operando (já convertido para string ou array)
+ * @param keepB Os elementos de b que fazem parte do resultado
+ * @return      O resultado, do maior dos tipos dos operandos
+ */
+static Value collect(Value a, bool* keepA, Value b, bool* keepB) {
+    Stack r = empty();
+    Stack operands[2] = { a.array, b.array };
+    bool* keep[2] = { keepA, keepB };
+
+    for (int k = 0; k < 2; k++) {
+        for (long long i = 0; i < length(operands[k]); i++) {
+            if (keep[k][i])
+                push(r, takeValue(operands[k]->values[i]));
+            else
+                disposeValue(takeValue(operands[k]->values[i]));
+        }
+        //os elementos passaram para r ou foram libertados
+        release(operands[k]->values);
+        release(operands[k]);
+        release(keep[k]);
+    }
+
+    Value ans = fromStack(r);
+    ans.type = a.type > b.type ? a.type : b.type;
+    return ans;
+}
+
+/**
+ * \brief Prepara os operandos de uma operação de conjuntos
+ * @param a      O primeiro operando; é convertido para string ou array
+ * @param b      O segundo operando; é convertido para string ou array
+ * @param keepA  Onde guardar a array que seleciona os elementos de a
+ * @param keepB  Onde guardar a array que seleciona os elementos de b
+ */
+static void prepare(Value* a, Value* b, bool** keepA, bool** keepB) {
+    //operação não definida para blocos
+    CHECK_OPERANDS(a->type != Block && b->type != Block, "operação não definida para blocos", *a, *b);
+
+    *a = convertToStack(*a);
+    *b = convertToStack(*b);
+    //os elementos passam para o resultado, pelo que têm de pertencer aos operandos
+    materialize(a->array);
+    materialize(b->array);
+    *keepA = allocate(HashTable, sizeof(bool) * (length(a->array) + 1));
+    *keepB = allocate(HashTable, sizeof(bool) * (length(b->array) + 1));
+}
+
+/**
+ * \brief União: os elementos de a seguidos dos de b, sem repetições
+ * @param a O primeiro operando
+ * @param b O segundo operando
+ * @return  A união
+ */
+Value setUnion(Value a, Value b) {
+    bool *keepA, *keepB;
+    prepare(&a, &b, &keepA, &keepB);
+    ValueSet seen = newSet(length(a.array) + length(b.array));
+
+    for (long long i = 0; i < length(a.array); i++)
+        keepA[i] = insert(&seen, &a.array->values[i]);
+    for (long long i = 0; i < length(b.array); i++)
+        keepB[i] = insert(&seen, &b.array->values[i]);
+
+    disposeSet(seen);
+    return collect(a, keepA, b, keepB);
+}
+
+/**
+ * \brief Interseção: os elementos de a que existem em b, sem repetições
+ * @param a O primeiro operando
+ * @param b O segundo operando
+ * @return  A interseção
+ */
+Value setIntersection(Value a, Value b) {
+    bool *keepA, *keepB;
+    prepare(&a, &b, &keepA, &keepB);
+    ValueSet inB = fromElements(b.array), seen = newSet(length(a.array));
+
+    for (long long i = 0; i < length(a.array); i++) {
+        StoredValue* v = &a.array->values[i];
+        keepA[i] = contains(&inB, v) && insert(&seen, v);
+    }
+    memset(keepB, 0, sizeof(bool) * length(b.array));
+
+    disposeSet(inB);
+    disposeSet(seen);
+    return collect(a, keepA, b, keepB);
+}
+
+/**
+ * \brief Diferença simétrica: os elementos de a que não existem em b seguidos
+ * dos de b que não existem em a, sem repetições
+ * @param a O primeiro operando
+ * @param b O segundo operando
+ * @return  A diferença simétrica
+ */
+Value setSymmetricDifference(Value a, Value b) {
+    bool *keepA, *keepB;
+    prepare(&a, &b, &keepA, &keepB);
+    ValueSet inA = fromElements(a.array), inB = fromElements(b.array);
+    ValueSet seen = newSet(length(a.array) + length(b.array));
+
+    for (long long i = 0; i < length(a.array); i++) {
+        StoredValue* v = &a.array->values[i];
+        keepA[i] = !contains(&inB, v) && insert(&seen, v);
+    }
+    for (long long i = 0; i < length(b.array); i++) {
+        StoredValue* v = &b.array->values[i];
+        keepB[i] = !contains(&inA, v) && insert(&seen, v);
+    }
+
+    disposeSet(inA);
+    disposeSet(inB);
+    disposeSet(seen);
+    return collect(a, keepA, b, keepB);
+}
+
+/**
+ * \brief Diferença: os elementos de a que não existem em b (as repetições são mantidas)
+ * @param a O primeiro operando
+ * @param b O segundo operando
+ * @return  A diferença
+ */
+Value setDifference(Value a, Value b) {
+    bool *keepA, *keepB;
+    prepare(&a, &b, &keepA, &keepB);
+    ValueSet inB = fromElements(b.array);
+
+    for (long long i = 0; i < length(a.array); i++)
+        keepA[i] = !contains(&inB, &a.array->values[i]);
+    memset(keepB, 0, sizeof(bool) * length(b.array));
+
+    disposeSet(inB);
+    return collect(a, keepA, b, keepB);
+}
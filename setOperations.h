@@ -0,0 +1,21 @@
+/**
+ * @file
+ * @brief contém a declaração das operações de conjuntos sobre strings e arrays
+ */
+
+//! Include guard
+#ifndef SET_OPERATIONS_H
+//! Include guard
+#define SET_OPERATIONS_H
+
+#include "stack.h"
+
+Value setUnion(Value a, Value b);
+
+Value setIntersection(Value a, Value b);
+
+Value setSymmetricDifference(Value a, Value b);
+
+Value setDifference(Value a, Value b);
+
+#endif
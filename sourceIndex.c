@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @brief contém a implementação das funções que constroem o índice dos
+ * delimitadores de um programa
+ *
+ * O índice é construído numa só passagem pelo texto, com uma pilha dos
+ * delimitadores ainda abertos. As regras são as mesmas que o parser sempre usou:
+ *  - o conteúdo das strings é ignorado (respeitando os caracteres escapados);
+ *  - um ']' fecha o último delimitador aberto;
+ *  - dentro de um bloco, um '}' também fecha o último delimitador aberto
+ *    (fora de blocos é um caracter como outro qualquer);
+ *  - um ']' fora de qualquer delimitador termina o programa.
+ * Depois de construído, o parser salta qualquer string, array ou bloco em tempo
+ * constante, sem voltar a percorrer o seu conteúdo.
+ */
+
+#include <string.h>
+#include "sourceIndex.h"
+#include "memory.h"
+
+/**
+ * \brief Acrescenta um delimitador ao índice, ainda por fechar
+ * @param index O índice
+ * @param open  A posição do delimitador
+ * @return      O índice do delimitador acrescentado
+ */
+static long long addDelimiter(SourceIndex index, long long open) {
+    if (index->size == index->capacity) {
+        index->capacity *= 2;
+        index->delimiters = reallocate(index->delimiters, sizeof(Delimiter) * index->capacity);
+    }
+
+    Delimiter* d = &index->delimiters[index->size];
+    d->open = open;
+    d->close = index->length;
+    d->after = index->size + 1;
+    return index->size++;
+}
+
+/**
+ * \brief Fecha um delimitador
+ * @param index O índice
+ * @param k     O índice do delimitador
+ * @param close A posição do delimitador que o fecha
+ */
+static void closeDelimiter(SourceIndex index, long long k, long long close) {
+    index->delimiters[k].close = close;
+    index->delimiters[k].after = index->size;
+}
+
+/**
+ * \brief Devolve a posição da aspa que fecha a string que começa na posição dada
+ * @param s    O texto
+ * @param open A posição da aspa que abre a string
+ * @return     A posição da aspa que fecha (ou do fim do texto)
+ */
+static long long skipString(char* s, long long open) {
+    bool escape = false;
+    long long i;
+
+    for (i = open + 1; s[i] && (escape || s[i] != '"'); i++)
+        escape = !escape && s[i] == '\\';
+
+    return i;
+}
+
+/**
+ * \brief Constrói o índice dos delimitadores do texto dado
+ * @param source O texto (deve continuar válido enquanto o índice for usado)
+ * @return       O índice
+ */
+SourceIndex indexSource(char* source) {
+    SourceIndex index = allocate(ProgramAlloc, sizeof(struct sourceIndex));
+    index->source = source;
+    index->length = strlen(source);
+    index->size = 0;
+    index->capacity = 16;
+    index->delimiters = allocate(ProgramAlloc, sizeof(Delimiter) * index->capacity);
+
+    //a pilha dos delimitadores abertos
+    long long capacity = 16, depth = 0, blocks = 0;
+    long long* open = allocate(TempString, sizeof(long long) * capacity);
+
+    for (long long i = 0; i < index->length; i++) {
+        switch (source[i]) {
+            case '"': {
+            long long k = addDelimiter(index, i);
+            i = skipString(source, i);
+            closeDelimiter(index, k, i);
+            break;
+            }
+
+            case '{':
+            blocks++;
+            //fall through
+            case '[':
+            if (depth == capacity) {
+                capacity *= 2;
+                open = reallocate(open, sizeof(long long) * capacity);
+            }
+            open[depth++] = addDelimiter(index, i);
+            break;
+
+            case '}':
+            if (blocks == 0)
+                break;
+            //fall through
+            case ']':
+            if (depth == 0) { //fim do programa
+                i = index->length;
+                break;
+            }
+            depth--;
+            if (source[index->delimiters[open[depth]].open] == '{')
+                blocks--;
+            closeDelimiter(index, open[depth], i);
+            break;
+        }
+    }
+
+    //os delimitadores por fechar terminam no fim do texto
+    while (depth > 0)
+        closeDelimiter(index, open[--depth], index->length);
+
+    release(open);
+    return index;
+}
+
+/**
+ * \brief Liberta o índice dado
+ * @param index O índice
+ */
+void disposeSourceIndex(SourceIndex index) {
+    release(index->delimiters);
+    release(index);
+}
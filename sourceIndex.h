@@ -0,0 +1,47 @@
+/**
+ * @file
+ * @brief contém a definição do índice dos delimitadores de um programa
+ * (strings, arrays e blocos) e das funções que o constroem
+ */
+
+//! Include guard
+#ifndef SOURCE_INDEX_H
+//! Include guard
+#define SOURCE_INDEX_H
+
+#include "stack.h"
+
+/**
+ * \brief Representa um delimitador que abre (um '"', '[' ou '{') e a posição
+ * do delimitador correspondente que o fecha
+ */
+typedef struct delimiter {
+    //! A posição do delimitador que abre
+    long long open;
+    //! A posição do delimitador que fecha (ou do fim do texto, se não for fechado)
+    long long close;
+    //! O índice do primeiro delimitador que abre depois de close
+    long long after;
+} Delimiter;
+
+/**
+ * \brief Representa o índice dos delimitadores de um texto, pela ordem em que abrem
+ */
+typedef struct sourceIndex {
+    //! O texto indexado
+    char* source;
+    //! O tamanho do texto
+    long long length;
+    //! Os delimitadores
+    Delimiter* delimiters;
+    //! O número de delimitadores
+    long long size;
+    //! O tamanho da array de delimitadores
+    long long capacity;
+} * SourceIndex;
+
+SourceIndex indexSource(char* source);
+
+void disposeSourceIndex(SourceIndex index);
+
+#endif
@@ -8,6 +8,33 @@
 #include <string.h>
 #include <assert.h>
 #include "stack.h"
+#include "memory.h"
+#include "rrb.h"
+#include "bigInt.h"
+#include "error.h"
+
+#ifdef NAN_BOXING
+
+/**
+ * \brief Guarda um inteiro que não cabe em 48 bits numa caixa
+ * @param n O inteiro
+ * @return  O valor guardado, que aponta para a caixa
+ */
+StoredValue boxInteger(long long n) {
+    long long* box = allocate(BoxedInt, sizeof(long long));
+    *box = n;
+    return TAG_BOXED_INT << 48 | (unsigned long long) box;
+}
+
+/**
+ * \brief Liberta a caixa de um inteiro guardado
+ * @param s O valor guardado
+ */
+void releaseBox(StoredValue s) {
+    release((long long*) (s & PAYLOAD_MASK));
+}
+
+#endif
 
 /**
  * \brief A stack vazia.
@@ -15,10 +42,14 @@
  * @return   Um objeto do tipo Stack sem nenhum elemento
  */
 Stack empty() {
-	Stack st = malloc(sizeof(struct stack));
+	Stack st = allocate(StackAlloc, sizeof(struct stack));
     st->size = 0;
     st->capacity = 128;
-    st->values = malloc(sizeof(Value) * st->capacity);
+    st->hash = 0;
+    st->parent = NULL;
+    st->views = 0;
+    st->tree = NULL;
+    st->values = allocate(ValueBuffer, sizeof(StoredValue) * st->capacity);
 	return st;
 }
 
@@ -53,11 +84,16 @@ void push(Stack s, Value value) {
     *a = *s;
     s->value = value;
     s->previous = a;*/
-    if(s->size == s->capacity) {
-        s->capacity *= 2;
-        s->values = realloc(s->values, sizeof(Value) * s->capacity);
+    if(s->size >= s->capacity) {
+        if (s->parent != NULL || s->tree != NULL) //as vistas e as árvores têm capacidade 0
+            materialize(s);
+        else {
+            s->capacity *= 2;
+            s->values = reallocate(s->values, sizeof(StoredValue) * s->capacity);
+        }
     }
-    s->values[s->size++] = value;
+    s->values[s->size++] = storeValue(value);
+    s->hash = 0;
 }
 
 /**
@@ -68,8 +104,25 @@ void push(Stack s, Value value) {
  * @return 	O elemento removido do topo da stack
  */
 Value pop(Stack s) {
-    assert(s->size > 0);
-	return s->values[--(s->size)];
+    CHECK(s->size > 0, "a stack está vazia");
+    s->hash = 0;
+    if (s->parent != NULL) //os valores de uma vista pertencem a outra stack
+        return deepCopy(loadValue(s->values[--(s->size)]));
+    return takeValue(s->values[--(s->size)]);
+}
+
+/**
+ * \brief Remove o elemento do topo da stack sem verificar se a stack está vazia
+ * (a análise do programa garante que não está, ver analysis.c)
+ *
+ * @param s     O pointer para a stack
+ * @return 	O elemento removido do topo da stack
+ */
+Value popUnchecked(Stack s) {
+    s->hash = 0;
+    if (s->parent != NULL) //os valores de uma vista pertencem a outra stack
+        return deepCopy(loadValue(s->values[--(s->size)]));
+    return takeValue(s->values[--(s->size)]);
 }
 
 /**
@@ -79,8 +132,8 @@ Value pop(Stack s) {
  * @return      O topo da stack
  */
 Value top(Stack s) {
-    assert(s->size > 0);
-    return s->values[s->size - 1];
+    CHECK(s->size > 0, "a stack está vazia");
+    return loadValue(s->values[s->size - 1]);
 }
 
 /**
@@ -90,8 +143,15 @@ Value top(Stack s) {
  * @return Valor no fundo da stack
  */
 Value popBottom(Stack st) {
-    assert(st->size > 0);
-    Value res = st->values[0];
+    CHECK(st->size > 0, "a stack está vazia");
+    st->hash = 0;
+
+    if (st->parent != NULL) { //basta avançar o início da vista
+        st->size--;
+        return deepCopy(loadValue(*(st->values++)));
+    }
+
+    Value res = takeValue(st->values[0]);
 
     for (long long i = 1; i < st->size; i++)
         st->values[i - 1] = st->values[i];
@@ -104,8 +164,12 @@ Value popBottom(Stack st) {
  * @param st A stack dada
  */
 void eraseTop(Stack st) {
-    assert(st->size > 0);
-    disposeValue(pop(st));
+    CHECK(st->size > 0, "a stack está vazia");
+    if (st->parent != NULL) { //o valor pertence a outra stack
+        st->size--;
+        st->hash = 0;
+    } else
+        disposeValue(pop(st));
 }
 
 /**
@@ -133,8 +197,237 @@ Value convertToStack(Value v) {
  *  @param value O valor do n-ésimo elemento
  */
 Value getElement(Stack st, long long n){
-    assert(n >= 0 && st->size > n);
-    return st->values[st->size - 1 - n];
+    CHECK(n >= 0 && st->size > n, "índice fora dos limites");
+    return loadValue(st->values[st->size - 1 - n]);
+}
+
+/**
+ * \brief Verifica se a stack é uma vista, ou seja, se partilha os valores de outra stack
+ * @param st A stack
+ * @return   1 se for uma vista, 0 caso contrário
+ */
+bool isView(Stack st) {
+    return st->parent != NULL;
+}
+
+/**
+ * \brief Cria uma vista sobre valores de uma stack partilhada.
+ *
+ * As vistas têm capacidade 0, para que a primeira inserção as copie (ver
+ * materialize); as restantes operações que as alteram limitam-se a mudar o
+ * intervalo de valores da vista.
+ *
+ * @param parent A stack partilhada
+ * @param values O primeiro valor da vista
+ * @param size   O número de valores da vista
+ * @return       A vista
+ */
+static Stack newView(Stack parent, StoredValue* values, long long size) {
+    Stack st = allocate(StackAlloc, sizeof(struct stack));
+    st->values = values;
+    st->size = size;
+    st->capacity = 0;
+    st->hash = 0;
+    st->parent = parent;
+    st->views = 0;
+    st->tree = NULL;
+    parent->views++;
+    return st;
+}
+
+/**
+ * \brief Liberta uma referência a uma stack partilhada, libertando-a quando
+ * deixar de ter vistas
+ * @param parent A stack partilhada
+ */
+static void releaseView(Stack parent) {
+    if (--parent->views == 0)
+        disposeStack(parent);
+}
+
+/**
+ * \brief Cria uma vista com parte dos valores de uma vista, sem a alterar
+ * @param st     A vista
+ * @param offset A posição do primeiro valor (0 é o fundo da stack)
+ * @param length O número de valores
+ * @return       A nova vista
+ */
+Stack subView(Stack st, long long offset, long long length) {
+    assert(st->parent != NULL && offset >= 0 && length >= 0 && offset + length <= st->size);
+    return newView(st->parent, st->values + offset, length);
+}
+
+/**
+ * \brief Reduz a stack a parte dos seus valores, sem os copiar: o resultado é
+ * uma vista sobre os valores originais.
+ * @param st     A stack (passa a pertencer ao resultado)
+ * @param offset A posição do primeiro valor (0 é o fundo da stack)
+ * @param length O número de valores
+ * @return       A vista
+ */
+Stack slice(Stack st, long long offset, long long length) {
+    assert(offset >= 0 && length >= 0 && offset + length <= st->size);
+
+    if (st->tree != NULL) { //os valores que ficam continuam a ser partilhados pelos nós da árvore
+        if (length == 0) {
+            disposeStack(st);
+            return empty();
+        }
+        if (offset + length < st->size)
+            st->tree = rrbTake(st->tree, offset + length);
+        if (offset > 0)
+            st->tree = rrbDrop(st->tree, offset);
+        st->size = length;
+        st->hash = 0;
+        if (length < RRB_THRESHOLD) //as arrays pequenas voltam a ter os valores num buffer
+            flattenTree(st);
+        return st;
+    }
+
+    if (st->parent != NULL) {
+        st->values += offset;
+        st->size = length;
+        st->hash = 0;
+        return st;
+    }
+
+    //a stack passa a ser partilhada, só sendo acessível através das vistas
+    return newView(st, st->values + offset, length);
+}
+
+/**
+ * \brief Faz com que uma vista passe a ser dona dos seus valores. Se for a
+ * única vista da stack partilhada, os valores são-lhe retirados sem cópias;
+ * caso contrário são copiados. Os valores de uma árvore RRB passam para um
+ * buffer. Não tem efeito nas restantes stacks.
+ * @param st A stack
+ */
+void materialize(Stack st) {
+    Stack parent = st->parent;
+    if (st->tree != NULL)
+        flattenTree(st);
+    else if (parent == NULL)
+        return;
+    else if (parent->views == 1) { //única vista: fica com o buffer da stack partilhada
+        long long offset = st->values - parent->values;
+        for (long long i = 0; i < parent->size; i++)
+            if (i < offset || i >= offset + st->size)
+                disposeValue(takeValue(parent->values[i]));
+        memmove(parent->values, st->values, sizeof(StoredValue) * st->size);
+
+        st->values = parent->values;
+        st->capacity = parent->capacity;
+        release(parent);
+    } else {
+        StoredValue* values = st->values;
+        st->capacity = st->size < 64 ? 128 : 2 * st->size;
+        st->values = allocate(ValueBuffer, sizeof(StoredValue) * st->capacity);
+        registerClone(sizeof(StoredValue) * st->size);
+        for (long long i = 0; i < st->size; i++)
+            st->values[i] = storeValue(deepCopy(loadValue(values[i])));
+        parent->views--;
+    }
+
+    st->parent = NULL;
+    if (st->size == st->capacity) {
+        st->capacity = 2 * st->size + 1;
+        st->values = reallocate(st->values, sizeof(StoredValue) * st->capacity);
+    }
+}
+
+/**
+ * \brief Passa os valores da árvore RRB de uma stack para um buffer contíguo
+ * (os valores das folhas partilhadas com outras árvores são copiados)
+ * @param st A stack, que tem de ter uma árvore
+ */
+void flattenTree(Stack st) {
+    st->capacity = st->size;
+    st->values = allocate(ValueBuffer, sizeof(StoredValue) * st->capacity);
+    rrbFlatten(st->tree, st->values);
+    st->tree = NULL;
+}
+
+/**
+ * \brief Cria uma stack com os valores de uma árvore RRB
+ * @param t A árvore (a referência passa a pertencer à stack)
+ * @return  A stack
+ */
+Stack fromTree(struct rrbNode* t) {
+    Stack st = allocate(StackAlloc, sizeof(struct stack));
+    st->values = NULL;
+    st->size = rrbSize(t);
+    st->capacity = 0;
+    st->hash = 0;
+    st->parent = NULL;
+    st->views = 0;
+    st->tree = t;
+    return st;
+}
+
+/**
+ * \brief Devolve uma árvore RRB com os valores de uma stack
+ * @param st A stack (não vazia), que é libertada
+ * @return   A árvore
+ */
+struct rrbNode* takeTree(Stack st) {
+    RrbNode t = st->tree;
+
+    if (t == NULL && st->parent != NULL) { //os valores de uma vista pertencem a outra stack
+        t = rrbFromValues(st->values, st->size, true);
+        releaseView(st->parent);
+    } else if (t == NULL) {
+        t = rrbFromValues(st->values, st->size, false);
+        release(st->values);
+    }
+
+    release(st);
+    return t;
+}
+
+/**
+ * \brief Concatena duas stacks. Se uma delas já estiver numa árvore RRB, ou se
+ * a primeira for uma vista e o resultado for grande, o resultado é uma árvore
+ * que partilha os nós das originais; caso contrário é usado merge.
+ * @param a A primeira stack (passa a pertencer ao resultado)
+ * @param b A segunda stack (passa a pertencer ao resultado)
+ * @return  A stack com os valores de a seguidos dos de b
+ */
+Stack concatenate(Stack a, Stack b) {
+    if (b->size == 0) {
+        disposeStack(b);
+        return a;
+    }
+    if (a->size == 0) {
+        disposeStack(a);
+        return b;
+    }
+
+    if (a->tree == NULL && b->tree == NULL && (a->parent == NULL || a->size + b->size < RRB_THRESHOLD))
+        return merge(a, b);
+    return fromTree(rrbConcat(takeTree(a), takeTree(b)));
+}
+
+/**
+ * \brief Devolve uma cópia de um valor que partilha os seus elementos com o
+ * valor original. Se o valor for uma string ou array, passa a ser uma vista
+ * (os valores deixam de poder ser alterados diretamente).
+ * @param v O valor; é substituído por uma vista se for uma string ou array
+ * @return  A cópia
+ */
+Value share(Value* v) {
+    if (v->type != String && v->type != Array)
+        return deepCopy(*v);
+
+    //os valores de fora da região ativa não são transformados em vistas (ver deepCopy)
+    if (outlivesRegion(v->array))
+        return detachedCopy(*v);
+
+    if (v->array->parent == NULL && v->array->tree == NULL) //as árvores já são partilhadas (ver clone)
+        v->array = slice(v->array, 0, v->array->size);
+
+    Value copy = *v;
+    copy.array = clone(v->array);
+    return copy;
 }
 
 /**
@@ -145,17 +438,101 @@ Value getElement(Stack st, long long n){
  */
 Stack clone(Stack st)
 {
-    Stack res = malloc(sizeof(struct stack));
+    //as vistas nunca alteram os valores partilhados, pelo que a cópia pode ser outra vista
+    if (st->parent != NULL)
+        return subView(st, 0, st->size);
+
+    //nem os nós das árvores
+    if (st->tree != NULL) {
+        rrbRetain(st->tree);
+        Stack res = fromTree(st->tree);
+        res->hash = st->hash;
+        return res;
+    }
+
+    Stack res = allocate(StackAlloc, sizeof(struct stack));
     res->size = st->size;
     res->capacity = st->capacity;
-    res->values = malloc(sizeof(Value) * st->capacity);
-    
+    res->hash = st->hash; //a cópia tem o mesmo conteúdo
+    res->parent = NULL;
+    res->views = 0;
+    res->tree = NULL;
+    res->values = allocate(ValueBuffer, sizeof(StoredValue) * st->capacity);
+    registerClone(sizeof(StoredValue) * st->size);
+
     for (long long i = 0; i < st->size; i++)
-        res->values[i] = deepCopy(st->values[i]);
+        res->values[i] = storeValue(deepCopy(loadValue(st->values[i])));
 
     return res;
 }
 
+/**
+ * \brief Garante que a stack tem espaço para mais n valores, com uma única realocação
+ * @param st A stack (se for uma vista, passa a ser dona dos seus valores)
+ * @param n  O número de valores a acrescentar
+ */
+void reserve(Stack st, long long n) {
+    materialize(st);
+
+    if (st->size + n > st->capacity) {
+        long long capacity = 2 * st->capacity;
+        if (capacity < st->size + n)
+            capacity = st->size + n;
+        st->capacity = capacity;
+        st->values = reallocate(st->values, sizeof(StoredValue) * st->capacity);
+    }
+}
+
+/**
+ * \brief Acrescenta valores ao topo da stack, copiando-os em bloco
+ * @param st     A stack
+ * @param values Os valores (passam a pertencer à stack; não podem ser da própria stack)
+ * @param n      O número de valores
+ */
+void appendRange(Stack st, StoredValue* values, long long n) {
+    reserve(st, n);
+    memcpy(st->values + st->size, values, sizeof(StoredValue) * n);
+    st->size += n;
+    st->hash = 0;
+}
+
+/**
+ * \brief Acrescenta ao topo da stack várias cópias dos valores dados. Se
+ * nenhum dos valores for uma string, array, inteiro grande ou inteiro numa
+ * caixa (ver StoredValue), as cópias são
+ * feitas com memcpy, duplicando de cada vez a parte já copiada.
+ * @param st     A stack
+ * @param values Os valores (não são alterados; se forem da própria stack,
+ *               o espaço tem de ter sido reservado antes)
+ * @param n      O número de valores
+ * @param times  O número de cópias
+ */
+void appendCopies(Stack st, StoredValue* values, long long n, long long times) {
+    if (n <= 0 || times <= 0)
+        return;
+
+    reserve(st, n * times);
+    StoredValue* start = st->values + st->size;
+    bool plain = true;
+
+    for (long long i = 0; i < n; i++) {
+        Value v = loadValue(values[i]);
+        start[i] = storeValue(deepCopy(v));
+        if (v.type == String || v.type == Array || v.type == BigInt || isBoxed(values[i]))
+            plain = false;
+    }
+
+    if (plain) { //os valores não têm memória própria: basta copiar os bytes
+        for (long long done = n, total = n * times; done < total; done *= 2)
+            memcpy(start + done, start, sizeof(StoredValue) * (done < total - done ? done : total - done));
+    } else
+        for (long long i = n; i < n * times; i++)
+            start[i] = storeValue(deepCopy(loadValue(values[i % n])));
+
+    st->size += n * times;
+    st->hash = 0;
+}
+
 /**
  * \brief "Junta" duas stacks
  * 
@@ -164,11 +541,15 @@ Stack clone(Stack st)
  * @return Stack que resulta da junção das duas stacks dadas inicialmente
  */
 Stack merge(Stack a, Stack b) {
-    for (long long i = 0; i < b->size; i++)
-        push(a, b->values[i]);
+    if (b->parent != NULL) { //os valores de b pertencem a outra stack
+        appendCopies(a, b->values, b->size, 1);
+        disposeStack(b);
+        return a;
+    }
 
-    free(b->values);
-    free(b);
+    appendRange(a, b->values, b->size);
+    release(b->values);
+    release(b);
     return a;
 }
 
@@ -178,12 +559,23 @@ Stack merge(Stack a, Stack b) {
  * @param st Stack dada
  */
 void disposeStack(Stack st) {
+    if (st->parent != NULL) { //uma vista só liberta a referência à stack partilhada
+        releaseView(st->parent);
+        release(st);
+        return;
+    }
+
+    if (st->tree != NULL) {
+        rrbRelease(st->tree);
+        release(st);
+        return;
+    }
 
     while (!isEmpty(st))
         eraseTop(st);
 
-    free(st->values);
-    free(st);
+    release(st->values);
+    release(st);
 }
 
 
@@ -218,25 +610,97 @@ Value fromStack(Stack st) {
 }
 
 
+/**
+ * \brief Mistura os bits de um inteiro de 64 bits (finalizador do splitmix64)
+ * @param h O inteiro
+ * @return  O inteiro misturado
+ */
+static unsigned long long mixHash(unsigned long long h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/**
+ * \brief Calcula o hash de um valor. Valores iguais segundo `=` têm o mesmo
+ * hash: os números são comparados depois de convertidos para o mesmo tipo, e
+ * as strings e as arrays elemento a elemento.
+ *
+ * @param v O valor
+ * @return  O hash
+ */
+unsigned long long hashValue(Value v) {
+    double d;
+
+    switch (v.type) {
+        case Double:    d = v.decimal;              break;
+        case BigInt:    d = bigToDouble(v.big);     break;
+        case Int:       d = (double) v.integer;     break;
+        case Char:      d = (double) v.character;   break;
+        case Block:     return mixHash((unsigned long long) v.block);
+        default:        return hashStack(v.array);
+    }
+
+    if (d == 0)
+        d = 0; //0 e -0 são iguais
+    unsigned long long bits;
+    memcpy(&bits, &d, sizeof(double));
+    return mixHash(bits);
+}
+
+/**
+ * \brief Acrescenta o hash de um valor ao hash de uma stack (ver hashStack)
+ * @param v       O valor
+ * @param context O hash da stack
+ */
+static void hashElement(Value v, void* context) {
+    unsigned long long* h = context;
+    *h = mixHash(*h ^ hashValue(v));
+}
+
+/**
+ * \brief Devolve o hash do conteúdo de uma stack, calculando-o apenas se a
+ * stack foi alterada desde a última vez que foi pedido
+ * @param st A stack
+ * @return   O hash (nunca é 0)
+ */
+unsigned long long hashStack(Stack st) {
+    if (st->hash == 0) {
+        unsigned long long h = mixHash(st->size);
+        if (st->tree != NULL)
+            rrbVisit(st->tree, hashElement, &h);
+        else
+            for (long long i = 0; i < st->size; i++)
+                hashElement(loadValue(st->values[i]), &h);
+        st->hash = h ? h : 1;
+    }
+    return st->hash;
+}
+
 /**
  * \brief Converte um #Value para string
+ *
+ * A string devolvida deve ser libertada com release.
  * 
  * @param v Value dado que vai ser convertido para string
  * @return A string obtida a partir do #Value
  */
 char* toString(Value v) {
     if(v.type == Char) {
-        char* str = (char*) malloc(sizeof(char) * 2);
+        char* str = allocate(TempString, sizeof(char) * 2);
         str[0] = v.character;
         str[1] = '\0';
         return str;
     }
+    flatten(v.array);
     long long size = length(v.array);
-    char* str = (char*) malloc(sizeof(char) * (size + 1));
+    char* str = allocate(TempString, sizeof(char) * (size + 1));
     str[0] = '\0';
 
     for(long long i = 0; i < size; i++)
-        str[i] = v.array->values[i].character;
+        str[i] = valueAt(v.array, i).character;
     
     str[size] = '\0';
     return str;
@@ -250,23 +714,36 @@ void disposeValue(Value v) {
     switch (v.type) {
         case String:
         case Array:     disposeStack(v.array);      break;
-        case Block:     free(v.block);      break;
-        default:                            break;
+        case BigInt:    disposeBig(v.big);          break;
+        default:                            break; //os blocos pertencem à tabela de blocos
     }
 }
 
 
 /**
- * \brief Imprime a stack fornecida para o ecrã. 
+ * \brief Imprime um valor de uma árvore (ver printStack)
+ * @param v O valor
+ * @param f O ficheiro onde escrever
+ */
+static void printElement(Value v, void* f) {
+    printVal(f, v);
+}
+
+/**
+ * \brief Imprime a stack fornecida para o ficheiro dado. 
  * 
  * De notar que esta função retira todos os elementos da mesma, resultando
  * uma stack vazia.
  * 
+ * @param f    O ficheiro onde escrever
  * @param st   A stack a imprimir
  */
-void printStack(Stack st) {
-    for (long long i = 0; i < st->size; i++)
-        printVal(st->values[i]);
+void printStack(FILE* f, Stack st) {
+    if (st->tree != NULL)
+        rrbVisit(st->tree, printElement, f);
+    else
+        for (long long i = 0; i < st->size; i++)
+            printVal(f, loadValue(st->values[i]));
 
     /*if (!isEmpty(st)) {
         Value top = pop(st);
@@ -284,14 +761,15 @@ void printStack(Stack st) {
 }
 
 /**
- * \brief Imprime a stack fornecida para o ecrã e muda de linha. 
+ * \brief Imprime a stack fornecida para o ficheiro dado e muda de linha. 
  * 
  * De notar que esta função retira todos os elementos da mesma, resultando
  * uma stack vazia.
  * 
+ * @param f    O ficheiro onde escrever
  * @param st   A stack a imprimir
  */
-void printStackLine(Stack st) {
-    printStack(st);
-    printf("\n");
+void printStackLine(FILE* f, Stack st) {
+    printStack(f, st);
+    putc('\n', f);
 }
\ No newline at end of file
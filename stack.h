@@ -6,6 +6,7 @@
 /*! Include guard */
 #define STACK_H
 
+#include <stdio.h>
 #include "value.h"
 
 //! Usada para distinguir semanticamente entre valor lógico 
@@ -20,19 +21,218 @@
 //! e valor numérico.
 #define bool int
 
+#ifdef NAN_BOXING
+
+/**
+ * \brief Um valor guardado numa stack, codificado em 8 bytes (NaN-boxing).
+ *
+ * Os doubles são guardados diretamente (os NaN perdem o payload, mantendo
+ * apenas o sinal). Os restantes tipos ocupam NaNs negativos: os 16 bits de cima são
+ * a etiqueta do tipo e os 48 de baixo guardam o inteiro, o caracter ou o
+ * apontador. Os inteiros que não cabem em 48 bits são guardados numa caixa
+ * alocada à parte, que pertence à posição da stack onde está o valor. Os
+ * apontadores têm de caber em 48 bits, como no espaço de utilizador de x86-64
+ * e AArch64.
+ */
+typedef unsigned long long StoredValue;
+
+//! Etiqueta dos inteiros grandes (apontador para o BigInt)
+#define TAG_BIG_INT 0xFFF9ULL
+//! Etiqueta dos inteiros de 48 bits
+#define TAG_INT 0xFFFAULL
+//! Etiqueta dos inteiros que não cabem em 48 bits (apontador para a caixa)
+#define TAG_BOXED_INT 0xFFFBULL
+//! Etiqueta dos caracteres
+#define TAG_CHAR 0xFFFCULL
+//! Etiqueta das strings (apontador para a stack)
+#define TAG_STRING 0xFFFDULL
+//! Etiqueta das arrays (apontador para a stack)
+#define TAG_ARRAY 0xFFFEULL
+//! Etiqueta dos blocos (apontador para o BlockCode)
+#define TAG_BLOCK 0xFFFFULL
+//! Os 48 bits de baixo de um valor guardado
+#define PAYLOAD_MASK 0xFFFFFFFFFFFFULL
+//! O NaN que substitui todos os NaN (com o bit de sinal do original)
+#define CANONICAL_NAN 0x7FF8000000000000ULL
+
+StoredValue boxInteger(long long n);
+
+void releaseBox(StoredValue s);
+
+/**
+ * \brief Verifica se o valor guardado tem uma caixa alocada à parte
+ * @param s O valor guardado
+ * @return  1 se tiver, 0 caso contrário
+ */
+static inline bool isBoxed(StoredValue s) {
+    return s >> 48 == TAG_BOXED_INT;
+}
+
+/**
+ * \brief Descodifica um valor guardado. O valor continua a pertencer à stack.
+ * @param s O valor guardado
+ * @return  O valor
+ */
+static inline Value loadValue(StoredValue s) {
+    Value v;
+    unsigned long long payload = s & PAYLOAD_MASK;
+
+    switch (s >> 48) {
+        case TAG_BIG_INT:   v.type = BigInt;    v.big = (struct bigInt*) payload;                   break;
+        case TAG_INT:       v.type = Int;       v.integer = (long long) (s << 16) >> 16;            break;
+        case TAG_BOXED_INT: v.type = Int;       v.integer = *(long long*) payload;                  break;
+        case TAG_CHAR:      v.type = Char;      v.character = (char) payload;                       break;
+        case TAG_STRING:    v.type = String;    v.array = (struct stack*) payload;                  break;
+        case TAG_ARRAY:     v.type = Array;     v.array = (struct stack*) payload;                  break;
+        case TAG_BLOCK:     v.type = Block;     v.block = (BlockCode) payload;                      break;
+        default:            v.type = Double;    __builtin_memcpy(&v.decimal, &s, sizeof(double));   break;
+    }
+    return v;
+}
+
+/**
+ * \brief Codifica um valor para ser guardado numa stack
+ * @param v O valor (passa a pertencer à stack)
+ * @return  O valor guardado
+ */
+static inline StoredValue storeValue(Value v) {
+    StoredValue s;
+
+    switch (v.type) {
+        case Double:
+            __builtin_memcpy(&s, &v.decimal, sizeof(double));
+            if (v.decimal != v.decimal)
+                return (s & (1ULL << 63)) | CANONICAL_NAN;
+            return s;
+        case Int:
+            if (v.integer < -(1LL << 47) || v.integer >= (1LL << 47))
+                return boxInteger(v.integer);
+            return TAG_INT << 48 | ((unsigned long long) v.integer & PAYLOAD_MASK);
+        case BigInt:    return TAG_BIG_INT << 48 | (unsigned long long) v.big;
+        case Char:      return TAG_CHAR << 48 | (unsigned char) v.character;
+        case String:    return TAG_STRING << 48 | (unsigned long long) v.array;
+        case Array:     return TAG_ARRAY << 48 | (unsigned long long) v.array;
+        default:        return TAG_BLOCK << 48 | (unsigned long long) v.block;
+    }
+}
+
+/**
+ * \brief Liberta a caixa de um valor guardado, se tiver (o valor em si não é libertado)
+ * @param s O valor guardado
+ */
+static inline void releaseStored(StoredValue s) {
+    if (isBoxed(s))
+        releaseBox(s);
+}
+
+#else
+
+//! Um valor guardado numa stack (sem NAN_BOXING, o próprio Value)
+typedef Value StoredValue;
+
+/**
+ * \brief Verifica se o valor guardado tem uma caixa alocada à parte
+ * @param s O valor guardado
+ * @return  0 (os valores são guardados diretamente)
+ */
+static inline bool isBoxed(StoredValue s) {
+    (void) s;
+    return false;
+}
+
+/**
+ * \brief Descodifica um valor guardado. O valor continua a pertencer à stack.
+ * @param s O valor guardado
+ * @return  O valor
+ */
+static inline Value loadValue(StoredValue s) {
+    return s;
+}
+
+/**
+ * \brief Codifica um valor para ser guardado numa stack
+ * @param v O valor (passa a pertencer à stack)
+ * @return  O valor guardado
+ */
+static inline StoredValue storeValue(Value v) {
+    return v;
+}
+
+/**
+ * \brief Liberta a caixa de um valor guardado (não há caixas sem NAN_BOXING)
+ * @param s O valor guardado
+ */
+static inline void releaseStored(StoredValue s) {
+    (void) s;
+}
+
+#endif
+
+/**
+ * \brief Descodifica um valor guardado que deixa de pertencer à stack
+ * @param s O valor guardado (deixa de poder ser usado)
+ * @return  O valor
+ */
+static inline Value takeValue(StoredValue s) {
+    Value v = loadValue(s);
+    releaseStored(s);
+    return v;
+}
+
 /**
  * \brief Representa uma stack (pilha), estrutura de dados LIFO, que pode ser
  * acedida pelas funções definidas abaixo.
  */
 typedef struct stack {
-    //! A array de valores armazenados
-    Value* values;
+    //! A array de valores armazenados (ver StoredValue)
+    StoredValue* values;
     //! O número de valores guardados
     long long size;
     //! O tamanho da array
     long long capacity;
+    //! O hash do conteúdo, calculado apenas quando é pedido (0 se não estiver calculado)
+    unsigned long long hash;
+    //! Numa vista, a stack a que pertencem os valores (NULL se a stack for dona dos valores)
+    struct stack* parent;
+    //! O número de vistas que partilham os valores desta stack
+    long long views;
+    //! Numa array grande, a árvore RRB com os valores (NULL se os valores estiverem em values; ver rrb.c)
+    struct rrbNode* tree;
 } * Stack;
 
+/**
+ * \brief Devolve o valor guardado numa posição da stack, sem o retirar
+ * @param st A stack
+ * @param i  A posição (0 é o fundo da stack)
+ * @return   O valor (continua a pertencer à stack)
+ */
+static inline Value valueAt(Stack st, long long i) {
+    return loadValue(st->values[i]);
+}
+
+/**
+ * \brief Substitui o valor guardado numa posição da stack. O valor anterior
+ * não é libertado (só a sua caixa, se tiver).
+ * @param st A stack
+ * @param i  A posição (0 é o fundo da stack)
+ * @param v  O novo valor (passa a pertencer à stack)
+ */
+static inline void setValueAt(Stack st, long long i, Value v) {
+    releaseStored(st->values[i]);
+    st->values[i] = storeValue(v);
+}
+
+/**
+ * \brief Representa uma stack suspensa enquanto o programa executa sobre outra
+ * (ao construir uma array ou ao executar um bloco sobre uma array)
+ */
+typedef struct suspended {
+    //! A stack suspensa
+    Stack stack;
+    //! A stack suspensa anteriormente (NULL se não houver)
+    struct suspended* previous;
+} Suspended;
+
 /**
  * \brief Representa o estado atual do programa, ou seja, as variáveis e a stack
  */
@@ -41,6 +241,18 @@ typedef struct state{
     Stack stack;
     //! O array das variáveis
     Value variables[26];
+    //! As stacks suspensas, da mais recente para a mais antiga (NULL se não houver)
+    Suspended* suspended;
+    //! A instrução Operation em execução (NULL se não houver)
+    struct instruction* current;
+    //! A tabela onde são guardados os blocos compilados
+    struct blockTable* blocks;
+    //! O input por ler pelos operadores `l` e `t` (NULL se o input for o stdin)
+    const char* input;
+    //! O fim do input por ler
+    const char* inputEnd;
+    //! O ficheiro onde o operador `p` escreve
+    FILE* output;
 } State;
 
 
@@ -54,6 +266,8 @@ void push(Stack, Value);
 
 Value pop(Stack);
 
+Value popUnchecked(Stack);
+
 Value top(Stack);
 
 Value popBottom(Stack);
@@ -66,8 +280,54 @@ Value getElement(Stack st, long long n);
 
 Stack clone(Stack);
 
+bool isView(Stack st);
+
+Stack slice(Stack st, long long offset, long long length);
+
+Stack subView(Stack st, long long offset, long long length);
+
+void materialize(Stack st);
+
+void flattenTree(Stack st);
+
+/**
+ * \brief Garante que os valores da stack estão num buffer contíguo (em values),
+ * passando-os para lá se estiverem numa árvore RRB
+ * @param st A stack
+ */
+static inline void flatten(Stack st) {
+    if (st->tree != NULL)
+        flattenTree(st);
+}
+
+/**
+ * \brief Garante que os valores de uma string ou array estão num buffer contíguo
+ * (ver flatten); os restantes valores não são alterados
+ * @param v O valor
+ * @return  O mesmo valor
+ */
+static inline Value flattened(Value v) {
+    if ((v.type == String || v.type == Array) && v.array->tree != NULL)
+        flattenTree(v.array);
+    return v;
+}
+
+Stack fromTree(struct rrbNode* t);
+
+struct rrbNode* takeTree(Stack st);
+
+Stack concatenate(Stack a, Stack b);
+
+Value share(Value* v);
+
 Stack merge(Stack, Stack);
 
+void reserve(Stack st, long long n);
+
+void appendRange(Stack st, StoredValue* values, long long n);
+
+void appendCopies(Stack st, StoredValue* values, long long n, long long times);
+
 void disposeStack(Stack);
 
 Stack stringToStack(char* str);
@@ -76,10 +336,14 @@ Value fromStack(Stack);
 
 void disposeValue(Value);
 
+unsigned long long hashValue(Value v);
+
+unsigned long long hashStack(Stack st);
+
 char* toString(Value v);
 
-void printStack(Stack st);
+void printStack(FILE* f, Stack st);
 
-void printStackLine(Stack st);
+void printStackLine(FILE* f, Stack st);
 
 #endif
\ No newline at end of file
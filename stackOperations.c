@@ -8,10 +8,11 @@
 #include "stackOperations.h"
 #include "arrayOperations.h"
 #include "blockOperations.h"
+#include "rrb.h"
+#include "error.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <assert.h>
 
 /**
  * \brief Retorna uma cópia do n-ésimo elemento da stack dada (o topo da stack é 0)
@@ -26,13 +27,13 @@
 Value copyElement(State* s, Value n) {
     if (n.type == Block) {
         Value a = pop(s->stack); //ordenar uma array
-        assert(a.type == String || a.type == Array);
+        CHECK_OPERANDS(a.type == String || a.type == Array, "o operando tem de ser uma string ou uma array", a, n);
         Value res = sort(s, a, n);
         disposeValue(n);
         return res;
     }
 
-    assert(n.type == Int); //n é um inteiro
+    CHECK_OPERAND(n.type == Int, "o índice tem de ser um inteiro", n);
     return deepCopy(getElement(s->stack, n.integer));
 }
 
@@ -43,6 +44,9 @@ Value copyElement(State* s, Value n) {
  * @param n  O número de elementos a rodar
  */
 void rotateTop(Stack st, long long n) {
+    //verifica antes de retirar o primeiro, para que um erro não deixe valores por libertar
+    CHECK(st->size >= n, "a stack está vazia");
+
     /* Para rodar os primeiros n elementos da stack basta removê-los
        e inseri-los novamente pela ordem que foram removidos. */
 
@@ -60,26 +64,41 @@ void rotateTop(Stack st, long long n) {
 }
 
 /**
- * \brief Escreve na consola o elemento no topo da stack, seguido de uma quebra de linha
+ * \brief Escreve o elemento no topo da stack, seguido de uma quebra de linha,
+ * no ficheiro de output do estado
  *
- * @param st A stack dada
+ * @param s O estado do programa
  */
-void printTop(Stack st) {
-    printVal(top(st));
-    printf("\n");
+void printTop(State* s) {
+    printVal(s->output, top(s->stack));
+    putc('\n', s->output);
 }
 
 
 /**
  * \brief Lê uma linha do input e insere-a como uma string na stack.
  *
- * @param st A stack dada
+ * O input é o texto dado ao estado ou, se não houver nenhum, o stdin.
+ *
+ * @param s O estado do programa
  */
-void readLine(Stack st)
+void readLine(State* s)
 {
-    char* line = getInput();
-    push (st, fromString (line));
-    free(line);
+    if (s->input == NULL) {
+        char* line = getInput();
+        CHECK(line != NULL, "não há mais linhas no input");
+        push (s->stack, fromString (line));
+        free(line);
+        return;
+    }
+
+    CHECK(s->input < s->inputEnd, "não há mais linhas no input");
+    const char* end = memchr(s->input, '\n', s->inputEnd - s->input);
+    if (end == NULL) //a última linha não termina com '\n'
+        end = s->inputEnd;
+
+    push(s->stack, fromText(s->input, end - s->input));
+    s->input = end < s->inputEnd ? end + 1 : end;
 }
 
 
@@ -108,11 +127,14 @@ Stack repeat(Stack st, long long n) {
     } else if (n == 1)
         return st;
 
-    Stack b = clone(st);
-
-    while (--n)
-        st = merge (st, n == 1 ? b : clone(b));
+    //as repetições de uma array grande partilham os nós de uma árvore RRB (ver rrb.c)
+    long long size = length(st);
+    if (size > 0 && (st->tree != NULL || (double) size * n >= RRB_THRESHOLD))
+        return fromTree(rrbRepeat(takeTree(st), n));
 
+    //reserva o espaço todo de uma vez, para que st->values não mude durante a cópia
+    reserve(st, size * (n - 1));
+    appendCopies(st, st->values, size, n - 1);
     return st;
 }
 /**
@@ -149,7 +171,7 @@ Value comma(State* s, Value a){
         return aux;
         case Block:
         aux = pop(s->stack);
-        assert(aux.type == Array || aux.type == String);
+        CHECK_OPERANDS(aux.type == Array || aux.type == String, "o operando tem de ser uma string ou uma array", aux, a);
         filter(s, aux.array, a);
         return aux;
         default:    //caso de erro
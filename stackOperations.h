@@ -25,11 +25,11 @@
 
 void rotateTop(Stack st, long long n);
 
-void printTop(Stack st);
+void printTop(State* s);
 
 Value copyElement(State*, Value);
 
-void readLine(Stack);
+void readLine(State* s);
 
 void duplicate(Stack);
 
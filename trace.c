@@ -0,0 +1,335 @@
+/**
+ * @file
+ * @brief contém a implementação das funções de registo (tracing) da execução
+ * dos blocos
+ *
+ * Cada execução de um bloco é um intervalo (span) identificado pelo texto do
+ * bloco. Os intervalos são agrupados numa árvore de chamadas (o caminho de
+ * blocos desde o programa principal), a partir da qual se escreve o formato
+ * "folded stacks" usado pelas ferramentas de flamegraphs. Os intervalos
+ * amostrados são também escritos como eventos do formato Chrome trace.
+ *
+ * Para limitar o custo em ciclos com milhões de iterações, apenas um em cada
+ * `rate` intervalos é cronometrado; o tempo dos restantes é estimado a partir
+ * da duração média dos intervalos amostrados do mesmo caminho.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+/**
+ * \brief Um nó da árvore de chamadas: um bloco executado a partir de um
+ * determinado caminho de blocos
+ */
+typedef struct traceNode {
+    //! O texto do bloco
+    char* name;
+    //! O bloco
+    BlockCode block;
+    //! O nó que executou este bloco
+    struct traceNode* parent;
+    //! O primeiro filho
+    struct traceNode* children;
+    //! O irmão seguinte
+    struct traceNode* next;
+    //! Número de execuções
+    long long calls;
+    //! Número de execuções cronometradas
+    long long sampled;
+    //! Soma das durações das execuções cronometradas (em nanossegundos)
+    long long sampledTime;
+} TraceNode;
+
+/**
+ * \brief Uma execução de um bloco que ainda não terminou
+ */
+typedef struct traceFrame {
+    //! O nó correspondente
+    TraceNode* node;
+    //! O instante de início (0 se a execução não for cronometrada)
+    long long start;
+} TraceFrame;
+
+bool tracing = false;
+
+//! O ficheiro Chrome trace (ou NULL)
+static FILE* chrome;
+//! O ficheiro folded stacks (ou NULL)
+static FILE* folded;
+//! Cronometra-se uma execução em cada rate
+static long long rate;
+//! Número de execuções até à próxima amostra
+static long long countdown;
+//! Se já foi escrito algum evento no ficheiro Chrome trace
+static bool firstEvent;
+//! O instante do início do registo
+static long long origin;
+
+//! A raiz da árvore (o programa principal)
+static TraceNode root;
+//! As execuções em curso
+static TraceFrame* frames;
+//! Número de execuções em curso
+static long long depth;
+//! Tamanho da array frames
+static long long capacity;
+
+/**
+ * \brief O instante atual em nanossegundos
+ */
+static long long now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/**
+ * \brief Escreve uma string escapada segundo o formato JSON (sem as aspas)
+ * @param f   O ficheiro
+ * @param str A string
+ */
+static void writeJsonString(FILE* f, const char* str) {
+    for (; *str; str++) {
+        switch (*str) {
+            case '"':   fputs("\\\"", f);   break;
+            case '\\':  fputs("\\\\", f);   break;
+            case '\n':  fputs("\\n", f);    break;
+            case '\t':  fputs("\\t", f);    break;
+            default:
+                if ((unsigned char) *str < ' ')
+                    fprintf(f, "\\u%04x", *str);
+                else
+                    fputc(*str, f);
+        }
+    }
+}
+
+/**
+ * \brief Escreve um evento completo (fase "X") no ficheiro Chrome trace
+ * @param node  O nó a que o evento corresponde
+ * @param start O instante de início
+ * @param end   O instante de fim
+ */
+static void writeChromeEvent(TraceNode* node, long long start, long long end) {
+    fputs(firstEvent ? "\n" : ",\n", chrome);
+    firstEvent = false;
+
+    if (node == &root)
+        fputs("{\"name\":\"main\"", chrome);
+    else {
+        fputs("{\"name\":\"{", chrome);
+        writeJsonString(chrome, node->name);
+        fputs("}\"", chrome);
+    }
+    fprintf(chrome, ",\"cat\":\"block\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+            (start - origin) / 1000.0, (end - start) / 1000.0);
+}
+
+/**
+ * \brief Inicia o registo da execução
+ * @param chromeFile Ficheiro onde escrever os eventos Chrome trace (ou NULL)
+ * @param foldedFile Ficheiro onde escrever as folded stacks (ou NULL)
+ * @param r          Cronometra-se uma execução de bloco em cada r
+ * @return           O nome do ficheiro que não foi possível abrir, ou NULL se o
+ *                   registo foi iniciado
+ */
+const char* startTrace(const char* chromeFile, const char* foldedFile, long long r) {
+    chrome = NULL;
+    if (chromeFile != NULL) {
+        chrome = fopen(chromeFile, "w");
+        if (chrome == NULL)
+            return chromeFile;
+    }
+
+    //os dois ficheiros são abertos antes de começar, para que um erro não perca o registo
+    folded = NULL;
+    if (foldedFile != NULL) {
+        folded = fopen(foldedFile, "w");
+        if (folded == NULL) {
+            if (chrome != NULL)
+                fclose(chrome);
+            return foldedFile;
+        }
+    }
+
+    if (chrome != NULL)
+        fputs("[", chrome);
+    rate = r > 0 ? r : 1;
+    countdown = 1;
+    firstEvent = true;
+
+    memset(&root, 0, sizeof(TraceNode));
+    root.name = "main";
+    root.calls = 1;
+
+    capacity = 64;
+    frames = malloc(sizeof(TraceFrame) * capacity);
+    depth = 1;
+    frames[0].node = &root;
+    frames[0].start = origin = now();
+
+    tracing = true;
+    return NULL;
+}
+
+/**
+ * \brief Regista o início da execução de um bloco
+ * @param block O bloco
+ */
+void traceEnter(BlockCode block) {
+    TraceNode* parent = frames[depth - 1].node;
+    TraceNode** link = &parent->children;
+
+    //Procura o filho com o mesmo bloco
+    while (*link != NULL && (*link)->block != block)
+        link = &(*link)->next;
+
+    TraceNode* node = *link;
+    if (node == NULL) {
+        node = calloc(1, sizeof(TraceNode));
+        node->name = strdup(block->source);
+        node->block = block;
+        node->parent = parent;
+        node->next = parent->children;
+        parent->children = node;
+    } else if (node != parent->children) {
+        //Move o filho para o início da lista, pois é provável que volte a ser executado
+        *link = node->next;
+        node->next = parent->children;
+        parent->children = node;
+    }
+    node->calls++;
+
+    if (depth == capacity) {
+        capacity *= 2;
+        frames = realloc(frames, sizeof(TraceFrame) * capacity);
+    }
+
+    frames[depth].node = node;
+    frames[depth].start = 0;
+    if (--countdown == 0) {
+        countdown = rate;
+        frames[depth].start = now();
+    }
+    depth++;
+}
+
+/**
+ * \brief Regista o fim da execução do bloco mais recente
+ */
+void traceExit() {
+    TraceFrame f = frames[--depth];
+
+    if (f.start != 0) {
+        long long end = now();
+        f.node->sampled++;
+        f.node->sampledTime += end - f.start;
+        if (chrome != NULL)
+            writeChromeEvent(f.node, f.start, end);
+    }
+}
+
+/**
+ * \brief Devolve o número de execuções de blocos em curso (incluindo o programa principal)
+ * @return A profundidade
+ */
+long long traceDepth() {
+    return depth;
+}
+
+/**
+ * \brief Regista o fim das execuções de blocos interrompidas por um erro
+ * @param d A profundidade a que se regressa
+ */
+void traceUnwind(long long d) {
+    while (depth > d)
+        traceExit();
+}
+
+/**
+ * \brief Estima o tempo total (em nanossegundos) passado num nó
+ * @param node O nó
+ * @return     A estimativa
+ */
+static double estimatedTime(TraceNode* node) {
+    if (node->sampled == 0)
+        return 0;
+    return (double) node->sampledTime / node->sampled * node->calls;
+}
+
+/**
+ * \brief Escreve o caminho até ao nó dado, separado por ';'
+ * @param f    O ficheiro
+ * @param node O nó
+ */
+static void writePath(FILE* f, TraceNode* node) {
+    if (node->parent != NULL) {
+        writePath(f, node->parent);
+        fputc(';', f);
+    }
+
+    if (node == &root) {
+        fputs(node->name, f);
+        return;
+    }
+
+    //';' e mudanças de linha têm significado no formato, e são substituídos
+    fputc('{', f);
+    for (char* c = node->name; *c; c++)
+        fputc(*c == ';' ? ':' : *c == '\n' ? ' ' : *c, f);
+    fputc('}', f);
+}
+
+/**
+ * \brief Escreve as folded stacks do nó dado e dos seus descendentes, e liberta-os
+ * @param f    O ficheiro (ou NULL)
+ * @param node O nó
+ */
+static void writeFolded(FILE* f, TraceNode* node) {
+    double self = estimatedTime(node);
+
+    for (TraceNode* c = node->children; c != NULL; c = c->next)
+        self -= estimatedTime(c);
+
+    if (f != NULL && self >= 1000) {
+        writePath(f, node);
+        fprintf(f, " %lld\n", (long long) (self / 1000)); //em microssegundos
+    }
+
+    TraceNode* c = node->children;
+    while (c != NULL) {
+        TraceNode* next = c->next;
+        writeFolded(f, c);
+        free(c->name);
+        free(c);
+        c = next;
+    }
+}
+
+/**
+ * \brief Termina o registo da execução, escrevendo os ficheiros pedidos
+ */
+void stopTrace() {
+    if (!tracing)
+        return;
+    tracing = false;
+
+    long long end = now();
+    root.sampled = 1;
+    root.sampledTime = end - frames[0].start;
+
+    if (chrome != NULL) {
+        writeChromeEvent(&root, frames[0].start, end);
+        fputs("\n]\n", chrome);
+        fclose(chrome);
+    }
+
+    writeFolded(folded, &root);
+    if (folded != NULL)
+        fclose(folded);
+
+    free(frames);
+}
@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief contém a declaração das funções de registo (tracing) da execução
+ * dos blocos
+ */
+
+//! Include guard
+#ifndef TRACE_H
+//! Include guard
+#define TRACE_H
+
+#include "stack.h"
+
+//! É verdadeiro enquanto o registo da execução estiver ativo
+extern bool tracing;
+
+const char* startTrace(const char* chromeFile, const char* foldedFile, long long rate);
+
+void traceEnter(BlockCode block);
+
+void traceExit();
+
+long long traceDepth();
+
+void traceUnwind(long long d);
+
+void stopTrace();
+
+#endif
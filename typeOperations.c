@@ -5,16 +5,33 @@
  */
 
 #include "typeOperations.h"
+#include "memory.h"
+#include "bigInt.h"
+#include "format.h"
+#include "error.h"
 #include <string.h>
+#include <errno.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 
+/**
+ * \brief Verifica que o #Value dado pode ser convertido para um número ou
+ * caracter: as arrays e os blocos não podem. Se não puder, liberta-o e
+ * assinala o erro.
+ *
+ * @param a  O #Value fornecido
+ */
+static void checkScalar(Value a) {
+    CHECK_OPERAND(a.type != Block, "operação não definida para blocos", a);
+    CHECK_OPERAND(a.type != Array, "operação não definida para arrays", a);
+}
 
 /**
- * \brief Converte o #Value dado para outro que armazena um inteiro
+ * \brief Converte o #Value dado para outro que armazena um inteiro. Os números
+ * que não cabem num long long dão origem a um inteiro grande (BigInt).
  *
  * @param a  O #Value fornecido
  * @return   O #Value com a informação armazenada num inteiro
@@ -24,18 +41,50 @@ Value convertToInt(Value a) {
 
     Value result;
     result.type = Int;
+    checkScalar(a);
 
     //Decide o método de conversão de acordo com o tipo original
     switch(a.type) {
-        case Double:    result.integer = (long long)a.decimal;   break;
+        case Double:
+            if (isfinite(a.decimal) && fabs(a.decimal) >= 0x1p63) //não cabe num long long
+                return fromBigInteger(bigFromDouble(a.decimal));
+            result.integer = (long long)a.decimal;
+            break;
+        case BigInt:    return deepCopy(a);
         case Int:       result.integer = a.integer;              break;
         case Char:      result.integer = a.character;            break;
         case String:    
              str = toString(a); //Obtém a string
-             result.integer = atoi(str);
-             free(str);
+             errno = 0;
+             result.integer = strtoll(str, NULL, 10);
+             if (errno == ERANGE) //não cabe num long long
+                 result = fromBigInteger(bigFromString(str));
+             release(str);
              break;
-        default:                                                 break;
+        default:                                                 assert(false);
+    }
+    return result;
+}
+
+/**
+ * \brief Converte o #Value dado, que armazena um número, para um inteiro grande.
+ * Ao contrário dos restantes BigInt, o resultado pode caber num long long: serve
+ * apenas de operando às operações entre inteiros grandes.
+ *
+ * @param a  O #Value fornecido
+ * @return   O #Value com a informação armazenada num inteiro grande
+ */
+Value convertToBigInt(Value a) {
+    Value result;
+    result.type = BigInt;
+
+    //Decide o método de conversão de acordo com o tipo original
+    switch(a.type) {
+        case Double:    result.big = bigFromDouble(a.decimal);      break;
+        case BigInt:    return deepCopy(a);
+        case Int:       result.big = bigFromInteger(a.integer);     break;
+        case Char:      result.big = bigFromInteger(a.character);   break;
+        default:        result.big = bigFromInteger(0);             break;
     }
     return result;
 }
@@ -51,18 +100,20 @@ Value convertToDouble(Value a) {
 
     Value result;
     result.type = Double;
+    checkScalar(a);
 
     //Decide o método de conversão de acordo com o tipo original
     switch(a.type) {
         case Double:    result.decimal = a.decimal;             break;
+        case BigInt:    result.decimal = bigToDouble(a.big);    break;
         case Int:       result.decimal = (double)a.integer;     break;
         case Char:      result.decimal = (double)a.character;   break;
         case String:    
             str = toString(a); //Obtém a string
             result.decimal = atof(str);
-            free(str);
+            release(str);
             break;
-        default:                                                break;
+        default:                                                assert(false);
     }
     return result;
 }
@@ -76,14 +127,16 @@ Value convertToDouble(Value a) {
 Value convertToChar(Value a) {
     Value result;
     result.type = Char;
+    checkScalar(a);
 
     //Decide o método de conversão de acordo com o tipo original
     switch(a.type) {
         case Double:    result.character = (char)(long long)a.decimal;   break;
+        case BigInt:    result.character = (char)bigToInteger(a.big);    break;
         case Int:       result.character = (char)a.integer;              break;
         case Char:      result.character = a.character;                  break;
         case String:    result.character = '\0';                         break;
-        default:                                                         break;
+        default:                                                         assert(false);
     }
     return result;
 }
@@ -100,6 +153,7 @@ Value convertToString(Value a) {
     //Determina a forma de conversão consoante o tipo original
     switch (a.type) {
         case Double:    string = convertFloatToString(a.decimal);   break;
+        case BigInt:    string = bigToString(a.big);                break;
         case Int:       string = convertIntToString(a.integer);     break;
         case Char:      string = convertCharToString(a.character);  break;
         case String:
@@ -108,12 +162,12 @@ Value convertToString(Value a) {
             a = deepCopy(a); 
             a.type = String;
             return a;
-        case Block:     string = strdup(a.block);           break;
+        case Block:     return fromString(a.block->source);
     }
 
     Value ans = fromString(string);
     //Liberta a string, pois não é mais necessária
-    free(string);
+    release(string);
     return ans;
 }
 
@@ -124,13 +178,11 @@ Value convertToString(Value a) {
  * @return   Um apontador com a informação armazenada sob a forma de texto
  */
 char* convertFloatToString(double v) {
-    char useless[100];
-    long long size = snprintf(useless, 100, "%g", v) + 1;
-    char* ans = malloc(size * sizeof(char));
-
-    //Converter para string
-    snprintf(ans, size, "%g", v);
+    char buffer[DOUBLE_BUFFER_SIZE];
+    long long size = formatDouble(v, buffer) + 1;
+    char* ans = allocate(TempString, size * sizeof(char));
 
+    memcpy(ans, buffer, size);
     return ans;
 }
 
@@ -142,10 +194,11 @@ char* convertFloatToString(double v) {
  * @return  Um apontador com a informação armazenada sob a forma de texto
  */
 char* convertIntToString(long long v) {
-    long long size = (long long)((ceil(log10(v + 1)) + 1));
-    char* ans = malloc(size * sizeof(char)); //Aloca memória suficiente
-    //Converte para inteiro
-    snprintf(ans, size, "%lld", v);
+    char buffer[INTEGER_BUFFER_SIZE];
+    long long size = formatInteger(v, buffer) + 1;
+    char* ans = allocate(TempString, size * sizeof(char)); //Aloca memória suficiente
+
+    memcpy(ans, buffer, size);
     return ans;
 }
 
@@ -158,7 +211,7 @@ char* convertIntToString(long long v) {
  */
 char* convertCharToString(char v) {
 
-    char* ans = malloc(2 * sizeof(char)); //Aloca memória suficiente
+    char* ans = allocate(TempString, 2 * sizeof(char)); //Aloca memória suficiente
     ans[0] = v;
     ans[1] = '\0';
 
@@ -176,6 +229,7 @@ Value convertToType(DataType type, Value val) {
     //Escolhe o tipo apropriado
     switch(type) {
         case Double:    return convertToDouble(val);
+        case BigInt:    return convertToBigInt(val);
         case Int:       return convertToInt(val);
         case Char:      return convertToChar(val);
         case String:    return convertToString(val);
@@ -15,6 +15,7 @@
 
 
 Value convertToInt(Value v);
+Value convertToBigInt(Value v);
 Value convertToDouble(Value v);
 Value convertToChar(Value v);
 Value convertToString(Value v);
@@ -8,6 +8,10 @@
 #include <string.h>
 #include "value.h"
 #include "stack.h"
+#include "memory.h"
+#include "rrb.h"
+#include "bigInt.h"
+#include "format.h"
 
 /**
  * \brief Converte um inteiro para tipo #Value.
@@ -70,19 +74,36 @@ Value fromString(char* str){
 }
 
 /**
- * \brief Cria um value a partir de um bloco com a forma de string. A string não é libertada.
- * @param block bloco dado. Não é libertado.
- * @param length Tamanho da string + 1
- * @return Value criado a partir de um bloco com a forma da string
+ * \brief Converte os caracteres dados para uma string, sem precisar de um '\0' no fim
+ *
+ * @param str     os caracteres. Não são libertados.
+ * @param length  o número de caracteres
+ * @return        a string
+ */
+Value fromText(const char* str, long long length) {
+    Value val;
+    Stack st = empty();
+
+    reserve(st, length);
+    for (long long i = 0; i < length; i++)
+        push(st, fromCharacter(str[i]));
+
+    val.type = String;
+    val.array = st;
+    return val;
+}
+
+/**
+ * \brief Cria um value a partir de um bloco.
+ * @param block bloco dado. É partilhado, não é copiado.
+ * @return Value criado a partir do bloco
  */
 
-Value fromBlock(char* block, long long length) {
+Value fromBlock(BlockCode block) {
     Value val;
 
     val.type = Block;
-    val.block = malloc( length * sizeof (char));
-    memcpy(val.block,block,(length-1) * sizeof (char));
-    val.block [(length-1)] = '\0';
+    val.block = block;
     return val;
 }
 
@@ -94,27 +115,89 @@ Value fromBlock(char* block, long long length) {
 Value deepCopy(Value v) {
     Value copy = v;
 
+    //um valor de fora da região ativa não pode ser partilhado por valores da região,
+    //cujas referências desapareceriam no reset sem serem libertadas
+    if ((v.type >= String && v.type <= Array && outlivesRegion(v.array)) ||
+        (v.type == BigInt && outlivesRegion(v.big)))
+        return detachedCopy(v);
+
+    //os blocos e os inteiros grandes nunca são alterados, pelo que a cópia partilha o mesmo objeto
     if (v.type == Array || v.type == String)
         copy.array = clone(v.array);
+    else if (v.type == BigInt)
+        retainBig(v.big);
+
+    registerDeepCopy(0); //os bytes das arrays são contados pelo clone
+    return copy;
+}
 
-    else if (v.type == Block)
-        copy.block = strdup(v.block);
+/**
+ * \brief Acrescenta a uma stack uma cópia independente de um valor (ver detachedCopy)
+ * @param v     O valor
+ * @param stack A stack
+ */
+static void pushDetached(Value v, void* stack) {
+    push(stack, detachedCopy(v));
+}
+
+/**
+ * \brief Copia um valor sem partilhar nenhuma parte do original (nem vistas
+ * nem inteiros grandes), ao contrário de deepCopy
+ * @param v O valor
+ * @return  A cópia
+ */
+Value detachedCopy(Value v) {
+    Value copy = v;
+
+    if (v.type == Array || v.type == String) {
+        copy.array = empty();
+        reserve(copy.array, length(v.array));
+        if (v.array->tree != NULL) //os nós da árvore não podem ser alterados (ver rrb.c)
+            rrbVisit(v.array->tree, pushDetached, copy.array);
+        else
+            for (long long i = 0; i < length(v.array); i++)
+                pushDetached(valueAt(v.array, i), copy.array);
+    } else if (v.type == BigInt)
+        copy.big = copyBig(v.big);
 
     return copy;
 }
 
 /**
-* \brief Efetua print do valor dado
+ * \brief Copia um valor para fora da região de memória ativa (ver memory.c),
+ * para que sobreviva ao reset da região
+ * @param v O valor
+ * @return  A cópia, alocada com malloc
+ */
+Value promoteValue(Value v) {
+    Region r = enterRegion(NULL);
+    Value copy = detachedCopy(v);
+    enterRegion(r);
+    return copy;
+}
+
+/**
+* \brief Efetua print do valor dado. Os números são escritos pelas funções de
+* format.h e os caracteres diretamente, sem passar pelo printf.
+* @param f   O ficheiro onde escrever
 * @param top Valor a ser dado print
 */
 
-void printVal(Value top) {
+void printVal(FILE* f, Value top) {
+    char buffer[DOUBLE_BUFFER_SIZE];
+    char* str;
+
     switch (top.type) {
-        case Double:    printf("%g", top.decimal);      break;
-        case Int:       printf("%lld", top.integer);      break;
-        case Char:      printf("%c", top.character);    break;
+        case Double:    fwrite(buffer, 1, formatDouble(top.decimal, buffer), f);     break;
+        case BigInt:
+            str = bigToString(top.big);
+            fputs(str, f);
+            release(str);
+            break;
+        case Int:       fwrite(buffer, 1, formatInteger(top.integer, buffer), f);    break;
+        case Char:      putc(top.character, f);         break;
         case String:
-        case Array:     printStack(top.array);          break;
-        case Block:     printf("{%s}", top.block);       break;
+        case Array:     printStack(f, top.array);       break;
+        case Block:     fprintf(f, "{%s}", top.block->source);      break;
     }
 }
\ No newline at end of file
@@ -9,15 +9,40 @@
 //! Include guard
 #define VALUE_H
 
+#include <stdio.h>
+
 //! Inteiro utilizado para representar um resultado indefinido de uma operação
 #define UNDEFINED 13
 
+/**
+ * \brief Representa o código de um bloco. Cada texto de bloco tem um único
+ * objeto, que nunca é alterado e é partilhado por todos os valores com esse
+ * bloco, pelo que o endereço do objeto identifica o bloco.
+ */
+typedef struct block {
+    //! O texto do bloco (sem as chavetas)
+    char* source;
+    //! O tamanho do texto
+    long long length;
+    //! O hash do texto
+    unsigned long long hash;
+    //! O programa compilado (NULL enquanto o bloco não for compilado)
+    struct program* program;
+    //! Número de execuções do bloco, contadas até ser compilado para código máquina
+    long long calls;
+    //! O código máquina do bloco (NULL enquanto não for compilado, ver jit.c)
+    struct jitCode* jit;
+    //! O bloco seguinte da mesma lista da tabela de blocos
+    struct block* next;
+} * BlockCode;
+
 /**
  * \brief Representa os diferentes tipos de dados que é possível armazenar
  * na stack
  */
 typedef enum dataType {
     Double, //!< Valor Fracionário
+    BigInt, //!< Valor Inteiro que não cabe num long long
     Int, //!< Valor Inteiro
     Char, //!< Caracter
     String, //!< Texto
@@ -41,7 +66,8 @@ typedef struct value {
         long long integer; //!< Valor Inteiro
         double decimal; //!< Valor Fracionário
         char character; //!< Caracter
-        char* block; //!< Bloco
+        BlockCode block; //!< Bloco
+        struct bigInt* big; //!< Inteiro grande
         struct stack* array; //!< Array
     };
 
@@ -55,9 +81,15 @@ Value fromCharacter(char);
 
 Value fromString(char*);
 
-Value fromBlock(char* block, long long length);
+Value fromText(const char* str, long long length);
+
+Value fromBlock(BlockCode block);
 
 Value deepCopy(Value);
 
-void printVal(Value val);
+Value detachedCopy(Value v);
+
+Value promoteValue(Value v);
+
+void printVal(FILE* f, Value val);
 #endif
\ No newline at end of file